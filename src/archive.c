@@ -0,0 +1,501 @@
+#include "archive.h"
+#include "calendar.h"
+#include "event_list.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_MAGIC "CALA"
+#define ARCHIVE_VERSION 1
+
+typedef struct {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} ArchiveBuffer;
+
+static bool buffer_reserve(ArchiveBuffer *buf, const size_t extra) {
+  if (buf->len + extra <= buf->cap) {
+    return true;
+  }
+  size_t cap = buf->cap ? buf->cap : 4096;
+  while (cap < buf->len + extra) {
+    cap *= 2;
+  }
+  unsigned char *data = realloc(buf->data, cap);
+  if (!data) {
+    return false;
+  }
+  buf->data = data;
+  buf->cap = cap;
+  return true;
+}
+
+static bool put_bytes(ArchiveBuffer *buf, const void *bytes, const size_t n) {
+  if (!buffer_reserve(buf, n)) {
+    return false;
+  }
+  memcpy(buf->data + buf->len, bytes, n);
+  buf->len += n;
+  return true;
+}
+
+static bool put_varint(ArchiveBuffer *buf, uint64_t value) {
+  unsigned char bytes[10];
+  size_t n = 0;
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    bytes[n++] = value ? (byte | 0x80) : byte;
+  } while (value);
+  return put_bytes(buf, bytes, n);
+}
+
+static uint64_t zigzag_encode(const int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(const uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+typedef struct {
+  const unsigned char *data;
+  size_t len;
+  size_t pos;
+} ArchiveReader;
+
+static bool get_varint(ArchiveReader *r, uint64_t *out) {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (r->pos >= r->len) {
+      return false;
+    }
+    unsigned char byte = r->data[r->pos++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *out = value;
+      return true;
+    }
+  }
+  return false; // Overlong varint
+}
+
+// String dictionary: open addressing over indices into `strings`
+typedef struct {
+  const char **strings;
+  size_t count;
+  int *slots;
+  size_t slot_mask;
+} Dictionary;
+
+static uint32_t hash_string(const char *s) {
+  uint32_t h = 2166136261u;
+  for (; *s; s++) {
+    h = (h ^ (unsigned char)*s) * 16777619u;
+  }
+  return h;
+}
+
+static bool dictionary_init(Dictionary *dict, const size_t max_strings) {
+  size_t slots = 16;
+  while (slots < max_strings * 2) {
+    slots *= 2;
+  }
+  dict->strings = malloc(max_strings * sizeof(char *));
+  dict->slots = malloc(slots * sizeof(int));
+  if (!dict->strings || !dict->slots) {
+    free(dict->strings);
+    free(dict->slots);
+    return false;
+  }
+  memset(dict->slots, -1, slots * sizeof(int));
+  dict->count = 0;
+  dict->slot_mask = slots - 1;
+  return true;
+}
+
+// Returns the dictionary index of s, adding it if new
+static size_t dictionary_intern(Dictionary *dict, const char *s) {
+  size_t slot = hash_string(s) & dict->slot_mask;
+  while (dict->slots[slot] >= 0) {
+    if (strcmp(dict->strings[dict->slots[slot]], s) == 0) {
+      return dict->slots[slot];
+    }
+    slot = (slot + 1) & dict->slot_mask;
+  }
+  dict->slots[slot] = (int)dict->count;
+  dict->strings[dict->count] = s;
+  return dict->count++;
+}
+
+static void dictionary_free(Dictionary *dict) {
+  free(dict->strings);
+  free(dict->slots);
+}
+
+static bool encode_year(const Calendar *calendar, const unsigned year,
+                        ArchiveBuffer *out) {
+  Event *first = get_first_event_of_year(calendar, year);
+  if (!first) {
+    return false;
+  }
+  const time_t year_end = year_start_time(year + 1);
+  size_t count = 0;
+  for (Event *e = first; e && e->start_time < year_end; e = e->next) {
+    count++;
+  }
+
+  Dictionary dict;
+  if (!dictionary_init(&dict, count * 2)) {
+    return false;
+  }
+  size_t *indices = malloc(count * 2 * sizeof(size_t));
+  if (!indices) {
+    dictionary_free(&dict);
+    return false;
+  }
+  size_t i = 0;
+  for (Event *e = first; i < count; e = e->next, i++) {
+    indices[2 * i] = dictionary_intern(&dict, e->title);
+    indices[2 * i + 1] = dictionary_intern(&dict, e->description);
+  }
+
+  bool ok = put_bytes(out, ARCHIVE_MAGIC, 4) &&
+            put_varint(out, ARCHIVE_VERSION) && put_varint(out, year) &&
+            put_varint(out, dict.count);
+  for (size_t s = 0; ok && s < dict.count; s++) {
+    size_t len = strlen(dict.strings[s]);
+    ok = put_varint(out, len) && put_bytes(out, dict.strings[s], len);
+  }
+  ok = ok && put_varint(out, count);
+
+  EventID prev_id = 0;
+  time_t prev_start = year_start_time(year);
+  i = 0;
+  for (Event *e = first; ok && i < count; e = e->next, i++) {
+    ok = put_varint(out, zigzag_encode((int64_t)e->id - (int64_t)prev_id)) &&
+         put_varint(out, zigzag_encode(e->start_time - prev_start)) &&
+         put_varint(out, zigzag_encode(e->end_time - e->start_time)) &&
+         put_varint(out, indices[2 * i]) &&
+         put_varint(out, indices[2 * i + 1]);
+    prev_id = e->id;
+    prev_start = e->start_time;
+  }
+
+  free(indices);
+  dictionary_free(&dict);
+  return ok;
+}
+
+// Writes buf to filename via a temporary file so a crash never leaves a
+// truncated archive behind
+static bool write_file_atomic(const char *filename, const ArchiveBuffer *buf) {
+  size_t name_len = strlen(filename);
+  char *tmp = malloc(name_len + 5);
+  if (!tmp) {
+    return false;
+  }
+  memcpy(tmp, filename, name_len);
+  memcpy(tmp + name_len, ".tmp", 5);
+
+  FILE *file = fopen(tmp, "wb");
+  if (!file) {
+    free(tmp);
+    return false;
+  }
+  bool ok = fwrite(buf->data, 1, buf->len, file) == buf->len;
+  ok = (fclose(file) == 0) && ok;
+  ok = ok && rename(tmp, filename) == 0;
+  if (!ok) {
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+bool write_year_archive(const Calendar *calendar, const unsigned year,
+                        const char *filename) {
+  if (!calendar || !calendar->event_list || !filename) {
+    return false;
+  }
+  ArchiveBuffer buf = {0};
+  bool ok =
+      encode_year(calendar, year, &buf) && write_file_atomic(filename, &buf);
+  free(buf.data);
+  return ok;
+}
+
+static unsigned char *read_file(const char *filename, size_t *len) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return NULL;
+  }
+  unsigned char *data = NULL;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long size = ftell(file);
+    if (size >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+      data = malloc(size ? size : 1);
+      if (data && fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+      }
+      *len = size;
+    }
+  }
+  fclose(file);
+  return data;
+}
+
+static bool read_header(ArchiveReader *r, unsigned *year) {
+  uint64_t version, y;
+  if (r->len < 4 || memcmp(r->data, ARCHIVE_MAGIC, 4) != 0) {
+    return false;
+  }
+  r->pos = 4;
+  if (!get_varint(r, &version) || version != ARCHIVE_VERSION) {
+    return false;
+  }
+  if (!get_varint(r, &y)) {
+    return false;
+  }
+  *year = (unsigned)y;
+  return true;
+}
+
+// Decodes an archive into a sorted chain of events
+static bool decode_year(ArchiveReader *r, const unsigned year, Event **out) {
+  uint64_t string_count;
+  if (!get_varint(r, &string_count) || string_count > r->len) {
+    return false;
+  }
+  const unsigned char **strings = malloc((string_count + 1) * sizeof(char *));
+  size_t *lengths = malloc((string_count + 1) * sizeof(size_t));
+  if (!strings || !lengths) {
+    free(strings);
+    free(lengths);
+    return false;
+  }
+  bool ok = true;
+  for (uint64_t s = 0; ok && s < string_count; s++) {
+    uint64_t len;
+    ok = get_varint(r, &len) && len <= r->len - r->pos;
+    if (ok) {
+      strings[s] = r->data + r->pos;
+      lengths[s] = len;
+      r->pos += len;
+    }
+  }
+
+  uint64_t count = 0;
+  ok = ok && get_varint(r, &count);
+  Event *head = NULL;
+  Event *tail = NULL;
+  int64_t id = 0;
+  time_t start = year_start_time(year);
+  for (uint64_t i = 0; ok && i < count; i++) {
+    uint64_t id_delta, start_delta, duration, title, desc;
+    ok = get_varint(r, &id_delta) && get_varint(r, &start_delta) &&
+         get_varint(r, &duration) && get_varint(r, &title) &&
+         get_varint(r, &desc) && title < string_count && desc < string_count;
+    if (!ok) {
+      break;
+    }
+    Event *event = malloc(sizeof(Event));
+    if (!event) {
+      ok = false;
+      break;
+    }
+    id += zigzag_decode(id_delta);
+    start += zigzag_decode(start_delta);
+    event->id = (EventID)id;
+    event->start_time = start;
+    event->end_time = start + zigzag_decode(duration);
+    size_t title_len = lengths[title] < 255 ? lengths[title] : 255;
+    memcpy(event->title, strings[title], title_len);
+    event->title[title_len] = '\0';
+    size_t desc_len = lengths[desc] < 1023 ? lengths[desc] : 1023;
+    memcpy(event->description, strings[desc], desc_len);
+    event->description[desc_len] = '\0';
+    event->next = NULL;
+    event->parent = tail;
+    if (tail) {
+      tail->next = event;
+    } else {
+      head = event;
+    }
+    tail = event;
+  }
+
+  free(strings);
+  free(lengths);
+  if (!ok) {
+    free_event_chain(head);
+    return false;
+  }
+  *out = head;
+  return true;
+}
+
+YearArchive *get_year_archive(const Calendar *calendar, const unsigned year) {
+  if (!calendar) {
+    return NULL;
+  }
+  for (YearArchive *a = calendar->archives; a && a->year <= year;
+       a = a->next) {
+    if (a->year == year) {
+      return a;
+    }
+  }
+  return NULL;
+}
+
+static void insert_archive(Calendar *calendar, YearArchive *archive) {
+  YearArchive **link = &calendar->archives;
+  while (*link && (*link)->year < archive->year) {
+    link = &(*link)->next;
+  }
+  archive->next = *link;
+  *link = archive;
+}
+
+static YearArchive *register_archive(Calendar *calendar, const unsigned year,
+                                     const char *filename) {
+  YearArchive *archive = get_year_archive(calendar, year);
+  if (archive) {
+    // Re-archiving a year replaces its file
+    char *path = malloc(strlen(filename) + 1);
+    if (!path) {
+      return NULL;
+    }
+    strcpy(path, filename);
+    free(archive->path);
+    archive->path = path;
+    return archive;
+  }
+  archive = calloc(1, sizeof(YearArchive));
+  if (!archive) {
+    return NULL;
+  }
+  archive->path = malloc(strlen(filename) + 1);
+  if (!archive->path) {
+    free(archive);
+    return NULL;
+  }
+  strcpy(archive->path, filename);
+  archive->year = year;
+  insert_archive(calendar, archive);
+  return archive;
+}
+
+bool archive_calendar_year(Calendar *calendar, const unsigned year,
+                           const char *filename) {
+  if (!write_year_archive(calendar, year, filename)) {
+    return false;
+  }
+  YearArchive *archive = register_archive(calendar, year, filename);
+  if (!archive) {
+    return false; // Archive written, events stay resident
+  }
+  free_event_chain(detach_calendar_year(calendar, year));
+  archive->resident = false;
+  return true;
+}
+
+bool attach_year_archive(Calendar *calendar, const char *filename) {
+  if (!calendar || !filename) {
+    return false;
+  }
+  // Only the header is needed to register the archive
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return false;
+  }
+  unsigned char header[32];
+  size_t n = fread(header, 1, sizeof(header), file);
+  fclose(file);
+  ArchiveReader r = {header, n, 0};
+  unsigned year;
+  if (!read_header(&r, &year)) {
+    return false;
+  }
+  return register_archive(calendar, year, filename) != NULL;
+}
+
+static bool load_archive(const Calendar *calendar, YearArchive *archive) {
+  // Mark first so a failed or empty archive is not retried on every query
+  archive->resident = true;
+  size_t len = 0;
+  unsigned char *data = read_file(archive->path, &len);
+  if (!data) {
+    return false;
+  }
+  ArchiveReader r = {data, len, 0};
+  unsigned year;
+  Event *chain = NULL;
+  bool ok = read_header(&r, &year) && year == archive->year &&
+            decode_year(&r, year, &chain);
+  free(data);
+  if (ok) {
+    attach_calendar_events((Calendar *)calendar, chain);
+    // The archive on disk already matches what was decoded
+    YearBucket *bucket = get_year_bucket(calendar, year);
+    if (bucket) {
+      bucket->dirty = false;
+    }
+  }
+  return ok;
+}
+
+bool ensure_year_loaded(const Calendar *calendar, const unsigned year) {
+  if (!calendar) {
+    return false;
+  }
+  YearArchive *archive = get_year_archive(calendar, year);
+  if (!archive || archive->resident) {
+    return false;
+  }
+  return load_archive(calendar, archive);
+}
+
+bool load_archive_between(const Calendar *calendar, const unsigned after,
+                          const unsigned before) {
+  if (!calendar) {
+    return false;
+  }
+  YearArchive *latest = NULL;
+  for (YearArchive *a = calendar->archives; a && a->year < before;
+       a = a->next) {
+    if (a->year > after && !a->resident) {
+      latest = a;
+    }
+  }
+  if (!latest) {
+    return false;
+  }
+  load_archive(calendar, latest);
+  return true; // Resident now either way; the caller's view may have changed
+}
+
+bool load_all_archives(const Calendar *calendar) {
+  if (!calendar) {
+    return false;
+  }
+  bool loaded = false;
+  for (YearArchive *a = calendar->archives; a; a = a->next) {
+    if (!a->resident) {
+      loaded = load_archive(calendar, a) || loaded;
+    }
+  }
+  return loaded;
+}
+
+void free_year_archives(YearArchive *archive) {
+  while (archive) {
+    YearArchive *next = archive->next;
+    free(archive->path);
+    free(archive);
+    archive = next;
+  }
+}
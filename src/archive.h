@@ -0,0 +1,60 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "calendar.h"
+#include <stdbool.h>
+
+// Compressed on-disk representation of a whole past year.
+//
+// Layout (all integers are LEB128 varints):
+//   "CALA" version year
+//   string_count (length bytes)*      -- dictionary of titles/descriptions
+//   event_count
+//   (id_delta start_delta duration title_index description_index)*
+//
+// Events are stored sorted by start time, so start deltas are small and
+// non-negative; id deltas and durations are zigzag encoded. Repeated titles
+// and descriptions ("Standup", "") are stored once in the dictionary.
+
+// A registered archive file. Years stay on disk until a query touches them.
+typedef struct YearArchive {
+  unsigned year;
+  bool resident; // decoded into the calendar's event list and year buckets
+  char *path;
+  struct YearArchive *next; // sorted by year
+} YearArchive;
+
+// Writes every event of `year` to a compressed archive file.
+// Returns false if the year has no events or the file cannot be written.
+bool write_year_archive(const Calendar *calendar, const unsigned year,
+                        const char *filename);
+
+// Writes `year` to an archive file, then drops its events from memory and
+// registers the archive so the year is decoded again on first use.
+bool archive_calendar_year(Calendar *calendar, const unsigned year,
+                           const char *filename);
+
+// Registers an existing archive file without decoding it
+bool attach_year_archive(Calendar *calendar, const char *filename);
+
+// Returns the archive registered for `year`, or NULL if there is none
+YearArchive *get_year_archive(const Calendar *calendar, const unsigned year);
+
+// Decodes the archive for `year` into the calendar if one is registered and
+// not yet resident. Returns true if events were loaded.
+//
+// Decoding is a cache fill, so this takes a const calendar like the queries
+// that trigger it.
+bool ensure_year_loaded(const Calendar *calendar, const unsigned year);
+
+// Decodes the latest non-resident archive with after < year < before.
+// Returns true if one was loaded.
+bool load_archive_between(const Calendar *calendar, const unsigned after,
+                          const unsigned before);
+
+// Decodes every non-resident archive. Returns true if any was loaded.
+bool load_all_archives(const Calendar *calendar);
+
+void free_year_archives(YearArchive *archive);
+
+#endif // ARCHIVE_H
@@ -0,0 +1,225 @@
+#include "batch.h"
+#include "holiday.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Candidates in structure-of-arrays form, converted once per batch
+typedef struct {
+  const time_t *times;
+  int32_t *seconds;       // since local midnight
+  unsigned char *weekday; // tm_wday
+  unsigned char *month;   // tm_mon
+  unsigned char *mday;
+  unsigned char *month_length; // days in the candidate's month
+  unsigned char *holiday;
+  size_t n;
+  size_t words;
+  time_t duration;
+  const Calendar *calendar;
+} BatchColumns;
+
+// Runs `cond` (an expression of i) for every candidate and packs the results
+// into out, one bit per candidate
+#define BATCH_KERNEL(cols, out, cond)                                          \
+  for (size_t w = 0; w < (cols)->words; w++) {                                 \
+    size_t word_base = w * 64;                                                 \
+    size_t word_end = word_base + 64 < (cols)->n ? word_base + 64 : (cols)->n; \
+    uint64_t bits = 0;                                                         \
+    for (size_t i = word_base; i < word_end; i++) {                            \
+      bits |= (uint64_t)(cond) << (i - word_base);                             \
+    }                                                                          \
+    (out)[w] = bits;                                                           \
+  }
+
+// Bits past the last candidate are kept clear
+static void clear_tail(const BatchColumns *cols, uint64_t *out) {
+  if (cols->n % 64) {
+    out[cols->words - 1] &= ((uint64_t)1 << (cols->n % 64)) - 1;
+  }
+}
+
+static bool eval_batch(const Filter *filter, const BatchColumns *cols,
+                       uint64_t *out) {
+  if (!filter) {
+    memset(out, 0xFF, cols->words * sizeof(uint64_t));
+    clear_tail(cols, out);
+    return true;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR: {
+    if (!eval_batch(filter->data.logical.left, cols, out)) {
+      return false;
+    }
+    uint64_t *right = malloc(cols->words * sizeof(uint64_t));
+    if (!right || !eval_batch(filter->data.logical.right, cols, right)) {
+      free(right);
+      return false;
+    }
+    if (filter->type == FILTER_AND) {
+      for (size_t w = 0; w < cols->words; w++) {
+        out[w] &= right[w];
+      }
+    } else {
+      for (size_t w = 0; w < cols->words; w++) {
+        out[w] |= right[w];
+      }
+    }
+    free(right);
+    return true;
+  }
+  case FILTER_NOT:
+    if (!eval_batch(filter->data.operand, cols, out)) {
+      return false;
+    }
+    for (size_t w = 0; w < cols->words; w++) {
+      out[w] = ~out[w];
+    }
+    clear_tail(cols, out);
+    return true;
+  case FILTER_DAY_OF_WEEK: {
+    const int day = filter->data.day_of_week;
+    BATCH_KERNEL(cols, out, cols->weekday[i] == day);
+    return true;
+  }
+  case FILTER_DAY_MASK: {
+    const unsigned mask = filter->data.day_mask;
+    BATCH_KERNEL(cols, out, (mask >> cols->weekday[i]) & 1);
+    return true;
+  }
+  case FILTER_HOLIDAY:
+    BATCH_KERNEL(cols, out, cols->holiday[i]);
+    return true;
+  case FILTER_MONTH_MASK: {
+    const unsigned mask = filter->data.month_mask;
+    BATCH_KERNEL(cols, out, (mask >> cols->month[i]) & 1);
+    return true;
+  }
+  case FILTER_MONTH_DAYS: {
+    const unsigned mask = filter->data.month_days & ~1u;
+    BATCH_KERNEL(cols, out, (mask >> cols->mday[i]) & 1);
+    return true;
+  }
+  case FILTER_NTH_WEEKDAY: {
+    const int week = filter->data.nth.week;
+    const int day = filter->data.nth.day_of_week;
+    // The last one is within a week of the end of the month
+    BATCH_KERNEL(cols, out,
+                 cols->weekday[i] == day &&
+                     (week < 0 ? cols->mday[i] + 7 > cols->month_length[i]
+                               : (cols->mday[i] - 1) / 7 + 1 == week));
+    return true;
+  }
+  case FILTER_DATE_RANGE: {
+    const time_t start = filter->data.range.start;
+    const time_t end = filter->data.range.end;
+    BATCH_KERNEL(cols, out, cols->times[i] >= start && cols->times[i] < end);
+    return true;
+  }
+  case FILTER_AFTER_DATETIME: {
+    const time_t limit = filter->data.time_value;
+    BATCH_KERNEL(cols, out, cols->times[i] > limit);
+    return true;
+  }
+  case FILTER_BEFORE_DATETIME: {
+    const time_t limit = filter->data.time_value;
+    BATCH_KERNEL(cols, out, cols->times[i] < limit);
+    return true;
+  }
+  case FILTER_AFTER_TIME: {
+    const int32_t limit = (int32_t)filter->data.seconds;
+    BATCH_KERNEL(cols, out, cols->seconds[i] >= limit);
+    return true;
+  }
+  case FILTER_BEFORE_TIME: {
+    const int32_t limit = (int32_t)filter->data.seconds;
+    BATCH_KERNEL(cols, out, cols->seconds[i] < limit);
+    return true;
+  }
+  case FILTER_TIME_WINDOW: {
+    const int32_t start = (int32_t)filter->data.window.start;
+    const int32_t end = (int32_t)filter->data.window.end;
+    BATCH_KERNEL(cols, out,
+                 cols->seconds[i] >= start && cols->seconds[i] < end);
+    return true;
+  }
+  case FILTER_MIN_DISTANCE:
+    // Depends on the events around each candidate: no closed form
+    BATCH_KERNEL(cols, out,
+                 evaluate_filter(filter, cols->times[i], cols->duration,
+                                 cols->calendar));
+    return true;
+  default: // FILTER_NONE
+    memset(out, 0xFF, cols->words * sizeof(uint64_t));
+    clear_tail(cols, out);
+    return true;
+  }
+}
+
+bool evaluate_filter_batch(const Filter *filter, const time_t *candidates,
+                           const size_t n, const time_t duration,
+                           const Calendar *calendar, uint64_t *out_bits) {
+  if (n == 0) {
+    return true;
+  }
+  BatchColumns cols = {candidates, NULL, NULL, NULL, NULL, NULL, NULL, n,
+                       BATCH_WORDS(n), duration, calendar};
+  cols.seconds = malloc(n * sizeof(int32_t));
+  cols.weekday = malloc(n);
+  cols.month = malloc(n);
+  cols.mday = malloc(n);
+  cols.month_length = malloc(n);
+  cols.holiday = malloc(n);
+  uint64_t *converted = calloc(cols.words, sizeof(uint64_t));
+  bool ok = cols.seconds && cols.weekday && cols.month && cols.mday &&
+            cols.month_length && cols.holiday && converted;
+
+  // One local time conversion per candidate; the holiday table is only
+  // consulted when the date changes
+  int last_year = -1;
+  int last_yday = -1;
+  unsigned char last_holiday = 0;
+  unsigned char last_length = 0;
+  for (size_t i = 0; ok && i < n; i++) {
+    struct tm *tm_time = localtime(&candidates[i]);
+    if (!tm_time) {
+      cols.seconds[i] = 0;
+      cols.weekday[i] = 0;
+      cols.month[i] = 0;
+      cols.mday[i] = 0;
+      cols.month_length[i] = 0;
+      cols.holiday[i] = 0;
+      continue; // Unconvertible candidates never match
+    }
+    converted[i / 64] |= (uint64_t)1 << (i % 64);
+    cols.seconds[i] =
+        tm_time->tm_hour * 60 * 60 + tm_time->tm_min * 60 + tm_time->tm_sec;
+    cols.weekday[i] = (unsigned char)tm_time->tm_wday;
+    cols.month[i] = (unsigned char)tm_time->tm_mon;
+    cols.mday[i] = (unsigned char)tm_time->tm_mday;
+    if (tm_time->tm_year != last_year || tm_time->tm_yday != last_yday) {
+      last_year = tm_time->tm_year;
+      last_yday = tm_time->tm_yday;
+      last_holiday = is_holiday(calendar, tm_time);
+      last_length = (unsigned char)days_in_month(
+          (unsigned)tm_time->tm_mon + 1, (unsigned)tm_time->tm_year + 1900);
+    }
+    cols.month_length[i] = last_length;
+    cols.holiday[i] = last_holiday;
+  }
+
+  ok = ok && eval_batch(filter, &cols, out_bits);
+  if (ok) {
+    for (size_t w = 0; w < cols.words; w++) {
+      out_bits[w] &= converted[w];
+    }
+  }
+  free(cols.seconds);
+  free(cols.weekday);
+  free(cols.month);
+  free(cols.mday);
+  free(cols.month_length);
+  free(cols.holiday);
+  free(converted);
+  return ok;
+}
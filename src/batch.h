@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "calendar.h"
+#include "filter.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Batch filter evaluation for candidate grids.
+//
+// Every candidate is converted to its local date fields, second of the day
+// and holiday flag once, into flat arrays. Each leaf of the filter then runs as
+// one tight loop over those arrays, packing its results 64 candidates to a
+// word, and AND/OR/NOT combine whole words at a time.
+
+// Number of 64-bit words needed for n result bits
+#define BATCH_WORDS(n) (((n) + 63) / 64)
+
+// Evaluates the filter for each of the n candidates: bit i of out_bits
+// (word i / 64, bit i % 64) is set when candidates[i] satisfies the filter,
+// as evaluate_filter would report. out_bits needs BATCH_WORDS(n) words.
+// Returns false on allocation failure.
+bool evaluate_filter_batch(const Filter *filter, const time_t *candidates,
+                           const size_t n, const time_t duration,
+                           const Calendar *calendar, uint64_t *out_bits);
+
+#endif // BATCH_H
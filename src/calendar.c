@@ -1,5 +1,8 @@
 #include "calendar.h"
+#include "archive.h"
 #include "event_list.h"
+#include "gap_index.h"
+#include "holiday.h"
 #include <stdlib.h>
 
 Calendar *create_calendar() {
@@ -21,6 +24,7 @@ static YearBucket *create_year_bucket(const unsigned year) {
     return NULL;
   }
   year_bucket->year = year;
+  year_bucket->dirty = true; // Never persisted yet
   return year_bucket;
 }
 
@@ -37,6 +41,9 @@ void free_calendar(Calendar *calendar) {
     return;
   }
   free_years(calendar->years);
+  free_year_archives(calendar->archives);
+  free_holidays(calendar->holidays);
+  free_gap_index(calendar->gaps);
   destroy_event_list(calendar->event_list);
   free(calendar);
 }
@@ -72,6 +79,64 @@ unsigned days_in_month(const unsigned month, const unsigned year) {
   }
 }
 
+time_t year_start_time(const unsigned year) {
+  struct tm tm_year = {0};
+  tm_year.tm_year = (int)year - 1900;
+  tm_year.tm_mday = 1;
+  tm_year.tm_isdst = -1;
+  return mktime(&tm_year);
+}
+
+struct tm *local_time(const time_t time, struct tm *out) {
+#ifdef _WIN32
+  return localtime_s(out, &time) == 0 ? out : NULL;
+#else
+  return localtime_r(&time, out);
+#endif
+}
+
+// How far the reading of the clock is past `seconds` since midnight,
+// wrapping around the day
+static time_t clock_ahead(const struct tm *tm, const time_t seconds) {
+  const time_t day = 24 * 60 * 60;
+  const time_t reads = tm->tm_hour * 60 * 60 + tm->tm_min * 60 + tm->tm_sec;
+  return ((reads - seconds) % day + day) % day;
+}
+
+time_t wall_clock_time(const int year, const int mon, const int mday,
+                       const time_t seconds) {
+  struct tm date = {0};
+  date.tm_year = year - 1900;
+  date.tm_mon = mon;
+  date.tm_mday = mday;
+  date.tm_hour = (int)(seconds / 3600);
+  date.tm_min = (int)(seconds / 60 % 60);
+  date.tm_sec = (int)(seconds % 60);
+  date.tm_isdst = -1;
+  const time_t placed = mktime(&date);
+  // mktime moves a time the clocks skip over forward by the length of the
+  // jump; before the jump the clock reads earlier than wanted
+  const time_t jump = clock_ahead(&date, seconds);
+  if (placed == -1 || jump == 0) {
+    return placed;
+  }
+  time_t before = placed - jump;
+  time_t after = placed;
+  while (after - before > 1) {
+    const time_t middle = before + (after - before) / 2;
+    struct tm tm;
+    if (!local_time(middle, &tm)) {
+      break;
+    }
+    if (clock_ahead(&tm, seconds) <= jump) {
+      after = middle;
+    } else {
+      before = middle;
+    }
+  }
+  return after;
+}
+
 // Returns the day of the year (1-365 or 1-366 for leap years)
 // for the given date
 //
@@ -150,6 +215,11 @@ void add_event_cal_(Calendar *calendar, Event *event) {
     }
     current_year = new_year;
   }
+  current_year->dirty = true;
+  if (calendar->gaps &&
+      !gap_index_add(calendar->gaps, event->start_time, event->end_time)) {
+    invalidate_gap_index(calendar); // Rebuilt on next use
+  }
   // Insert the event into the correct day bucket if it's the first event of the
   // day
   if (!current_year->days[day_of_year - 1]) {
@@ -167,23 +237,35 @@ Event *add_event_calendar(Calendar *calendar, const char *title,
   if (!calendar || !calendar->event_list) {
     return NULL;
   }
+  // An archived year must be resident before it gains events, otherwise the
+  // archive would later be merged on top of them
+  struct tm *tm_start = localtime(&start);
+  if (tm_start) {
+    ensure_year_loaded(calendar, tm_start->tm_year + 1900);
+  }
   Event *event =
       add_event_to_list(calendar->event_list, title, description, start, end);
   if (!event) {
     return NULL;
   }
   add_event_cal_(calendar, event);
+  calendar->generation++;
   return event;
 }
 
-Event *remove_event_calendar(Calendar *calendar, const EventID id) {
+// Unlinks an event from the event list and year buckets
+static Event *unlink_event_calendar(Calendar *calendar, const EventID id) {
   if (!calendar || !calendar->event_list) {
     return NULL;
   }
   Event *event = remove_event(calendar->event_list, id);
+  if (!event && load_all_archives(calendar)) {
+    event = remove_event(calendar->event_list, id);
+  }
   if (!event) {
     return NULL; // Not found
   }
+  calendar->generation++;
   YearDay *year_day = get_year_day_from_event(event);
   if (!year_day) {
     return event; // Failed to get year/day, should not happen
@@ -191,6 +273,10 @@ Event *remove_event_calendar(Calendar *calendar, const EventID id) {
   unsigned year = year_day->year;
   size_t day_of_year = year_day->day_of_year;
   free(year_day);
+  YearBucket *bucket = get_year_bucket(calendar, year);
+  if (bucket) {
+    bucket->dirty = true;
+  }
   YearBucket *current_year = calendar->years;
   while (current_year) {
     if (current_year->year < year) {
@@ -230,11 +316,51 @@ Event *remove_event_calendar(Calendar *calendar, const EventID id) {
   return event; // Year not found, but event already removed
 }
 
+Event *remove_event_calendar(Calendar *calendar, const EventID id) {
+  Event *event = unlink_event_calendar(calendar, id);
+  // The index reads the day buckets, so it is updated once they are
+  if (event && calendar->gaps &&
+      !gap_index_remove(calendar->gaps, calendar, event->start_time)) {
+    invalidate_gap_index(calendar);
+  }
+  return event;
+}
+
 Event *get_event_calendar(const Calendar *calendar, const EventID id) {
   if (!calendar || !calendar->event_list) {
     return NULL;
   }
-  return find_event_by_id(calendar->event_list, id);
+  Event *event = find_event_by_id(calendar->event_list, id);
+  if (!event && load_all_archives(calendar)) {
+    event = find_event_by_id(calendar->event_list, id);
+  }
+  return event;
+}
+
+YearBucket *get_year_bucket(const Calendar *calendar, const unsigned year) {
+  if (!calendar) {
+    return NULL;
+  }
+  for (YearBucket *bucket = calendar->years; bucket && bucket->year <= year;
+       bucket = bucket->next) {
+    if (bucket->year == year) {
+      return bucket;
+    }
+  }
+  return NULL;
+}
+
+Event *get_first_event_of_year(const Calendar *calendar, const unsigned year) {
+  YearBucket *bucket = get_year_bucket(calendar, year);
+  if (!bucket) {
+    return NULL;
+  }
+  for (size_t d = 0; d < 366; d++) {
+    if (bucket->days[d]) {
+      return bucket->days[d];
+    }
+  }
+  return NULL;
 }
 
 Event *get_first_event(Calendar *calendar, const unsigned year,
@@ -246,6 +372,7 @@ Event *get_first_event(Calendar *calendar, const unsigned year,
   if (day_of_year == (size_t)-1) {
     return NULL; // Invalid date
   }
+  ensure_year_loaded(calendar, year);
   YearBucket *current_year = calendar->years;
   while (current_year) {
     if (current_year->year == year) {
@@ -258,6 +385,51 @@ Event *get_first_event(Calendar *calendar, const unsigned year,
   return NULL; // Year not found
 }
 
+Event *detach_calendar_year(Calendar *calendar, const unsigned year) {
+  if (!calendar || !calendar->event_list) {
+    return NULL;
+  }
+  YearBucket *prev = NULL;
+  YearBucket *bucket = calendar->years;
+  while (bucket && bucket->year < year) {
+    prev = bucket;
+    bucket = bucket->next;
+  }
+  if (!bucket || bucket->year != year) {
+    return NULL;
+  }
+  invalidate_gap_index(calendar);
+  Event *first = get_first_event_of_year(calendar, year);
+  if (prev) {
+    prev->next = bucket->next;
+  } else {
+    calendar->years = bucket->next;
+  }
+  free(bucket);
+  if (!first) {
+    return NULL;
+  }
+
+  // Events of one year are contiguous in the sorted list
+  const time_t year_end = year_start_time(year + 1);
+  Event *last = first;
+  while (last->next && last->next->start_time < year_end) {
+    last = last->next;
+  }
+  return detach_event_range(calendar->event_list, first, last);
+}
+
+void attach_calendar_events(Calendar *calendar, Event *chain) {
+  if (!calendar || !calendar->event_list) {
+    return;
+  }
+  // Indexing only needs start times, so do it before the merge relinks them
+  for (Event *event = chain; event; event = event->next) {
+    add_event_cal_(calendar, event);
+  }
+  merge_sorted_events(calendar->event_list, chain);
+}
+
 bool save_calendar_events(const Calendar *calendar, const char *filename) {
   if (!calendar || !calendar->event_list) {
     return false;
@@ -270,7 +442,10 @@ bool load_calendar_events(Calendar *cal, const char *filename) {
     return false;
   }
   load_events(cal->event_list, filename);
-  // Rebuild year buckets
+  cal->generation++;
+  invalidate_gap_index(cal);
+  // Rebuild year buckets; load_events leaves the list sorted
+  free_years(cal->years);
   cal->years = NULL;
   Event *current = cal->event_list->head;
   while (current) {
@@ -297,11 +472,12 @@ static Event *find_event_in_bucket(const YearBucket *bucket,
 }
 
 Event *get_event_on_or_before(const Calendar *calendar, const time_t time) {
-  if (!calendar || !calendar->years) {
+  if (!calendar) {
     return NULL;
   }
 
-  struct tm *tm_time = localtime(&time);
+  struct tm local;
+  struct tm *tm_time = local_time(time, &local);
   if (!tm_time) {
     return NULL;
   }
@@ -311,23 +487,33 @@ Event *get_event_on_or_before(const Calendar *calendar, const time_t time) {
   if (target_day_of_year == (size_t)-1) {
     return NULL;
   }
+  ensure_year_loaded(calendar, target_year);
 
-  // Build array of bucket pointers up to and including target year
-  YearBucket *buckets[128];
-  int bucket_count = 0;
-  for (YearBucket *b = calendar->years;
-       b && b->year <= target_year && bucket_count < 128; b = b->next) {
-    buckets[bucket_count++] = b;
-  }
-
-  // Search backwards through buckets
   Event *candidate = NULL;
-  for (int i = bucket_count - 1; i >= 0 && !candidate; i--) {
-    size_t max_day = (buckets[i]->year == target_year)
-                         ? target_day_of_year
-                         : days_in_year(buckets[i]->year);
-    candidate = find_event_in_bucket(buckets[i], max_day);
-  }
+  unsigned candidate_year = 0;
+  do {
+    candidate = NULL;
+    candidate_year = 0;
+    // Build array of bucket pointers up to and including target year
+    YearBucket *buckets[128];
+    int bucket_count = 0;
+    for (YearBucket *b = calendar->years;
+         b && b->year <= target_year && bucket_count < 128; b = b->next) {
+      buckets[bucket_count++] = b;
+    }
+
+    // Search backwards through buckets
+    for (int i = bucket_count - 1; i >= 0 && !candidate; i--) {
+      size_t max_day = (buckets[i]->year == target_year)
+                           ? target_day_of_year
+                           : days_in_year(buckets[i]->year);
+      candidate = find_event_in_bucket(buckets[i], max_day);
+      candidate_year = buckets[i]->year;
+    }
+    // An archived year between the candidate and the target may hold a later
+    // event; decode it and search again
+  } while (load_archive_between(calendar, candidate ? candidate_year : 0,
+                                target_year));
 
   // Iterate forward to find the last event with start_time <= time
   Event *result = NULL;
@@ -7,13 +7,25 @@
 typedef struct YearBucket {
   Event *days[366];
   unsigned year;
+  bool dirty; // changed since it was last persisted (see segment.h)
   struct YearBucket *next;
 } YearBucket;
 
+struct YearArchive; // see archive.h
+struct HolidaySet;  // see holiday.h
+struct GapIndex;    // see gap_index.h
+
 // The main calendar structure
 typedef struct Calendar {
   YearBucket *years;     // linked list of year buckets, sorted by year
   EventList *event_list; // master event list
+  struct YearArchive *archives; // compressed past years, decoded on first use
+  struct HolidaySet *holidays;  // NULL: the built-in holidays
+  struct GapIndex *gaps;        // busy intervals, built on first use
+  // Bumped whenever the events (or the holiday set) change, so cached
+  // query results can tell whether they are stale (see query_cache.h)
+  unsigned long generation;
+  unsigned long holiday_generation;
 } Calendar;
 
 Calendar *create_calendar();
@@ -29,6 +41,12 @@ Event *add_event_calendar(Calendar *calendar, const char *title,
 // Returns pointer to removed event, or NULL if not found
 Event *remove_event_calendar(Calendar *calendar, const EventID id);
 
+// Returns the bucket for the specified year, or NULL if it has none
+YearBucket *get_year_bucket(const Calendar *calendar, const unsigned year);
+
+// Returns the earliest event of the specified year, or NULL if none
+Event *get_first_event_of_year(const Calendar *calendar, const unsigned year);
+
 // Returns pointer to the first event on the specified date, or NULL if none
 Event *get_first_event(Calendar *calendar, const unsigned year,
                        const unsigned month, const unsigned day);
@@ -41,10 +59,30 @@ Event *get_event_calendar(const Calendar *calendar, const EventID id);
 // slots Returns NULL if no such event exists
 Event *get_event_on_or_before(const Calendar *calendar, const time_t time);
 
+// Unlinks every event starting in `year` from the calendar and drops its year
+// bucket. Returns the events as a sorted NULL-terminated chain owned by the
+// caller, or NULL if the year has no events.
+Event *detach_calendar_year(Calendar *calendar, const unsigned year);
+// Merges a sorted chain of events (keeping their IDs) into the event list and
+// indexes them in the year buckets
+void attach_calendar_events(Calendar *calendar, Event *chain);
+
 bool load_calendar_events(Calendar *calendar, const char *filename);
 bool save_calendar_events(const Calendar *calendar, const char *filename);
 
 bool is_leap_year(const unsigned year);
 unsigned days_in_month(const unsigned month, const unsigned year);
+// Returns the local time of January 1st, 00:00 of the given year
+time_t year_start_time(const unsigned year);
+// Converts a time to local time in *out without the shared buffer of
+// localtime, so it may be called from several threads. Returns out, or NULL
+// if the time cannot be converted.
+struct tm *local_time(const time_t time, struct tm *out);
+// Returns the first time at which the local clock reads `seconds` past
+// midnight on the given day (month 0-11; day and month may run past the end
+// of the month or year) or later. That is the time itself, unless the
+// clocks spring forward over it: then it is the moment they do.
+time_t wall_clock_time(const int year, const int mon, const int mday,
+                       const time_t seconds);
 
 #endif // CALENDAR_H
@@ -1,4 +1,5 @@
 #include "event_list.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -133,6 +134,153 @@ Event *find_event_by_id(const EventList *list, const EventID id) {
   return NULL;
 }
 
+Event *make_event(EventList *list, const char *title, const char *desc,
+                  const time_t start, const time_t end) {
+  Event *event = create_event(title, desc, start, end);
+  if (!event)
+    return NULL;
+  event->id = list->next_id++;
+  return event;
+}
+
+// Sort key with the sign bit flipped so negative times order first
+static uint64_t start_key(const Event *event) {
+  return (uint64_t)(int64_t)event->start_time ^ ((uint64_t)1 << 63);
+}
+
+// One stable counting pass over byte `shift / 8` of the key. Returns false,
+// without moving anything, when every key has the same byte there.
+static bool radix_pass(Event **from, Event **to, const size_t n,
+                       const unsigned shift, const bool by_start) {
+  size_t counts[256] = {0};
+  for (size_t i = 0; i < n; i++) {
+    uint64_t key = by_start ? start_key(from[i]) : from[i]->id;
+    counts[(key >> shift) & 0xff]++;
+  }
+  for (size_t b = 0; b < 256; b++) {
+    if (counts[b] == n)
+      return false;
+    if (counts[b])
+      break;
+  }
+  size_t offset = 0;
+  for (size_t b = 0; b < 256; b++) {
+    size_t count = counts[b];
+    counts[b] = offset;
+    offset += count;
+  }
+  for (size_t i = 0; i < n; i++) {
+    uint64_t key = by_start ? start_key(from[i]) : from[i]->id;
+    to[counts[(key >> shift) & 0xff]++] = from[i];
+  }
+  return true;
+}
+
+Event *sort_event_chain(Event *chain) {
+  size_t n = 0;
+  for (Event *e = chain; e; e = e->next)
+    n++;
+  if (n < 2)
+    return chain;
+  Event **events = malloc(n * sizeof(Event *));
+  Event **scratch = malloc(n * sizeof(Event *));
+  if (!events || !scratch) {
+    free(events);
+    free(scratch);
+    return chain; // Left as is
+  }
+  size_t i = 0;
+  for (Event *e = chain; e; e = e->next)
+    events[i++] = e;
+
+  // Least significant key first: id bytes, then start_time bytes. Bytes that
+  // are equal across all events (e.g. the high bytes of nearby times) are
+  // skipped, so typical inputs take a handful of passes.
+  for (unsigned shift = 0; shift < 8 * sizeof(EventID); shift += 8) {
+    if (radix_pass(events, scratch, n, shift, false)) {
+      Event **swap = events;
+      events = scratch;
+      scratch = swap;
+    }
+  }
+  for (unsigned shift = 0; shift < 64; shift += 8) {
+    if (radix_pass(events, scratch, n, shift, true)) {
+      Event **swap = events;
+      events = scratch;
+      scratch = swap;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    events[i]->parent = i > 0 ? events[i - 1] : NULL;
+    events[i]->next = i + 1 < n ? events[i + 1] : NULL;
+  }
+  Event *head = events[0];
+  free(events);
+  free(scratch);
+  return head;
+}
+
+void sort_events(EventList *list) {
+  list->head = sort_event_chain(list->head);
+  list->tail = list->head;
+  while (list->tail && list->tail->next)
+    list->tail = list->tail->next;
+}
+
+void merge_sorted_events(EventList *list, Event *chain) {
+  Event *prev = NULL;
+  Event *current = list->head;
+  while (chain) {
+    Event *event = chain;
+    chain = chain->next;
+    if (event->id >= list->next_id)
+      list->next_id = event->id + 1;
+
+    // Advance past events that start no later than the new one, so equal
+    // start times keep their existing order
+    while (current && current->start_time <= event->start_time) {
+      prev = current;
+      current = current->next;
+    }
+    event->parent = prev;
+    event->next = current;
+    if (prev)
+      prev->next = event;
+    else
+      list->head = event;
+    if (current)
+      current->parent = event;
+    else
+      list->tail = event;
+    prev = event;
+  }
+}
+
+Event *detach_event_range(EventList *list, Event *first, Event *last) {
+  if (!first || !last)
+    return NULL;
+  if (first->parent)
+    first->parent->next = last->next;
+  else
+    list->head = last->next;
+  if (last->next)
+    last->next->parent = first->parent;
+  else
+    list->tail = first->parent;
+  first->parent = NULL;
+  last->next = NULL;
+  return first;
+}
+
+void free_event_chain(Event *chain) {
+  while (chain) {
+    Event *next = chain->next;
+    free(chain);
+    chain = next;
+  }
+}
+
 void list_events(const EventList *list, const time_t start_date,
                  const time_t end_date) {
   Event *current = list->head;
@@ -152,6 +300,12 @@ void list_events(const EventList *list, const time_t start_date,
   }
 }
 
+void write_event(FILE *file, const Event *event) {
+  fprintf(file, "%d|%s|%s|%lld|%lld\n", event->id, event->title,
+          event->description, (long long)event->start_time,
+          (long long)event->end_time);
+}
+
 bool save_events(const EventList *list, const char *filename) {
   if (!list->head)
     return false;
@@ -160,20 +314,55 @@ bool save_events(const EventList *list, const char *filename) {
     return false;
   Event *current = list->head;
   while (current) {
-    fprintf(file, "%d|%s|%s|%lld|%lld\n", current->id, current->title,
-            current->description, current->start_time, current->end_time);
+    write_event(file, current);
     current = current->next;
   }
   fclose(file);
   return true;
 }
 
+// Returns the next '|'-separated field of a line and advances past it.
+// Missing trailing fields read as empty strings.
+static char *next_field(char **cursor) {
+  char *field = *cursor;
+  char *end = strchr(field, '|');
+  if (end) {
+    *end = '\0';
+    *cursor = end + 1;
+  } else {
+    *cursor = field + strlen(field);
+  }
+  return field;
+}
+
+void read_event(char *line, Event *event) {
+  // Fields may be empty (e.g. no description), so split on every '|'
+  char *cursor = line;
+  char *token = next_field(&cursor);
+  event->id = atoi(token);
+
+  token = next_field(&cursor);
+  strncpy(event->title, token, 255);
+  event->title[255] = '\0';
+
+  token = next_field(&cursor);
+  strncpy(event->description, token, 1023);
+  event->description[1023] = '\0';
+
+  token = next_field(&cursor);
+  event->start_time = atol(token);
+
+  token = next_field(&cursor);
+  event->end_time = atol(token);
+}
+
 bool load_events(EventList *list, const char *filename) {
   FILE *file = fopen(filename, "r");
   if (!file)
     return false;
 
   char line[2048];
+  bool sorted = true;
   while (fgets(line, sizeof(line), file)) {
     Event *event = malloc(sizeof(Event));
     if (!event) {
@@ -181,22 +370,7 @@ bool load_events(EventList *list, const char *filename) {
       fclose(file);
       return false;
     }
-    char *token = strtok(line, "|");
-    event->id = atoi(token);
-
-    token = strtok(NULL, "|");
-    strncpy(event->title, token, 255);
-    event->title[255] = '\0';
-
-    token = strtok(NULL, "|");
-    strncpy(event->description, token, 1023);
-    event->description[1023] = '\0';
-
-    token = strtok(NULL, "|");
-    event->start_time = atol(token);
-
-    token = strtok(NULL, "|");
-    event->end_time = atol(token);
+    read_event(line, event);
 
     event->next = NULL;
 
@@ -204,7 +378,13 @@ bool load_events(EventList *list, const char *filename) {
       list->next_id = event->id + 1;
     }
 
-    // assume events are already sorted in the file
+    // Files are normally written in order; hand edits and concatenated
+    // exports may not be, so only note it here and sort once at the end
+    if (list->tail && (event->start_time < list->tail->start_time ||
+                       (event->start_time == list->tail->start_time &&
+                        event->id < list->tail->id))) {
+      sorted = false;
+    }
     if (!list->head) {
       list->head = event;
       list->tail = event;
@@ -217,5 +397,7 @@ bool load_events(EventList *list, const char *filename) {
   }
 
   fclose(file);
+  if (!sorted)
+    sort_events(list);
   return true;
 }
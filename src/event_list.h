@@ -2,6 +2,7 @@
 #define EVENT_LIST_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <time.h>
 
 typedef unsigned EventID;
@@ -29,8 +30,32 @@ Event *add_event_to_list(EventList *list, const char *title, const char *desc,
                          const time_t start, const time_t end);
 Event *remove_event(EventList *list, const EventID id);
 Event *find_event_by_id(const EventList *list, const EventID id);
+
+// Allocates an event with the list's next ID without linking it anywhere.
+// Bulk loaders build chains of these and hand them to merge_sorted_events.
+Event *make_event(EventList *list, const char *title, const char *desc,
+                  const time_t start, const time_t end);
+// Sorts a NULL-terminated chain by start_time, then id, with an LSD radix
+// sort; parent links are rebuilt. Returns the new head.
+Event *sort_event_chain(Event *chain);
+// Sorts the whole list (see sort_event_chain) and fixes up head and tail
+void sort_events(EventList *list);
+// Merges a NULL-terminated chain of events, already sorted by start_time, into
+// the list in a single pass. Event IDs are kept and next_id is advanced past
+// them.
+void merge_sorted_events(EventList *list, Event *chain);
+// Unlinks the contiguous run of events first..last from the list and returns
+// it as a NULL-terminated chain
+Event *detach_event_range(EventList *list, Event *first, Event *last);
+// Frees every event of a NULL-terminated chain
+void free_event_chain(Event *chain);
 void list_events(const EventList *list, const time_t start_date,
                  const time_t end_date);
+// Parses one line written by write_event into the event's id, title,
+// description and times; links are left untouched. Modifies the line.
+void read_event(char *line, Event *event);
+// Writes one event as a line of the `id|title|description|start|end` format
+void write_event(FILE *file, const Event *event);
 bool save_events(const EventList *list, const char *filename);
 bool load_events(EventList *list, const char *filename);
 
@@ -1,97 +1,11 @@
 #include "filter.h"
 #include "calendar.h"
+#include "gap_index.h"
+#include "holiday.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef struct {
-  char month;
-  char day;
-} month_day;
-
-static const month_day holidays[] = {
-    {1, 1},   // New Year's Day
-    {7, 4},   // Independence Day
-    {12, 25}, // Christmas Day
-    {12, 31}, // New Year's Eve
-};
-const size_t num_holidays = sizeof(holidays) / sizeof(holidays[0]);
-
-static time_t until_day_of_week(const time_t t, const int target_day) {
-  struct tm *tm_time = localtime(&t);
-  int current_day = tm_time->tm_wday;
-  if (current_day == target_day) {
-    return 0;
-  }
-  time_t days_ahead = (target_day - current_day + 7) % 7;
-  if (days_ahead == 0)
-    days_ahead = 7;
-  time_t today =
-      tm_time->tm_hour * 60 * 60 + tm_time->tm_min * 60 + tm_time->tm_sec;
-  return days_ahead * 1440 * 60 - today;
-}
-
-// Returns the time in seconds until the next holiday from time t.
-static time_t until_holiday(const struct tm *time) {
-  // Today is a holiday
-  for (size_t i = 0; i < num_holidays; ++i) {
-    if (time->tm_mon + 1 == holidays[i].month &&
-        time->tm_mday == holidays[i].day) {
-      return 0;
-    }
-  }
-
-  // Build a time_t for "now"
-  struct tm now_tm = *time;
-  now_tm.tm_isdst = -1;
-  time_t now_ts = mktime(&now_tm);
-
-  // Find the next holiday in the current year at 00:00:00
-  time_t best_diff = (time_t)-1;
-  for (size_t i = 0; i < num_holidays; ++i) {
-    struct tm target = *time;
-    target.tm_year = time->tm_year; // same year
-    target.tm_mon = holidays[i].month - 1;
-    target.tm_mday = holidays[i].day;
-    target.tm_hour = 0;
-    target.tm_min = 0;
-    target.tm_sec = 0;
-    target.tm_isdst = -1;
-    time_t target_ts = mktime(&target);
-    double diff = difftime(target_ts, now_ts);
-    if (diff >= 0) {
-      if (best_diff == (time_t)-1 || (time_t)diff < best_diff) {
-        best_diff = (time_t)diff;
-      }
-    }
-  }
-
-  // If none in current year, take the earliest in the next year
-  if (best_diff == (time_t)-1) {
-    time_t next_best = (time_t)-1;
-    for (size_t i = 0; i < num_holidays; ++i) {
-      struct tm target = *time;
-      target.tm_year = time->tm_year + 1; // next year
-      target.tm_mon = holidays[i].month - 1;
-      target.tm_mday = holidays[i].day;
-      target.tm_hour = 0;
-      target.tm_min = 0;
-      target.tm_sec = 0;
-      target.tm_isdst = -1;
-      time_t target_ts = mktime(&target);
-      double diff = difftime(target_ts, now_ts);
-      if (diff >= 0) {
-        if (next_best == (time_t)-1 || (time_t)diff < next_best) {
-          next_best = (time_t)diff;
-        }
-      }
-    }
-    return next_best == (time_t)-1 ? 0 : next_best;
-  }
-
-  return best_diff;
-}
-
 // Helper to find time until candidate is at least dist
 // away from any event boundary (start or end).
 // Negative distance allowed to permit overlaps.
@@ -104,8 +18,15 @@ static time_t time_til_distance(const time_t start, const time_t duration,
   time_t guess = start;
   const time_t pad = dist * 60; // minutes -> seconds
 
+  // Also decodes the archived years the check reaches back into
   Event *current = get_event_on_or_before(calendar, guess);
-  if (!current) {
+  // Negative padding lets events overlap, which merged busy intervals can't
+  // express: walk the events instead
+  GapIndex *gaps = pad >= 0 ? calendar_gap_index(calendar) : NULL;
+  if (gaps) {
+    guess = gap_index_next_free(gaps, start, duration, pad);
+    current = NULL;
+  } else if (!current) {
     current = list->head;
   }
   for (; current; current = current->next) {
@@ -126,195 +47,932 @@ static time_t time_til_distance(const time_t start, const time_t duration,
 
   return guess - start;
 }
-// Helper to create a time_t for today with the time from a filter.
-static time_t get_time_on_date(const struct tm *date_tm, time_t time_val) {
-  struct tm temp_tm = *date_tm;
-  struct tm *time_tm = localtime(&time_val);
-  temp_tm.tm_hour = time_tm->tm_hour;
-  temp_tm.tm_min = time_tm->tm_min;
-  temp_tm.tm_sec = time_tm->tm_sec;
-  temp_tm.tm_isdst = -1; // Let mktime figure out DST
-  return mktime(&temp_tm);
+
+// time_til_distance looking back: how far before start the latest event of
+// `duration` begins that keeps dist minutes away from every event
+static time_t time_since_distance(const time_t start, const time_t duration,
+                                  const time_t dist,
+                                  const Calendar *calendar) {
+  if (!calendar || !calendar->event_list || !calendar->event_list->head) {
+    return 0;
+  }
+  time_t guess = start;
+  const time_t pad = dist * 60; // minutes -> seconds
+
+  // Decodes the archived year of start; earlier ones are decoded as the
+  // search reaches them, and their events can only move it further back
+  Event *current = get_event_on_or_before(calendar, guess);
+  GapIndex *gaps = pad >= 0 ? calendar_gap_index(calendar) : NULL;
+  if (gaps) {
+    return start - gap_index_prev_free(gaps, start, duration, pad);
+  }
+  // The list only runs forward: scan from the events around the guess and,
+  // once one is in the way, move before it and look up the events around
+  // the new guess
+  if (!current) {
+    current = calendar->event_list->head;
+  }
+  while (current && current->start_time < guess + duration + pad) {
+    if (guess < current->end_time + pad) {
+      guess = current->start_time - pad - duration;
+      current = get_event_on_or_before(calendar, guess);
+      if (!current) {
+        current = calendar->event_list->head;
+      }
+    } else {
+      current = current->next;
+    }
+  }
+  return start - guess;
+}
+// Fills in the instruction for a single node
+static void lower_node(const Filter *filter, FilterInstr *instr) {
+  instr->type = filter->type;
+  instr->jump = 0;
+  switch (filter->type) {
+  case FILTER_DAY_OF_WEEK:
+    instr->arg.day_of_week = filter->data.day_of_week;
+    break;
+  case FILTER_AFTER_DATETIME:
+  case FILTER_BEFORE_DATETIME:
+    instr->arg.time_value = filter->data.time_value;
+    break;
+  case FILTER_AFTER_TIME:
+  case FILTER_BEFORE_TIME:
+    instr->arg.seconds = filter->data.seconds;
+    break;
+  case FILTER_MIN_DISTANCE:
+    instr->arg.minutes = filter->data.minutes;
+    break;
+  case FILTER_DAY_MASK:
+    instr->arg.day_mask = filter->data.day_mask;
+    break;
+  case FILTER_TIME_WINDOW:
+    instr->arg.window.start = filter->data.window.start;
+    instr->arg.window.end = filter->data.window.end;
+    break;
+  case FILTER_MONTH_MASK:
+    instr->arg.month_mask = filter->data.month_mask;
+    break;
+  case FILTER_MONTH_DAYS:
+    instr->arg.month_days = filter->data.month_days;
+    break;
+  case FILTER_NTH_WEEKDAY:
+    instr->arg.nth.week = filter->data.nth.week;
+    instr->arg.nth.day_of_week = filter->data.nth.day_of_week;
+    break;
+  case FILTER_DATE_RANGE:
+    instr->arg.window.start = filter->data.range.start;
+    instr->arg.window.end = filter->data.range.end;
+    break;
+  default:
+    break;
+  }
+}
+
+// Time until valid and time until invalid of one node; -1 means never
+typedef struct FilterValue {
+  time_t until_valid;
+  time_t until_invalid;
+} FilterValue;
+
+// Local midnight starting the given day; month and day may run past the
+// end of the year or month
+static time_t local_date_start(const int year, const int mon, const int mday) {
+  struct tm date = {0};
+  date.tm_year = year - 1900;
+  date.tm_mon = mon;
+  date.tm_mday = mday;
+  date.tm_isdst = -1;
+  return mktime(&date);
 }
 
-// Helper to calculate time until midnight.
-static time_t until_midnight(const struct tm *tm_time) {
-  return 1440 * 60 -
-         (tm_time->tm_hour * 60 * 60 + tm_time->tm_min * 60 + tm_time->tm_sec);
+static bool is_local_midnight(const time_t t) {
+  struct tm tm;
+  return local_time(t, &tm) && tm.tm_hour == 0 && tm.tm_min == 0 &&
+         tm.tm_sec == 0;
 }
 
-static time_t until_invalid(const Filter *filter, const time_t candidate,
-                            const time_t duration, const Calendar *calendar) {
-  if (!filter || filter->type == FILTER_NONE) {
-    return -1; // Always valid, never invalid.
+// A candidate with its local time, derived once and shared by every node
+typedef struct {
+  time_t time;
+  struct tm tm;
+  time_t seconds;   // wall clock time since local midnight
+  time_t day_start; // local midnight
+  time_t day_end;   // the next local midnight
+} EvalPoint;
+
+static bool make_eval_point(EvalPoint *point, const time_t candidate) {
+  struct tm *tm_candidate = local_time(candidate, &point->tm);
+  if (!tm_candidate) {
+    return false;
+  }
+  point->time = candidate;
+  point->seconds = tm_candidate->tm_hour * 60 * 60 +
+                   tm_candidate->tm_min * 60 + tm_candidate->tm_sec;
+  // Midnight is `seconds` ago and the next one a day later, unless the
+  // clock changes in between
+  const int year = tm_candidate->tm_year + 1900;
+  point->day_start = candidate - point->seconds;
+  if (!is_local_midnight(point->day_start)) {
+    point->day_start =
+        local_date_start(year, tm_candidate->tm_mon, tm_candidate->tm_mday);
   }
+  point->day_end = point->day_start + 24 * 60 * 60;
+  if (!is_local_midnight(point->day_end)) {
+    point->day_end = local_date_start(year, tm_candidate->tm_mon,
+                                      tm_candidate->tm_mday + 1);
+  }
+  return true;
+}
 
-  // A time is invalid if it's not valid.
-  // If it's already valid (next valid is 0), we need to find when it
-  // becomes invalid. Otherwise, it's already invalid (next valid > 0).
-  if (until_valid(filter, candidate, duration, calendar) > 0) {
-    return 0; // Already invalid.
+// The time `seconds` past midnight by the wall clock, `days` after the
+// candidate's day. On a day with a clock change that is not `seconds`
+// after the real midnight: 09:00 is 8 hours after it in spring.
+static time_t wall_time(const EvalPoint *point, const int days,
+                        const time_t seconds) {
+  if (days == 0 && point->day_end - point->day_start == 24 * 60 * 60) {
+    return point->day_start + seconds;
+  }
+  if (days == 0) {
+    // The difference on the clock holds unless it changes in between; this
+    // also keeps to the candidate's pass of the hour repeated in autumn
+    const time_t near = point->time + seconds - point->seconds;
+    struct tm tm;
+    if (local_time(near, &tm) && tm.tm_mday == point->tm.tm_mday &&
+        tm.tm_hour * 60 * 60 + tm.tm_min * 60 + tm.tm_sec == seconds) {
+      return near;
+    }
   }
+  return wall_clock_time(point->tm.tm_year + 1900, point->tm.tm_mon,
+                         point->tm.tm_mday + days, seconds);
+}
 
-  // The candidate time is currently valid. Find when it becomes invalid.
-  struct tm *tm_candidate = localtime(&candidate);
-  if (!tm_candidate) {
-    return -1; // Invalid time
+// Distance to the midnight starting the day `days` after the candidate's
+static time_t until_day_start(const EvalPoint *point, const int days) {
+  if (days == 1) {
+    return point->day_end - point->time;
   }
-  struct tm tm_cand = *tm_candidate;
+  return local_date_start(point->tm.tm_year + 1900, point->tm.tm_mon,
+                          point->tm.tm_mday + days) -
+         point->time;
+}
 
-  switch (filter->type) {
-  case FILTER_DAY_OF_WEEK:
-  case FILTER_HOLIDAY:
-    // Valid today, becomes invalid at midnight.
-    return until_midnight(&tm_cand);
+// Day of the month of the week'th (-1: last) given weekday, or 0 if the
+// month has no such day
+static int nth_weekday_day(const int week, const int day_of_week,
+                           const int first_wday, const int month_length) {
+  const int first = 1 + (day_of_week - first_wday + 7) % 7;
+  if (week < 0) {
+    return first + (month_length - first) / 7 * 7;
+  }
+  const int day = first + (week - 1) * 7;
+  return day <= month_length ? day : 0;
+}
 
-  case FILTER_AFTER_DATETIME:
-    return -1; // Valid now, will be valid forever.
+// Months: valid until the first month after the current run of set ones,
+// otherwise until the start of the next set one
+static FilterValue month_value(const unsigned mask, const EvalPoint *point) {
+  FilterValue value = {0, -1};
+  if (!(mask & 0xFFF)) {
+    value.until_valid = -1;
+    return value;
+  }
+  const int year = point->tm.tm_year + 1900;
+  const int mon = point->tm.tm_mon;
+  int ahead = 0;
+  while (!(mask & (1u << ((mon + ahead) % 12)))) {
+    ahead++;
+  }
+  if (ahead > 0) {
+    value.until_valid = local_date_start(year, mon + ahead, 1) - point->time;
+    return value;
+  }
+  int run = 0;
+  while (run < 12 && (mask & (1u << ((mon + run) % 12)))) {
+    run++;
+  }
+  if (run < 12) {
+    value.until_invalid =
+        local_date_start(year, mon + run, 1) - point->time;
+  }
+  return value;
+}
 
-  case FILTER_BEFORE_DATETIME:
-    // Valid now, becomes invalid at the filter's time.
-    return difftime(filter->data.time_value, candidate);
+// Days of the month: the next day whose state differs is found with one
+// mask per month, a few months ahead at most
+static FilterValue month_days_value(const unsigned mask,
+                                    const EvalPoint *point) {
+  FilterValue value = {0, -1};
+  const unsigned long long days = mask & ~1u; // bit 0 is unused
+  if (!days) {
+    value.until_valid = -1;
+    return value;
+  }
+  int year = point->tm.tm_year + 1900;
+  int mon = point->tm.tm_mon;
+  const bool valid = (days >> point->tm.tm_mday) & 1;
+  const unsigned long long wanted = valid ? ~days : days;
+  int from = point->tm.tm_mday + 1;
+  for (int months = 0; months < 13; months++) {
+    const unsigned length = days_in_month((unsigned)mon + 1, (unsigned)year);
+    const unsigned long long in_month = ((2ull << length) - 2) &
+                                        ~((1ull << from) - 1);
+    if (wanted & in_month) {
+      int day = from;
+      while (!((wanted & in_month) >> day & 1)) {
+        day++;
+      }
+      const time_t until = local_date_start(year, mon, day) - point->time;
+      if (valid) {
+        value.until_invalid = until;
+      } else {
+        value.until_valid = until;
+      }
+      return value;
+    }
+    from = 1;
+    if (++mon == 12) {
+      mon = 0;
+      year++;
+    }
+  }
+  if (!valid) {
+    value.until_valid = -1;
+  }
+  return value;
+}
 
-  case FILTER_AFTER_TIME: {
-    // Valid now. Becomes invalid at the filter time tomorrow.
-    time_t limit_today = get_time_on_date(&tm_cand, filter->data.time_value);
-    struct tm tm_tomorrow = *localtime(&limit_today);
-    tm_tomorrow.tm_mday += 1;
-    tm_tomorrow.tm_isdst = -1;
-    time_t limit_tomorrow = mktime(&tm_tomorrow);
-    return difftime(limit_tomorrow, candidate);
+// The nth weekday is valid for one day; the next one is at most a few
+// months away (a fifth weekday does not occur every month)
+static FilterValue nth_weekday_value(const int week, const int day_of_week,
+                                     const EvalPoint *point) {
+  FilterValue value = {-1, 0};
+  if (week == 0 || week < -1 || week > 5 || day_of_week < 0 ||
+      day_of_week > 6) {
+    return value;
+  }
+  int year = point->tm.tm_year + 1900;
+  int mon = point->tm.tm_mon;
+  int day = point->tm.tm_mday;
+  int first_wday = ((point->tm.tm_wday - (day - 1)) % 7 + 7) % 7;
+  int length = (int)days_in_month((unsigned)mon + 1, (unsigned)year);
+  int target = nth_weekday_day(week, day_of_week, first_wday, length);
+  if (target == day) {
+    value.until_valid = 0;
+    value.until_invalid = point->day_end - point->time;
+    return value;
+  }
+  for (int months = 0; months < 15; months++) {
+    if (target > day) {
+      value.until_valid = local_date_start(year, mon, target) - point->time;
+      return value;
+    }
+    first_wday = (first_wday + length) % 7;
+    if (++mon == 12) {
+      mon = 0;
+      year++;
+    }
+    length = (int)days_in_month((unsigned)mon + 1, (unsigned)year);
+    day = 0;
+    target = nth_weekday_day(week, day_of_week, first_wday, length);
   }
+  return value;
+}
 
-  case FILTER_BEFORE_TIME: {
-    // Valid now. Becomes invalid at the filter time today.
-    time_t limit_today = get_time_on_date(&tm_cand, filter->data.time_value);
-    return difftime(limit_today, candidate);
+#define WEEK_WORDS ((WEEK_MINUTES + 63) / 64)
+
+// Index of the lowest set bit of a nonzero word
+static int lowest_bit(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int bit = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    bit++;
   }
+  return bit;
+#endif
+}
 
-  case FILTER_MIN_DISTANCE:
-    // This filter is about finding valid slots, not continuous validity.
-    // We treat it as always valid from an "invalid" perspective.
-    return -1;
+// Minutes from bit `from` (excluded) to the next bit equal to `set`,
+// wrapping around the week, or -1 if every other bit differs
+static long next_week_bit(const uint64_t *bits, const size_t from,
+                          const bool set) {
+  size_t at = from + 1;
+  for (size_t scanned = 0; scanned < WEEK_WORDS + 1; scanned++) {
+    if (at >= WEEK_MINUTES) {
+      at = 0;
+    }
+    const size_t word = at / 64;
+    uint64_t candidates = set ? bits[word] : ~bits[word];
+    candidates &= ~(uint64_t)0 << (at % 64);
+    if (word == WEEK_WORDS - 1 && WEEK_MINUTES % 64) {
+      candidates &= ((uint64_t)1 << (WEEK_MINUTES % 64)) - 1;
+    }
+    if (candidates) {
+      // `from` itself never matches
+      const size_t found = word * 64 + (size_t)lowest_bit(candidates);
+      return found > from ? (long)(found - from)
+                          : (long)(found + WEEK_MINUTES - from);
+    }
+    at = (word + 1) * 64;
+  }
+  return -1;
+}
 
-  case FILTER_AND: {
-    time_t left_dist =
-        until_invalid(filter->data.logical.left, candidate, duration, calendar);
-    time_t right_dist = until_invalid(filter->data.logical.right, candidate,
-                                      duration, calendar);
-    if (left_dist < 0)
-      return right_dist;
-    if (right_dist < 0)
-      return left_dist;
-    return left_dist < right_dist ? left_dist : right_dist;
+// Index of the highest set bit of a nonzero word
+static int highest_bit(uint64_t word) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(word);
+#else
+  int bit = 63;
+  while (!(word >> bit)) {
+    bit--;
   }
+  return bit;
+#endif
+}
 
-  case FILTER_OR: {
-    time_t left_dist =
-        until_invalid(filter->data.logical.left, candidate, duration, calendar);
-    time_t right_dist = until_invalid(filter->data.logical.right, candidate,
-                                      duration, calendar);
-    if (left_dist < 0 || right_dist < 0)
-      return -1;
-    return left_dist > right_dist ? left_dist : right_dist;
+// Minutes back from bit `from` (excluded) to the previous bit equal to
+// `set`, wrapping around the week, or -1 if every other bit differs
+static long prev_week_bit(const uint64_t *bits, const size_t from,
+                          const bool set) {
+  size_t at = from == 0 ? WEEK_MINUTES - 1 : from - 1;
+  for (size_t scanned = 0; scanned < WEEK_WORDS + 1; scanned++) {
+    const size_t word = at / 64;
+    uint64_t candidates = set ? bits[word] : ~bits[word];
+    candidates &= ~(uint64_t)0 >> (63 - at % 64);
+    if (candidates) {
+      // `from` itself never matches
+      const size_t found = word * 64 + (size_t)highest_bit(candidates);
+      return found < from ? (long)(from - found)
+                          : (long)(from + WEEK_MINUTES - found);
+    }
+    at = word == 0 ? WEEK_MINUTES - 1 : word * 64 - 1;
   }
+  return -1;
+}
 
-  case FILTER_NOT:
-    return until_valid(filter->data.operand, candidate, duration, calendar);
+// Valid while the candidate's minute of the week is set. The minute found
+// is placed by the wall clock, so a skip over a daylight saving change
+// lands on it exactly.
+static FilterValue week_mask_value(const uint64_t *bits,
+                                   const EvalPoint *point) {
+  FilterValue value = {0, 0};
+  const long minute_of_day = (long)(point->seconds / 60);
+  const size_t minute = (size_t)point->tm.tm_wday * 1440 + minute_of_day;
+  const bool valid = bits[minute / 64] >> (minute % 64) & 1;
+  const long ahead = next_week_bit(bits, minute, !valid);
+  time_t until = -1;
+  if (ahead >= 0) {
+    const long target = minute_of_day + ahead;
+    until = wall_time(point, (int)(target / 1440), target % 1440 * 60) -
+            point->time;
+  }
+  if (valid) {
+    value.until_invalid = until;
+  } else {
+    value.until_valid = until;
+  }
+  return value;
+}
 
+static FilterValue eval_leaf(const FilterInstr *instr, const EvalPoint *point,
+                             const time_t duration, const Calendar *calendar) {
+  const time_t t = point->time;
+  const time_t until_midnight = point->day_end - t;
+  FilterValue value = {0, -1};
+  switch (instr->type) {
+  case FILTER_DAY_OF_WEEK: {
+    int days_ahead = (instr->arg.day_of_week - point->tm.tm_wday + 7) % 7;
+    if (days_ahead == 0) {
+      value.until_invalid = until_midnight;
+    } else {
+      value.until_valid = until_day_start(point, days_ahead);
+    }
+    break;
+  }
+  case FILTER_HOLIDAY: {
+    long days = days_until_holiday(calendar, &point->tm);
+    if (days < 0) {
+      value.until_valid = -1;
+    } else if (days > 0) {
+      value.until_valid = until_day_start(point, (int)days);
+    } else {
+      value.until_invalid = until_midnight;
+    }
+    break;
+  }
+  case FILTER_AFTER_DATETIME:
+    if (t <= instr->arg.time_value) {
+      value.until_valid = instr->arg.time_value - t + 1;
+    }
+    break;
+  case FILTER_BEFORE_DATETIME:
+    if (t < instr->arg.time_value) {
+      value.until_invalid = instr->arg.time_value - t;
+    } else {
+      value.until_valid = -1;
+    }
+    break;
+  case FILTER_AFTER_TIME: {
+    time_t limit_today = wall_time(point, 0, instr->arg.seconds);
+    if (t < limit_today) {
+      value.until_valid = limit_today - t + 1;
+    } else {
+      value.until_invalid = until_midnight;
+    }
+    break;
+  }
+  case FILTER_BEFORE_TIME: {
+    time_t limit_today = wall_time(point, 0, instr->arg.seconds);
+    if (t < limit_today) {
+      value.until_invalid = limit_today - t;
+    } else {
+      value.until_valid = until_midnight;
+    }
+    break;
+  }
+  case FILTER_MIN_DISTANCE:
+    value.until_valid =
+        time_til_distance(t, duration, instr->arg.minutes, calendar);
+    break;
+  case FILTER_DAY_MASK: {
+    const unsigned mask = instr->arg.day_mask & 0x7F;
+    if (!mask) {
+      value.until_valid = -1;
+      break;
+    }
+    // Days until the first set day, then how many set days follow it
+    int ahead = 0;
+    while (!(mask & (1u << ((point->tm.tm_wday + ahead) % 7)))) {
+      ahead++;
+    }
+    if (ahead > 0) {
+      value.until_valid = until_day_start(point, ahead);
+      break;
+    }
+    int run = 0;
+    while (run < 7 && (mask & (1u << ((point->tm.tm_wday + run) % 7)))) {
+      run++;
+    }
+    value.until_invalid = run == 7 ? -1 : until_day_start(point, run);
+    break;
+  }
+  case FILTER_TIME_WINDOW: {
+    const time_t start = instr->arg.window.start;
+    const time_t end = instr->arg.window.end;
+    const time_t opens = wall_time(point, 0, start);
+    const time_t closes = wall_time(point, 0, end);
+    if (start >= end) {
+      value.until_valid = -1;
+    } else if (t < opens) {
+      value.until_valid = opens - t;
+    } else if (t < closes) {
+      value.until_invalid = closes - t;
+    } else {
+      value.until_valid = wall_time(point, 1, start) - t;
+    }
+    break;
+  }
+  case FILTER_MONTH_MASK:
+    value = month_value(instr->arg.month_mask, point);
+    break;
+  case FILTER_MONTH_DAYS:
+    value = month_days_value(instr->arg.month_days, point);
+    break;
+  case FILTER_NTH_WEEKDAY:
+    value = nth_weekday_value(instr->arg.nth.week,
+                              instr->arg.nth.day_of_week, point);
+    break;
+  case FILTER_WEEK_MASK:
+    value = week_mask_value(instr->arg.week_bits, point);
+    break;
+  case FILTER_DATE_RANGE:
+    if (instr->arg.window.start >= instr->arg.window.end ||
+        t >= instr->arg.window.end) {
+      value.until_valid = -1;
+    } else if (t < instr->arg.window.start) {
+      value.until_valid = instr->arg.window.start - t;
+    } else {
+      value.until_invalid = instr->arg.window.end - t;
+    }
+    break;
   default:
-    return -1; // Should not happen.
+    break;
+  }
+  if (value.until_valid != 0) {
+    value.until_invalid = 0;
   }
+  return value;
 }
 
-time_t until_valid(const Filter *filter, const time_t candidate,
-                   const time_t duration, const Calendar *calendar) {
-  if (!filter || filter->type == FILTER_NONE) {
-    return 0;
+// backward evaluation
+//
+// The same FilterValue, measured into the past: until_valid is how far back
+// the latest valid second is (0 if valid now) and until_invalid how far back
+// the latest invalid one is, -1 still meaning never. AND, OR and NOT combine
+// these exactly as they combine the forward distances.
+
+// Months: invalid since the last month before the current run of set ones,
+// otherwise valid since the end of the last set one
+static FilterValue month_value_back(const unsigned mask,
+                                    const EvalPoint *point) {
+  FilterValue value = {0, -1};
+  if (!(mask & 0xFFF)) {
+    value.until_valid = -1;
+    return value;
+  }
+  const int year = point->tm.tm_year + 1900;
+  const int mon = point->tm.tm_mon;
+  const bool valid = (mask >> mon) & 1;
+  int back = 1;
+  while (back <= 12 &&
+         ((mask >> ((mon - back + 12) % 12)) & 1) == (unsigned)valid) {
+    back++;
   }
+  if (back > 12) {
+    return value; // Every month is set
+  }
+  // The month found ends where the one after it starts
+  const time_t since =
+      point->time - local_date_start(year, mon - back + 1, 1) + 1;
+  if (valid) {
+    value.until_invalid = since;
+  } else {
+    value.until_valid = since;
+  }
+  return value;
+}
 
-  struct tm *cand_tm = localtime(&candidate);
-  if (!cand_tm) {
-    return -1; // Invalid time
+// Days of the month: the last day whose state differs, one mask per month
+static FilterValue month_days_value_back(const unsigned mask,
+                                         const EvalPoint *point) {
+  FilterValue value = {0, -1};
+  const unsigned long long days = mask & ~1u; // bit 0 is unused
+  if (!days) {
+    value.until_valid = -1;
+    return value;
   }
-  struct tm tm_candidate = *cand_tm;
+  int year = point->tm.tm_year + 1900;
+  int mon = point->tm.tm_mon;
+  const bool valid = (days >> point->tm.tm_mday) & 1;
+  const unsigned long long wanted = valid ? ~days : days;
+  unsigned to = (unsigned)point->tm.tm_mday - 1;
+  for (int months = 0; months < 13; months++) {
+    const unsigned length = days_in_month((unsigned)mon + 1, (unsigned)year);
+    if (to > length) {
+      to = length;
+    }
+    const unsigned long long in_month = (2ull << to) - 2;
+    if (wanted & in_month) {
+      unsigned day = to;
+      while (!((wanted & in_month) >> day & 1)) {
+        day--;
+      }
+      const time_t since =
+          point->time - local_date_start(year, mon, (int)day + 1) + 1;
+      if (valid) {
+        value.until_invalid = since;
+      } else {
+        value.until_valid = since;
+      }
+      return value;
+    }
+    to = 31;
+    if (--mon < 0) {
+      mon = 11;
+      year--;
+    }
+  }
+  if (!valid) {
+    value.until_valid = -1;
+  }
+  return value;
+}
 
-  switch (filter->type) {
-  case FILTER_DAY_OF_WEEK:
-    if (tm_candidate.tm_wday == filter->data.day_of_week)
-      return 0;
-    return until_day_of_week(candidate, filter->data.day_of_week);
+// The nth weekday of this month if it has passed, or of an earlier one
+static FilterValue nth_weekday_value_back(const int week,
+                                          const int day_of_week,
+                                          const EvalPoint *point) {
+  FilterValue value = {-1, 0};
+  if (week == 0 || week < -1 || week > 5 || day_of_week < 0 ||
+      day_of_week > 6) {
+    return value;
+  }
+  int year = point->tm.tm_year + 1900;
+  int mon = point->tm.tm_mon;
+  int day = point->tm.tm_mday;
+  int first_wday = ((point->tm.tm_wday - (day - 1)) % 7 + 7) % 7;
+  int length = (int)days_in_month((unsigned)mon + 1, (unsigned)year);
+  int target = nth_weekday_day(week, day_of_week, first_wday, length);
+  if (target == day) {
+    value.until_valid = 0;
+    value.until_invalid = point->time - point->day_start + 1;
+    return value;
+  }
+  for (int months = 0; months < 15; months++) {
+    if (target != 0 && target < day) {
+      value.until_valid =
+          point->time - local_date_start(year, mon, target + 1) + 1;
+      return value;
+    }
+    if (--mon < 0) {
+      mon = 11;
+      year--;
+    }
+    length = (int)days_in_month((unsigned)mon + 1, (unsigned)year);
+    first_wday = ((first_wday - length) % 7 + 7) % 7;
+    day = 32;
+    target = nth_weekday_day(week, day_of_week, first_wday, length);
+  }
+  return value;
+}
 
-  case FILTER_HOLIDAY:
-    return until_holiday(&tm_candidate);
+// Distance back to the last second of the day `days` before the
+// candidate's, placed from local midnight so it holds over clock changes
+static time_t since_day_end(const EvalPoint *point, const int days) {
+  return point->time -
+         local_date_start(point->tm.tm_year + 1900, point->tm.tm_mon,
+                          point->tm.tm_mday - days + 1) +
+         1;
+}
 
-  case FILTER_AFTER_DATETIME:
-    if (candidate > filter->data.time_value)
-      return 0;
-    return difftime(filter->data.time_value, candidate) + 1;
+// Both distances back to the latest second of the minute found
+static FilterValue week_mask_value_back(const uint64_t *bits,
+                                        const EvalPoint *point) {
+  FilterValue value = {0, 0};
+  const long minute_of_day = (long)(point->seconds / 60);
+  const size_t minute = (size_t)point->tm.tm_wday * 1440 + minute_of_day;
+  const bool valid = bits[minute / 64] >> (minute % 64) & 1;
+  const long back = prev_week_bit(bits, minute, !valid);
+  time_t since = -1;
+  if (back >= 0) {
+    // The minute found ends where the one after it starts
+    const long after = minute_of_day - back + 1;
+    const long days = after >= 0 ? after / 1440 : -((1439 - after) / 1440);
+    since = point->time -
+            wall_time(point, (int)days, (after - days * 1440) * 60) + 1;
+  }
+  if (valid) {
+    value.until_invalid = since;
+  } else {
+    value.until_valid = since;
+  }
+  return value;
+}
 
+// eval_leaf looking back from the candidate
+static FilterValue eval_leaf_back(const FilterInstr *instr,
+                                  const EvalPoint *point,
+                                  const time_t duration,
+                                  const Calendar *calendar) {
+  const time_t t = point->time;
+  FilterValue value = {0, -1};
+  switch (instr->type) {
+  case FILTER_DAY_OF_WEEK: {
+    int days_back = (point->tm.tm_wday - instr->arg.day_of_week + 7) % 7;
+    if (days_back == 0) {
+      value.until_invalid = since_day_end(point, 1);
+    } else {
+      value.until_valid = since_day_end(point, days_back);
+    }
+    break;
+  }
+  case FILTER_HOLIDAY: {
+    long days = days_since_holiday(calendar, &point->tm);
+    if (days < 0) {
+      value.until_valid = -1;
+    } else if (days > 0) {
+      value.until_valid = since_day_end(point, (int)days);
+    } else {
+      value.until_invalid = since_day_end(point, 1);
+    }
+    break;
+  }
+  case FILTER_AFTER_DATETIME:
+    if (t <= instr->arg.time_value) {
+      value.until_valid = -1;
+    } else {
+      value.until_invalid = t - instr->arg.time_value;
+    }
+    break;
   case FILTER_BEFORE_DATETIME:
-    return (candidate < filter->data.time_value) ? 0 : -1;
-
+    if (t >= instr->arg.time_value) {
+      value.until_valid = t - instr->arg.time_value + 1;
+    }
+    break;
   case FILTER_AFTER_TIME: {
-    time_t limit_today =
-        get_time_on_date(&tm_candidate, filter->data.time_value);
-    if (candidate >= limit_today)
-      return 0;
-    return difftime(limit_today, candidate) + 1;
+    time_t limit_today = wall_time(point, 0, instr->arg.seconds);
+    if (t < limit_today) {
+      value.until_valid = since_day_end(point, 1);
+    } else {
+      value.until_invalid = t - limit_today + 1;
+    }
+    break;
   }
-
   case FILTER_BEFORE_TIME: {
-    time_t limit_today =
-        get_time_on_date(&tm_candidate, filter->data.time_value);
-    if (candidate < limit_today)
-      return 0;
-    // Past the time today. Next valid time is start of next day.
-    return until_midnight(&tm_candidate);
+    time_t limit_today = wall_time(point, 0, instr->arg.seconds);
+    if (t < limit_today) {
+      value.until_invalid = since_day_end(point, 1);
+    } else {
+      value.until_valid = t - limit_today + 1;
+    }
+    break;
   }
-
   case FILTER_MIN_DISTANCE:
-    return time_til_distance(candidate, duration, filter->data.minutes,
-                             calendar);
-
-  case FILTER_AND: {
-    time_t left_dist =
-        until_valid(filter->data.logical.left, candidate, duration, calendar);
-    time_t right_dist =
-        until_valid(filter->data.logical.right, candidate, duration, calendar);
-    if (left_dist < 0 || right_dist < 0)
-      return -1;
-    return left_dist > right_dist ? left_dist : right_dist;
+    value.until_valid =
+        time_since_distance(t, duration, instr->arg.minutes, calendar);
+    break;
+  case FILTER_DAY_MASK: {
+    const unsigned mask = instr->arg.day_mask & 0x7F;
+    if (!mask) {
+      value.until_valid = -1;
+      break;
+    }
+    // Days back to the last set day, then how many set days precede it
+    int back = 0;
+    while (!(mask & (1u << ((point->tm.tm_wday - back + 7) % 7)))) {
+      back++;
+    }
+    if (back > 0) {
+      value.until_valid = since_day_end(point, back);
+      break;
+    }
+    int run = 0;
+    while (run < 7 && (mask & (1u << ((point->tm.tm_wday - run + 7) % 7)))) {
+      run++;
+    }
+    value.until_invalid = run == 7 ? -1 : since_day_end(point, run);
+    break;
+  }
+  case FILTER_TIME_WINDOW: {
+    const time_t start = instr->arg.window.start;
+    const time_t end = instr->arg.window.end;
+    const time_t opens = wall_time(point, 0, start);
+    const time_t closes = wall_time(point, 0, end);
+    // Each distance reaches the second before a bound
+    if (start >= end) {
+      value.until_valid = -1;
+    } else if (t < opens) {
+      value.until_valid = t - wall_time(point, -1, end) + 1;
+    } else if (t < closes) {
+      value.until_invalid = t - opens + 1;
+    } else {
+      value.until_valid = t - closes + 1;
+    }
+    break;
+  }
+  case FILTER_MONTH_MASK:
+    value = month_value_back(instr->arg.month_mask, point);
+    break;
+  case FILTER_MONTH_DAYS:
+    value = month_days_value_back(instr->arg.month_days, point);
+    break;
+  case FILTER_NTH_WEEKDAY:
+    value = nth_weekday_value_back(instr->arg.nth.week,
+                                   instr->arg.nth.day_of_week, point);
+    break;
+  case FILTER_WEEK_MASK:
+    value = week_mask_value_back(instr->arg.week_bits, point);
+    break;
+  case FILTER_DATE_RANGE:
+    if (instr->arg.window.start >= instr->arg.window.end ||
+        t < instr->arg.window.start) {
+      value.until_valid = -1;
+    } else if (t >= instr->arg.window.end) {
+      value.until_valid = t - instr->arg.window.end + 1;
+    } else {
+      value.until_invalid = t - instr->arg.window.start + 1;
+    }
+    break;
+  default:
+    break;
   }
+  if (value.until_valid != 0) {
+    value.until_invalid = 0;
+  }
+  return value;
+}
 
-  case FILTER_OR: {
-    time_t left_dist =
-        until_valid(filter->data.logical.left, candidate, duration, calendar);
-    time_t right_dist =
-        until_valid(filter->data.logical.right, candidate, duration, calendar);
-    if (left_dist < 0 && right_dist < 0)
-      return -1;
-    if (left_dist < 0)
-      return right_dist;
-    if (right_dist < 0)
-      return left_dist;
-    return left_dist < right_dist ? left_dist : right_dist;
+static FilterValue and_values(const FilterValue left, const FilterValue right) {
+  FilterValue value = {0, 0};
+  if (left.until_valid < 0 || right.until_valid < 0) {
+    value.until_valid = -1;
+  } else {
+    value.until_valid = left.until_valid > right.until_valid
+                            ? left.until_valid
+                            : right.until_valid;
+  }
+  if (value.until_valid == 0) {
+    // Both sides valid: invalid as soon as either one is
+    if (left.until_invalid < 0) {
+      value.until_invalid = right.until_invalid;
+    } else if (right.until_invalid < 0) {
+      value.until_invalid = left.until_invalid;
+    } else {
+      value.until_invalid = left.until_invalid < right.until_invalid
+                                ? left.until_invalid
+                                : right.until_invalid;
+    }
   }
+  return value;
+}
 
-  case FILTER_NOT: {
-    // NOT is valid when the operand is invalid now.
-    time_t op_valid =
-        until_valid(filter->data.operand, candidate, duration, calendar);
-    if (op_valid != 0) {
-      return 0; // operand invalid now -> NOT valid now
+static FilterValue or_values(const FilterValue left, const FilterValue right) {
+  FilterValue value = {0, 0};
+  if (left.until_valid < 0) {
+    value.until_valid = right.until_valid;
+  } else if (right.until_valid < 0) {
+    value.until_valid = left.until_valid;
+  } else {
+    value.until_valid = left.until_valid < right.until_valid
+                            ? left.until_valid
+                            : right.until_valid;
+  }
+  if (value.until_valid == 0) {
+    if (left.until_invalid < 0 || right.until_invalid < 0) {
+      value.until_invalid = -1;
+    } else {
+      value.until_invalid = left.until_invalid > right.until_invalid
+                                ? left.until_invalid
+                                : right.until_invalid;
+    }
+  }
+  return value;
+}
+
+// NOT is valid while its operand is invalid and vice versa
+static FilterValue not_value(const FilterValue operand) {
+  FilterValue value;
+  value.until_valid = operand.until_valid != 0 ? 0 : operand.until_invalid;
+  value.until_invalid = operand.until_valid;
+  return value;
+}
+
+// Returns true if the left operand's value is already a usable result for
+// the whole AND or OR. An invalid AND operand gives an underestimate of the
+// time until valid (exact if it is never valid); an OR operand that stays
+// valid forever is exact. Either way no value ever has to be revisited.
+static bool decides(const FilterType type, const FilterValue left) {
+  if (type == FILTER_AND) {
+    return left.until_valid != 0;
+  }
+  return left.until_valid == 0 && left.until_invalid < 0;
+}
+
+// Evaluates a subtree in a single pass: every node yields both distances
+// at once, so each node is visited at most once per candidate. The right
+// operand of an AND or OR is skipped when the left one decides the result.
+// Looks forward, or back from the candidate when `backward` is set. Adds
+// the number of nodes visited to *evaluated.
+static FilterValue eval_node(const Filter *filter, const EvalPoint *point,
+                             const time_t duration, const Calendar *calendar,
+                             const bool backward, unsigned long *evaluated) {
+  FilterValue value = {0, -1};
+  (*evaluated)++;
+  if (!filter) {
+    return value;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR: {
+    FilterValue left = eval_node(filter->data.logical.left, point, duration,
+                                 calendar, backward, evaluated);
+    if (decides(filter->type, left)) {
+      return left;
     }
-    // Operand is valid now; NOT becomes valid when operand becomes invalid.
-    return until_invalid(filter->data.operand, candidate, duration, calendar);
+    FilterValue right = eval_node(filter->data.logical.right, point,
+                                  duration, calendar, backward, evaluated);
+    return filter->type == FILTER_AND ? and_values(left, right)
+                                      : or_values(left, right);
   }
+  case FILTER_NOT:
+    return not_value(eval_node(filter->data.operand, point, duration,
+                               calendar, backward, evaluated));
+  default: {
+    FilterInstr leaf;
+    lower_node(filter, &leaf);
+    return backward ? eval_leaf_back(&leaf, point, duration, calendar)
+                    : eval_leaf(&leaf, point, duration, calendar);
+  }
+  }
+}
 
-  default:
-    return 0; // Should not happen, assume valid.
+time_t until_valid(const Filter *filter, const time_t candidate,
+                   const time_t duration, const Calendar *calendar) {
+  if (!filter || filter->type == FILTER_NONE) {
+    return 0;
+  }
+  EvalPoint point;
+  if (!make_eval_point(&point, candidate)) {
+    return -1; // Invalid time
   }
+  unsigned long evaluated = 0;
+  return eval_node(filter, &point, duration, calendar, false, &evaluated)
+      .until_valid;
 }
 
 bool evaluate_filter(const Filter *filter, const time_t candidate,
@@ -322,20 +980,94 @@ bool evaluate_filter(const Filter *filter, const time_t candidate,
   return until_valid(filter, candidate, duration, calendar) == 0;
 }
 
-Filter *make_filter(FilterType type) {
-  Filter *f = malloc(sizeof(Filter));
+#define DEFAULT_ARENA_BLOCK 64
+
+static FilterBlock *create_filter_block(const size_t capacity) {
+  FilterBlock *block =
+      malloc(sizeof(FilterBlock) + capacity * sizeof(Filter));
+  if (!block)
+    return NULL;
+  block->next = NULL;
+  block->used = 0;
+  block->capacity = capacity;
+  return block;
+}
+
+FilterArena *create_filter_arena(size_t block_size) {
+  FilterArena *arena = malloc(sizeof(FilterArena));
+  if (!arena)
+    return NULL;
+  arena->block_size = block_size ? block_size : DEFAULT_ARENA_BLOCK;
+  arena->blocks = create_filter_block(arena->block_size);
+  if (!arena->blocks) {
+    free(arena);
+    return NULL;
+  }
+  return arena;
+}
+
+void reset_filter_arena(FilterArena *arena) {
+  if (!arena)
+    return;
+  FilterBlock *block = arena->blocks->next;
+  while (block) {
+    FilterBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks->next = NULL;
+  arena->blocks->used = 0;
+}
+
+void free_filter_arena(FilterArena *arena) {
+  if (!arena)
+    return;
+  reset_filter_arena(arena);
+  free(arena->blocks);
+  free(arena);
+}
+
+Filter *make_filter_in(FilterArena *arena, FilterType type) {
+  Filter *f;
+  if (!arena) {
+    f = malloc(sizeof(Filter));
+  } else {
+    if (arena->blocks->used == arena->blocks->capacity) {
+      FilterBlock *block = create_filter_block(arena->block_size);
+      if (!block)
+        return NULL;
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+    f = &arena->blocks->nodes[arena->blocks->used++];
+  }
   if (!f)
     return NULL;
   f->type = type;
+  f->arena = arena;
   return f;
 }
 
+Filter *make_filter(FilterType type) { return make_filter_in(NULL, type); }
+
+// Arena new nodes built from these operands belong to
+static FilterArena *arena_of(const Filter *a, const Filter *b) {
+  if (a && a->arena)
+    return a->arena;
+  return b ? b->arena : NULL;
+}
+
+// Frees a single node unless an arena owns it
+static void release_node(Filter *filter) {
+  if (filter && !filter->arena)
+    free(filter);
+}
+
 // unsafe: assume type is logical
 static Filter *combine(Filter *left, Filter *right, FilterType type) {
-  Filter *f = malloc(sizeof(Filter));
+  Filter *f = make_filter_in(arena_of(left, right), type);
   if (!f)
     return NULL;
-  f->type = type;
   f->data.logical.left = left;
   f->data.logical.right = right;
   return f;
@@ -350,39 +1082,1048 @@ Filter *and_filter(Filter *left, Filter *right) {
 }
 
 Filter *not_filter(Filter *operand) {
-  Filter *f = make_filter(FILTER_NOT);
+  Filter *f = make_filter_in(arena_of(operand, NULL), FILTER_NOT);
+  if (!f)
+    return NULL;
   f->data.operand = operand;
   return f;
 }
 
-time_t find_optimal_time(const Calendar *calendar, const Filter *filter,
-                         const time_t start_time, const time_t duration) {
-
+// Returns the number of nodes in a filter tree
+static size_t count_filter_nodes(const Filter *filter) {
   if (!filter) {
-    return start_time; // No filter means now is valid
+    return 1; // Compiled as FILTER_NONE
   }
-  int max_iterations = 365 * 24 * 60 / 15;
-  int iterations = 0;
-  time_t candidate = start_time;
-  while (iterations < max_iterations) {
-    iterations++;
-    time_t skip_seconds = until_valid(filter, candidate, duration, calendar);
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return 1 + count_filter_nodes(filter->data.logical.left) +
+           count_filter_nodes(filter->data.logical.right);
+  case FILTER_NOT:
+    return 1 + count_filter_nodes(filter->data.operand);
+  default:
+    return 1;
+  }
+}
 
-    if (skip_seconds < 0) {
-      return -1; // No valid time found within filter constraints
-    }
+// optimisation
 
-    if (skip_seconds > 0) {
+#define ALL_DAYS 0x7F
+#define ALL_MONTHS 0xFFF
+
+static Filter *make_day_mask(FilterArena *arena, unsigned mask) {
+  Filter *f = make_filter_in(arena, FILTER_DAY_MASK);
+  if (f) {
+    f->data.day_mask = (unsigned char)(mask & ALL_DAYS);
+  }
+  return f;
+}
+
+static Filter *make_month_mask(FilterArena *arena, unsigned mask) {
+  Filter *f = make_filter_in(arena, FILTER_MONTH_MASK);
+  if (f) {
+    f->data.month_mask = (unsigned short)(mask & ALL_MONTHS);
+  }
+  return f;
+}
+
+static void destroy_filters(Filter **terms, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    destroy_filter(terms[i]);
+  }
+}
+
+// Rough relative cost of evaluating a subtree once
+static unsigned long filter_cost(const Filter *filter) {
+  if (!filter) {
+    return 1;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return 1 + filter_cost(filter->data.logical.left) +
+           filter_cost(filter->data.logical.right);
+  case FILTER_NOT:
+    return 1 + filter_cost(filter->data.operand);
+  case FILTER_HOLIDAY:
+    return 4; // Holiday table lookup
+  case FILTER_MONTH_MASK:
+  case FILTER_MONTH_DAYS:
+  case FILTER_NTH_WEEKDAY:
+    return 2; // Date conversion for the next period
+  case FILTER_MIN_DISTANCE:
+    return 32; // Walks the events around the candidate
+  default:
+    return 1;
+  }
+}
+
+// Stable sort of terms, cheapest first. AND and OR are commutative, so
+// this only changes which operands short-circuiting can skip.
+static void order_by_cost(Filter **terms, const size_t count) {
+  unsigned long *costs = malloc(count * sizeof(unsigned long));
+  if (!costs) {
+    return; // Still correct, just unordered
+  }
+  for (size_t i = 0; i < count; i++) {
+    costs[i] = filter_cost(terms[i]);
+  }
+  for (size_t i = 1; i < count; i++) {
+    Filter *term = terms[i];
+    unsigned long cost = costs[i];
+    size_t j = i;
+    for (; j > 0 && costs[j - 1] > cost; j--) {
+      terms[j] = terms[j - 1];
+      costs[j] = costs[j - 1];
+    }
+    terms[j] = term;
+    costs[j] = cost;
+  }
+  free(costs);
+}
+
+// Chains terms with the given combinator, left to right
+static Filter *chain_filters(FilterArena *arena, Filter **terms, size_t count,
+                             FilterType type) {
+  if (count == 0) {
+    return make_filter_in(arena, FILTER_NONE);
+  }
+  Filter *acc = terms[0];
+  for (size_t i = 1; i < count; i++) {
+    acc = combine(acc, terms[i], type);
+  }
+  return acc;
+}
+
+// Optimises the operands of a chain of `type` nodes and appends them to
+// terms, freeing the chain's own nodes
+static void flatten_filter(Filter *filter, FilterType type, Filter **terms,
+                           size_t *count) {
+  if (filter && filter->type == type) {
+    flatten_filter(filter->data.logical.left, type, terms, count);
+    flatten_filter(filter->data.logical.right, type, terms, count);
+    release_node(filter);
+    return;
+  }
+  Filter *term = optimize_filter(filter);
+  if (term && term->type == type) {
+    // e.g. a double negation uncovered a nested chain of the same kind
+    flatten_filter(term, type, terms, count);
+    return;
+  }
+  terms[(*count)++] = term;
+}
+
+static Filter *merge_conjunction(FilterArena *arena, Filter **terms,
+                                 size_t count) {
+  unsigned mask = ALL_DAYS;
+  unsigned months = ALL_MONTHS;
+  time_t start = 0;
+  time_t end = 1440 * 60;
+  size_t time_terms = 0;
+  Filter *time_term = NULL;
+  size_t kept = 0;
+  for (size_t i = 0; i < count; i++) {
+    Filter *t = terms[i];
+    if (!t || t->type == FILTER_NONE) {
+      destroy_filter(t);
+    } else if (t->type == FILTER_DAY_MASK) {
+      mask &= t->data.day_mask;
+      destroy_filter(t);
+    } else if (t->type == FILTER_MONTH_MASK) {
+      months &= t->data.month_mask;
+      destroy_filter(t);
+    } else if (t->type == FILTER_AFTER_TIME || t->type == FILTER_BEFORE_TIME ||
+               t->type == FILTER_TIME_WINDOW) {
+      time_t lo = 0;
+      time_t hi = 1440 * 60;
+      if (t->type == FILTER_AFTER_TIME) {
+        lo = t->data.seconds;
+      } else if (t->type == FILTER_BEFORE_TIME) {
+        hi = t->data.seconds;
+      } else {
+        lo = t->data.window.start;
+        hi = t->data.window.end;
+      }
+      start = lo > start ? lo : start;
+      end = hi < end ? hi : end;
+      if (time_terms++ == 0) {
+        time_term = t;
+      } else {
+        destroy_filter(time_term);
+        destroy_filter(t);
+        time_term = NULL;
+      }
+    } else {
+      terms[kept++] = t;
+    }
+  }
+  if (mask == 0 || (months & ALL_MONTHS) == 0) {
+    // No day can match, the rest does not matter
+    destroy_filters(terms, kept);
+    destroy_filter(time_term);
+    return make_day_mask(arena, 0);
+  }
+
+  // Cheap calendar-independent checks go first
+  order_by_cost(terms, kept);
+  Filter *head[3];
+  size_t heads = 0;
+  if (mask != ALL_DAYS) {
+    head[heads++] = make_day_mask(arena, mask);
+  }
+  if ((months & ALL_MONTHS) != ALL_MONTHS) {
+    head[heads++] = make_month_mask(arena, months);
+  }
+  if (time_terms == 1) {
+    head[heads++] = time_term;
+  } else if (time_terms > 1) {
+    Filter *window = make_filter_in(arena, FILTER_TIME_WINDOW);
+    if (window) {
+      window->data.window.start = start;
+      window->data.window.end = end;
+    }
+    head[heads++] = window;
+  }
+  memmove(terms + heads, terms, kept * sizeof(Filter *));
+  memcpy(terms, head, heads * sizeof(Filter *));
+  return chain_filters(arena, terms, heads + kept, FILTER_AND);
+}
+
+static Filter *merge_disjunction(FilterArena *arena, Filter **terms,
+                                 size_t count) {
+  unsigned mask = 0;
+  unsigned months = 0;
+  bool always = false;
+  size_t kept = 0;
+  for (size_t i = 0; i < count; i++) {
+    Filter *t = terms[i];
+    if (!t || t->type == FILTER_NONE) {
+      always = true;
+      destroy_filter(t);
+    } else if (t->type == FILTER_DAY_MASK) {
+      mask |= t->data.day_mask;
+      destroy_filter(t);
+    } else if (t->type == FILTER_MONTH_MASK) {
+      months |= t->data.month_mask;
+      destroy_filter(t);
+    } else {
+      terms[kept++] = t;
+    }
+  }
+  if (always || mask == ALL_DAYS || (months & ALL_MONTHS) == ALL_MONTHS) {
+    destroy_filters(terms, kept);
+    return make_filter_in(arena, FILTER_NONE);
+  }
+  order_by_cost(terms, kept);
+  if (months & ALL_MONTHS) {
+    memmove(terms + 1, terms, kept * sizeof(Filter *));
+    terms[0] = make_month_mask(arena, months);
+    kept++;
+  }
+  if (mask) {
+    memmove(terms + 1, terms, kept * sizeof(Filter *));
+    terms[0] = make_day_mask(arena, mask);
+    kept++;
+  }
+  if (kept == 0) {
+    return make_day_mask(arena, 0); // Only empty day sets: never valid
+  }
+  return chain_filters(arena, terms, kept, FILTER_OR);
+}
+
+Filter *optimize_filter(Filter *filter) {
+  if (!filter) {
+    return NULL;
+  }
+  switch (filter->type) {
+  case FILTER_DAY_OF_WEEK: {
+    unsigned day = (unsigned)filter->data.day_of_week;
+    if (day > 6) {
+      return filter;
+    }
+    filter->type = FILTER_DAY_MASK;
+    filter->data.day_mask = (unsigned char)(1u << day);
+    return filter;
+  }
+  case FILTER_NOT: {
+    Filter *operand = optimize_filter(filter->data.operand);
+    if (operand && operand->type == FILTER_NOT) {
+      Filter *inner = operand->data.operand;
+      release_node(operand);
+      release_node(filter);
+      return inner;
+    }
+    if (operand && operand->type == FILTER_DAY_MASK) {
+      release_node(filter);
+      operand->data.day_mask ^= ALL_DAYS;
+      if (operand->data.day_mask == ALL_DAYS) {
+        operand->type = FILTER_NONE;
+      }
+      return operand;
+    }
+    if (operand && operand->type == FILTER_MONTH_MASK) {
+      release_node(filter);
+      operand->data.month_mask = (unsigned short)(~operand->data.month_mask &
+                                                  ALL_MONTHS);
+      if (operand->data.month_mask == ALL_MONTHS) {
+        operand->type = FILTER_NONE;
+      }
+      return operand;
+    }
+    filter->data.operand = operand;
+    return filter;
+  }
+  case FILTER_AND:
+  case FILTER_OR: {
+    // Every operand of the flattened chain is a node of the original tree
+    Filter **terms = malloc(count_filter_nodes(filter) * sizeof(Filter *));
+    if (!terms) {
+      return filter; // Unoptimised but still correct
+    }
+    const FilterType type = filter->type;
+    FilterArena *arena = filter->arena;
+    size_t count = 0;
+    flatten_filter(filter, type, terms, &count);
+    Filter *result = type == FILTER_AND
+                         ? merge_conjunction(arena, terms, count)
+                         : merge_disjunction(arena, terms, count);
+    free(terms);
+    return result;
+  }
+  default:
+    return filter;
+  }
+}
+
+// Returns true if the subtree only depends on the weekday and the time of
+// day, with every time on a minute boundary
+static bool is_weekly(const Filter *filter) {
+  if (!filter) {
+    return false;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return is_weekly(filter->data.logical.left) &&
+           is_weekly(filter->data.logical.right);
+  case FILTER_NOT:
+    return is_weekly(filter->data.operand);
+  case FILTER_DAY_OF_WEEK:
+  case FILTER_DAY_MASK:
+    return true;
+  case FILTER_AFTER_TIME:
+  case FILTER_BEFORE_TIME:
+    return filter->data.seconds % 60 == 0;
+  case FILTER_TIME_WINDOW:
+    return filter->data.window.start % 60 == 0 &&
+           filter->data.window.end % 60 == 0;
+  default:
+    return false;
+  }
+}
+
+// Sets the minutes [start, end) of the day, clamped to the day, on each of
+// the days in day_mask
+static void set_week_minutes(uint64_t *bits, const unsigned day_mask,
+                             time_t start, time_t end) {
+  start = start < 0 ? 0 : start;
+  end = end > 1440 ? 1440 : end;
+  for (size_t day = 0; day < 7; day++) {
+    if (!(day_mask & (1u << day))) {
+      continue;
+    }
+    for (time_t minute = start; minute < end; minute++) {
+      size_t bit = day * 1440 + (size_t)minute;
+      bits[bit / 64] |= (uint64_t)1 << (bit % 64);
+    }
+  }
+}
+
+// Fills bits (WEEK_WORDS words) with the minutes at which a weekly subtree
+// is valid, as eval_leaf would report them. Returns false on allocation
+// failure.
+static bool fill_week_mask(const Filter *filter, uint64_t *bits) {
+  memset(bits, 0, WEEK_WORDS * sizeof(uint64_t));
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR: {
+    uint64_t *right = malloc(WEEK_WORDS * sizeof(uint64_t));
+    if (!right || !fill_week_mask(filter->data.logical.left, bits) ||
+        !fill_week_mask(filter->data.logical.right, right)) {
+      free(right);
+      return false;
+    }
+    for (size_t w = 0; w < WEEK_WORDS; w++) {
+      bits[w] = filter->type == FILTER_AND ? bits[w] & right[w]
+                                           : bits[w] | right[w];
+    }
+    free(right);
+    return true;
+  }
+  case FILTER_NOT:
+    if (!fill_week_mask(filter->data.operand, bits)) {
+      return false;
+    }
+    for (size_t w = 0; w < WEEK_WORDS; w++) {
+      bits[w] = ~bits[w];
+    }
+    break;
+  case FILTER_DAY_OF_WEEK:
+    set_week_minutes(bits, 1u << (filter->data.day_of_week % 7), 0, 1440);
+    break;
+  case FILTER_DAY_MASK:
+    set_week_minutes(bits, filter->data.day_mask, 0, 1440);
+    break;
+  case FILTER_AFTER_TIME:
+    set_week_minutes(bits, ALL_DAYS, filter->data.seconds / 60, 1440);
+    break;
+  case FILTER_BEFORE_TIME:
+    set_week_minutes(bits, ALL_DAYS, 0, filter->data.seconds / 60);
+    break;
+  case FILTER_TIME_WINDOW:
+    set_week_minutes(bits, ALL_DAYS, filter->data.window.start / 60,
+                     filter->data.window.end / 60);
+    break;
+  default:
+    break;
+  }
+  return true;
+}
+
+// Emits the post-order code of a subtree at *pc and returns the stack depth
+// its evaluation needs. AND and OR also get a test between their operands
+// that jumps past the right one and the combination when the left one
+// decides the result.
+static size_t emit_filter(const Filter *filter, FilterInstr *code,
+                          size_t *pc) {
+  if (!filter) {
+    code[*pc].type = FILTER_NONE;
+    code[(*pc)++].jump = 0;
+    return 1;
+  }
+  // A single leaf is as cheap as a lookup
+  if ((filter->type == FILTER_AND || filter->type == FILTER_OR ||
+       filter->type == FILTER_NOT) &&
+      is_weekly(filter)) {
+    uint64_t *bits = malloc(WEEK_WORDS * sizeof(uint64_t));
+    if (bits && fill_week_mask(filter, bits)) {
+      code[*pc].type = FILTER_WEEK_MASK;
+      code[*pc].jump = 0;
+      code[(*pc)++].arg.week_bits = bits;
+      return 1;
+    }
+    free(bits); // Evaluated node by node instead
+  }
+  size_t depth = 1;
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR: {
+    size_t left = emit_filter(filter->data.logical.left, code, pc);
+    size_t test = (*pc)++;
+    size_t right = emit_filter(filter->data.logical.right, code, pc);
+    code[test].type = filter->type;
+    code[test].jump = *pc - test; // Lands on the combination, then past it
+    depth = left > right + 1 ? left : right + 1;
+    break;
+  }
+  case FILTER_NOT:
+    depth = emit_filter(filter->data.operand, code, pc);
+    break;
+  default:
+    break;
+  }
+
+  lower_node(filter, &code[(*pc)++]);
+  return depth;
+}
+
+CompiledFilter *compile_filter(const Filter *filter) {
+  CompiledFilter *compiled = malloc(sizeof(CompiledFilter));
+  if (!compiled) {
+    return NULL;
+  }
+  // At most two instructions per node
+  size_t count = 2 * count_filter_nodes(filter);
+  compiled->code = malloc(count * sizeof(FilterInstr));
+  if (!compiled->code) {
+    free(compiled);
+    return NULL;
+  }
+  compiled->length = 0;
+  compiled->depth = emit_filter(filter, compiled->code, &compiled->length);
+  compiled->stack = malloc(compiled->depth * sizeof(FilterValue));
+  if (!compiled->stack) {
+    free_compiled_filter(compiled);
+    return NULL;
+  }
+  return compiled;
+}
+
+// Runs the code for one candidate, looking forward or back, adding the
+// number of nodes evaluated to *evaluated
+static FilterValue run_compiled(const CompiledFilter *compiled,
+                                const EvalPoint *point, const time_t duration,
+                                const Calendar *calendar, const bool backward,
+                                unsigned long *evaluated) {
+  FilterValue *stack = compiled->stack;
+  if (compiled->length == 0) {
+    const FilterValue always = {0, -1};
+    return always;
+  }
+  size_t top = 0;
+  const FilterInstr *end = compiled->code + compiled->length;
+  for (const FilterInstr *instr = compiled->code; instr < end; instr++) {
+    if (instr->jump) {
+      // Test after the left operand, whose value stays as the result
+      if (decides(instr->type, stack[top - 1])) {
+        instr += instr->jump;
+        (*evaluated)++;
+      }
+      continue;
+    }
+    (*evaluated)++;
+    switch (instr->type) {
+    case FILTER_AND:
+      top--;
+      stack[top - 1] = and_values(stack[top - 1], stack[top]);
+      break;
+    case FILTER_OR:
+      top--;
+      stack[top - 1] = or_values(stack[top - 1], stack[top]);
+      break;
+    case FILTER_NOT:
+      stack[top - 1] = not_value(stack[top - 1]);
+      break;
+    default:
+      stack[top++] = backward
+                         ? eval_leaf_back(instr, point, duration, calendar)
+                         : eval_leaf(instr, point, duration, calendar);
+      break;
+    }
+  }
+  return stack[0];
+}
+
+time_t until_valid_compiled(const CompiledFilter *compiled,
+                            const time_t candidate, const time_t duration,
+                            const Calendar *calendar) {
+  if (!compiled || compiled->length == 0) {
+    return 0;
+  }
+  EvalPoint point;
+  if (!make_eval_point(&point, candidate)) {
+    return -1; // Invalid time
+  }
+  unsigned long evaluated = 0;
+  return run_compiled(compiled, &point, duration, calendar, false, &evaluated)
+      .until_valid;
+}
+
+void free_compiled_filter(CompiledFilter *compiled) {
+  if (!compiled)
+    return;
+  for (size_t i = 0; i < compiled->length; i++) {
+    if (compiled->code[i].type == FILTER_WEEK_MASK) {
+      free(compiled->code[i].arg.week_bits);
+    }
+  }
+  free(compiled->code);
+  free(compiled->stack);
+  free(compiled);
+}
+
+// Nanoseconds on a clock that does not jump with the wall time
+static long long now_ns(void) {
+  struct timespec ts;
+#ifdef _WIN32
+  timespec_get(&ts, TIME_UTC);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static long long now_ms(void) { return now_ns() / 1000000; }
+
+// profiling
+
+// Fills in the pre-order entries of a subtree from nodes[at] on and returns
+// its size
+static size_t fill_profile(const Filter *filter, FilterNodeProfile *nodes,
+                           const size_t at, const int depth) {
+  FilterNodeProfile *node = &nodes[at];
+  memset(node, 0, sizeof(FilterNodeProfile));
+  node->node = filter;
+  node->depth = depth;
+  node->size = 1;
+  if (filter && (filter->type == FILTER_AND || filter->type == FILTER_OR)) {
+    node->size += fill_profile(filter->data.logical.left, nodes, at + 1,
+                               depth + 1);
+    node->size += fill_profile(filter->data.logical.right, nodes,
+                               at + node->size, depth + 1);
+  } else if (filter && filter->type == FILTER_NOT) {
+    node->size += fill_profile(filter->data.operand, nodes, at + 1, depth + 1);
+  }
+  return node->size;
+}
+
+FilterProfile *create_filter_profile(const Filter *filter) {
+  FilterProfile *profile = malloc(sizeof(FilterProfile));
+  if (!profile) {
+    return NULL;
+  }
+  profile->filter = filter;
+  profile->count = count_filter_nodes(filter);
+  profile->nodes = malloc(profile->count * sizeof(FilterNodeProfile));
+  if (!profile->nodes) {
+    free(profile);
+    return NULL;
+  }
+  fill_profile(filter, profile->nodes, 0, 0);
+  return profile;
+}
+
+void free_filter_profile(FilterProfile *profile) {
+  if (!profile)
+    return;
+  free(profile->nodes);
+  free(profile);
+}
+
+// eval_node that also records what each node returned in the profile
+// entry at *next, the node's pre-order index
+static FilterValue eval_profiled(const Filter *filter, const EvalPoint *point,
+                                 const time_t duration,
+                                 const Calendar *calendar,
+                                 FilterNodeProfile *nodes, size_t *next,
+                                 unsigned long *evaluated) {
+  FilterNodeProfile *node = &nodes[(*next)++];
+  const long long started = now_ns();
+  FilterValue value = {0, -1};
+  (*evaluated)++;
+  if (!filter) {
+    // Any time is valid
+  } else if (filter->type == FILTER_AND || filter->type == FILTER_OR) {
+    value = eval_profiled(filter->data.logical.left, point, duration,
+                          calendar, nodes, next, evaluated);
+    if (decides(filter->type, value)) {
+      *next += nodes[*next].size; // The right operand is not evaluated
+    } else {
+      FilterValue right = eval_profiled(filter->data.logical.right, point,
+                                        duration, calendar, nodes, next,
+                                        evaluated);
+      value = filter->type == FILTER_AND ? and_values(value, right)
+                                         : or_values(value, right);
+    }
+  } else if (filter->type == FILTER_NOT) {
+    value = not_value(eval_profiled(filter->data.operand, point, duration,
+                                    calendar, nodes, next, evaluated));
+  } else {
+    FilterInstr leaf;
+    lower_node(filter, &leaf);
+    value = eval_leaf(&leaf, point, duration, calendar);
+  }
+  node->nanoseconds += now_ns() - started;
+  node->calls++;
+  if (value.until_valid < 0) {
+    node->never++;
+  } else if (value.until_valid == 0) {
+    node->valid++;
+  } else {
+    node->skipped += value.until_valid;
+  }
+  return value;
+}
+
+// Writes a short description of one node, without its operands
+static void describe_node(const Filter *filter, char *buf, const size_t size) {
+  static const char *const days[] = {"Sunday",   "Monday",   "Tuesday",
+                                     "Wednesday", "Thursday", "Friday",
+                                     "Saturday"};
+  static const char *const months[] = {"Jan", "Feb", "Mar", "Apr",
+                                       "May", "Jun", "Jul", "Aug",
+                                       "Sep", "Oct", "Nov", "Dec"};
+  static const char *const ordinals[] = {"last",  "first",  "second",
+                                         "third", "fourth", "fifth"};
+  if (!filter) {
+    snprintf(buf, size, "any time");
+    return;
+  }
+  struct tm tm;
+  size_t len = 0;
+  switch (filter->type) {
+  case FILTER_DAY_OF_WEEK:
+    snprintf(buf, size, "on %s", days[filter->data.day_of_week % 7]);
+    break;
+  case FILTER_AFTER_DATETIME:
+  case FILTER_BEFORE_DATETIME:
+    len = (size_t)snprintf(buf, size, "%s ",
+                           filter->type == FILTER_AFTER_DATETIME ? "after"
+                                                                 : "before");
+    if (local_time(filter->data.time_value, &tm)) {
+      strftime(buf + len, size - len, "%Y-%m-%d %H:%M", &tm);
+    }
+    break;
+  case FILTER_AFTER_TIME:
+  case FILTER_BEFORE_TIME:
+    snprintf(buf, size, "%s %02ld:%02ld",
+             filter->type == FILTER_AFTER_TIME ? "after" : "before",
+             (long)(filter->data.seconds / 3600),
+             (long)(filter->data.seconds / 60 % 60));
+    break;
+  case FILTER_MIN_DISTANCE:
+    snprintf(buf, size, "spaced %d minutes", filter->data.minutes);
+    break;
+  case FILTER_HOLIDAY:
+    snprintf(buf, size, "holiday");
+    break;
+  case FILTER_DAY_MASK:
+    len = (size_t)snprintf(buf, size, "on");
+    for (int d = 0; d < 7 && len < size; d++) {
+      if (filter->data.day_mask & (1u << d)) {
+        len += (size_t)snprintf(buf + len, size - len, "%s%.3s",
+                                len > 2 ? "," : " ", days[d]);
+      }
+    }
+    break;
+  case FILTER_TIME_WINDOW:
+    snprintf(buf, size, "between %02ld:%02ld and %02ld:%02ld",
+             (long)(filter->data.window.start / 3600),
+             (long)(filter->data.window.start / 60 % 60),
+             (long)(filter->data.window.end / 3600),
+             (long)(filter->data.window.end / 60 % 60));
+    break;
+  case FILTER_MONTH_MASK:
+    len = (size_t)snprintf(buf, size, "in");
+    for (int m = 0; m < 12 && len < size; m++) {
+      if (filter->data.month_mask & (1u << m)) {
+        len += (size_t)snprintf(buf + len, size - len, "%s%s",
+                                len > 2 ? "," : " ", months[m]);
+      }
+    }
+    break;
+  case FILTER_MONTH_DAYS:
+    len = (size_t)snprintf(buf, size, "days");
+    for (int d = 1; d <= 31 && len < size; d++) {
+      if (filter->data.month_days & (1u << d)) {
+        len += (size_t)snprintf(buf + len, size - len, "%s%d",
+                                len > 4 ? "," : " ", d);
+      }
+    }
+    break;
+  case FILTER_NTH_WEEKDAY:
+    snprintf(buf, size, "%s %s",
+             ordinals[filter->data.nth.week < 0 ? 0
+                                                : filter->data.nth.week % 6],
+             days[filter->data.nth.day_of_week % 7]);
+    break;
+  case FILTER_DATE_RANGE:
+    len = (size_t)snprintf(buf, size, "from ");
+    if (local_time(filter->data.range.start, &tm)) {
+      len += strftime(buf + len, size - len, "%Y-%m-%d %H:%M", &tm);
+    }
+    if (len + 4 < size && local_time(filter->data.range.end, &tm)) {
+      len += (size_t)snprintf(buf + len, size - len, " to ");
+      strftime(buf + len, size - len, "%Y-%m-%d %H:%M", &tm);
+    }
+    break;
+  case FILTER_AND:
+    snprintf(buf, size, "and");
+    break;
+  case FILTER_OR:
+    snprintf(buf, size, "or");
+    break;
+  case FILTER_NOT:
+    snprintf(buf, size, "not");
+    break;
+  default:
+    snprintf(buf, size, "none");
+    break;
+  }
+}
+
+// Writes a number of seconds in the largest unit that keeps it above one
+static void format_span(const double seconds, char *buf, const size_t size) {
+  if (seconds < 60) {
+    snprintf(buf, size, "%.0fs", seconds);
+  } else if (seconds < 60 * 60) {
+    snprintf(buf, size, "%.1fm", seconds / 60);
+  } else if (seconds < 24 * 60 * 60) {
+    snprintf(buf, size, "%.1fh", seconds / (60 * 60));
+  } else {
+    snprintf(buf, size, "%.1fd", seconds / (24 * 60 * 60));
+  }
+}
+
+void print_filter_profile(const FilterProfile *profile, FILE *out) {
+  fprintf(out, "%10s %10s %10s %9s %10s  %s\n", "calls", "valid", "never",
+          "avg skip", "time ms", "filter");
+  for (size_t i = 0; i < profile->count; i++) {
+    const FilterNodeProfile *node = &profile->nodes[i];
+    char skip[16] = "-";
+    const unsigned long skips = node->calls - node->valid - node->never;
+    if (skips > 0) {
+      format_span((double)node->skipped / skips, skip, sizeof(skip));
+    }
+    char description[160];
+    describe_node(node->node, description, sizeof(description));
+    fprintf(out, "%10lu %10lu %10lu %9s %10.3f  %*s%s\n", node->calls,
+            node->valid, node->never, skip, node->nanoseconds / 1e6,
+            2 * node->depth, "", description);
+  }
+}
+
+// Evaluates a candidate, with the profile or else the compiled filter when
+// there is one
+static FilterValue eval_candidate(const Filter *filter,
+                                  const CompiledFilter *compiled,
+                                  FilterProfile *profile,
+                                  const time_t candidate,
+                                  const time_t duration,
+                                  const Calendar *calendar,
+                                  unsigned long *evaluated) {
+  FilterValue never = {-1, 0};
+  EvalPoint point;
+  if (!make_eval_point(&point, candidate)) {
+    return never; // Invalid time
+  }
+  if (profile && profile->filter == filter) {
+    size_t next = 0;
+    return eval_profiled(filter, &point, duration, calendar, profile->nodes,
+                         &next, evaluated);
+  }
+  if (compiled) {
+    return run_compiled(compiled, &point, duration, calendar, false,
+                        evaluated);
+  }
+  return eval_node(filter, &point, duration, calendar, false, evaluated);
+}
+
+#define DEFAULT_MAX_ITERATIONS (365 * 24 * 60 / 15)
+
+// Skips forward from candidate to the first valid time and stores its
+// value. Returns -1 if there is none within the options' limits; the
+// stats say which limit stopped the search.
+static time_t search_forward(const Filter *filter,
+                             const CompiledFilter *compiled,
+                             const Calendar *calendar, time_t candidate,
+                             const time_t duration,
+                             const SearchOptions *options, SearchStats *stats,
+                             FilterValue *found) {
+  const unsigned long max_iterations =
+      options && options->max_iterations ? options->max_iterations
+                                         : DEFAULT_MAX_ITERATIONS;
+  const time_t horizon = options ? options->horizon : 0;
+  const long long deadline = options && options->time_limit_ms > 0
+                                 ? now_ms() + options->time_limit_ms
+                                 : 0;
+  unsigned long iterations = 0;
+  while (iterations < max_iterations) {
+    if (horizon && candidate > horizon) {
+      stats->status = SEARCH_HORIZON;
+      return -1;
+    }
+    // Reading the clock costs more than a cheap evaluation
+    if (iterations % 64 == 0) {
+      if (deadline && now_ms() >= deadline) {
+        stats->status = SEARCH_DEADLINE;
+        return -1;
+      }
+      if (options && options->cancelled &&
+          options->cancelled(options->cancel_arg)) {
+        stats->status = SEARCH_CANCELLED;
+        return -1;
+      }
+    }
+    iterations++;
+    stats->iterations++;
+    FilterValue value =
+        eval_candidate(filter, compiled, options ? options->profile : NULL,
+                       candidate, duration, calendar, &stats->evaluations);
+    time_t skip_seconds = value.until_valid;
+
+    if (skip_seconds < 0) {
+      stats->status = SEARCH_UNSATISFIABLE;
+      return -1; // No valid time found within filter constraints
+    }
+
+    if (skip_seconds > 0) {
       candidate += skip_seconds;
+      stats->skipped += skip_seconds;
       continue;
     }
     // Now is a valid time
+    stats->status = SEARCH_FOUND;
+    *found = value;
     return candidate;
   }
-  printf("find_optimal_time: exceeded max iterations (%d)\n", max_iterations);
+  stats->status = SEARCH_ITERATIONS;
+  return -1;
+}
+
+time_t search_optimal_time(const Calendar *calendar, const Filter *filter,
+                           const time_t start_time, const time_t duration,
+                           const SearchOptions *options, SearchStats *stats) {
+  SearchStats local;
+  if (!stats) {
+    stats = &local;
+  }
+  memset(stats, 0, sizeof(SearchStats));
+  CompiledFilter *compiled = compile_filter(filter);
+  FilterValue value;
+  time_t slot = search_forward(filter, compiled, calendar, start_time,
+                               duration, options, stats, &value);
+  free_compiled_filter(compiled);
+  return slot;
+}
+
+time_t find_optimal_time(const Calendar *calendar, const Filter *filter,
+                         const time_t start_time, const time_t duration) {
+
+  if (!filter) {
+    return start_time; // No filter means now is valid
+  }
+  time_t slot;
+  if (find_optimal_times(calendar, filter, start_time, duration, 1, &slot) ==
+      0) {
+    return -1;
+  }
+  return slot;
+}
+
+size_t find_optimal_times(const Calendar *calendar, const Filter *filter,
+                          const time_t start_time, const time_t duration,
+                          const size_t k, time_t *out) {
+  SlotCursor *cursor =
+      create_slot_cursor(calendar, filter, start_time, duration, NULL);
+  if (!cursor) {
+    return 0;
+  }
+  size_t found = 0;
+  while (found < k) {
+    time_t slot = next_slot(cursor);
+    if (slot < 0) {
+      break;
+    }
+    out[found++] = slot;
+  }
+  free_slot_cursor(cursor);
+  return found;
+}
+
+// Evaluates a candidate looking back, with the compiled code if there is
+// any, otherwise by walking the tree
+static FilterValue eval_candidate_back(const Filter *filter,
+                                       const CompiledFilter *compiled,
+                                       const time_t candidate,
+                                       const time_t duration,
+                                       const Calendar *calendar) {
+  FilterValue never = {-1, 0};
+  EvalPoint point;
+  if (!make_eval_point(&point, candidate)) {
+    return never; // Invalid time
+  }
+  unsigned long evaluated = 0;
+  if (compiled) {
+    return run_compiled(compiled, &point, duration, calendar, true,
+                        &evaluated);
+  }
+  return eval_node(filter, &point, duration, calendar, true, &evaluated);
+}
+
+// Skips back from candidate to the latest valid second, or -1
+static time_t search_back(const Calendar *calendar, const Filter *filter,
+                          const CompiledFilter *compiled, time_t candidate,
+                          const time_t duration) {
+  for (unsigned long i = 0; i < DEFAULT_MAX_ITERATIONS; i++) {
+    time_t skip =
+        eval_candidate_back(filter, compiled, candidate, duration, calendar)
+            .until_valid;
+    if (skip < 0) {
+      return -1; // Never valid before the deadline
+    }
+    if (skip == 0) {
+      return candidate;
+    }
+    candidate -= skip;
+  }
   return -1;
 }
 
+time_t find_latest_time(const Calendar *calendar, const Filter *filter,
+                        const time_t deadline, const time_t duration) {
+  if (!filter) {
+    return deadline - duration;
+  }
+  // Walks the tree if the filter cannot be compiled
+  CompiledFilter *compiled = compile_filter(filter);
+  time_t slot = search_back(calendar, filter, compiled, deadline - duration,
+                            duration);
+  free_compiled_filter(compiled);
+  return slot;
+}
+
+SlotCursor *create_slot_cursor(const Calendar *calendar, const Filter *filter,
+                               const time_t start_time, const time_t duration,
+                               const SearchOptions *options) {
+  SlotCursor *cursor = calloc(1, sizeof(SlotCursor));
+  if (!cursor) {
+    return NULL;
+  }
+  cursor->calendar = calendar;
+  cursor->filter = filter;
+  cursor->compiled = compile_filter(filter);
+  cursor->position = start_time;
+  cursor->duration = duration;
+  if (options) {
+    cursor->options = *options;
+  }
+  return cursor;
+}
+
+time_t next_slot(SlotCursor *cursor) {
+  if (cursor->done) {
+    return -1;
+  }
+  const time_t from = cursor->position;
+  memset(&cursor->stats, 0, sizeof(SearchStats));
+  FilterValue value;
+  time_t slot = search_forward(cursor->filter, cursor->compiled,
+                               cursor->calendar, from, cursor->duration,
+                               &cursor->options, &cursor->stats, &value);
+  if (slot < 0) {
+    switch (cursor->stats.status) {
+    case SEARCH_ITERATIONS:
+    case SEARCH_DEADLINE:
+    case SEARCH_CANCELLED:
+      // Everything skipped so far was invalid: resume after it
+      cursor->position = from + cursor->stats.skipped;
+      break;
+    default:
+      cursor->done = true;
+    }
+    return -1;
+  }
+  // Carry on from the end of the slot; without a duration, from the end
+  // of the valid range it starts
+  if (cursor->duration > 0) {
+    cursor->position = slot + cursor->duration;
+  } else if (value.until_invalid > 0) {
+    cursor->position = slot + value.until_invalid;
+  } else {
+    cursor->position = slot + 60;
+  }
+  return slot;
+}
+
+void free_slot_cursor(SlotCursor *cursor) {
+  if (!cursor)
+    return;
+  free_compiled_filter(cursor->compiled);
+  free(cursor);
+}
+
 void destroy_filter(Filter *filter) {
   if (!filter)
     return;
@@ -394,5 +2135,5 @@ void destroy_filter(Filter *filter) {
     destroy_filter(filter->data.operand);
   }
 
-  free(filter);
+  release_node(filter);
 }
@@ -3,6 +3,8 @@
 
 #include "calendar.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 typedef enum {
@@ -13,18 +15,44 @@ typedef enum {
   FILTER_AFTER_TIME,
   FILTER_MIN_DISTANCE,
   FILTER_HOLIDAY,
+  FILTER_DAY_MASK,    // set of days of the week
+  FILTER_TIME_WINDOW, // time of day range
+  FILTER_MONTH_MASK,  // set of months
+  FILTER_MONTH_DAYS,  // set of days of the month
+  FILTER_NTH_WEEKDAY, // e.g. the first Monday or the last Friday of a month
+  FILTER_DATE_RANGE,  // absolute range of times
+  FILTER_WEEK_MASK,   // compiled only: weekly bitmap of minutes
   FILTER_AND,
   FILTER_OR,
   FILTER_NOT,
   FILTER_NONE
 } FilterType;
 
+struct FilterArena;
+
 typedef struct Filter {
   FilterType type;
+  struct FilterArena *arena; // owner of the node, or NULL if malloc'd
   union {
     int day_of_week;
-    time_t time_value;
+    time_t time_value; // FILTER_AFTER_DATETIME, FILTER_BEFORE_DATETIME
+    time_t seconds;    // since local midnight: FILTER_AFTER/BEFORE_TIME
     int minutes;
+    unsigned char day_mask; // bit n set: valid on tm_wday n
+    struct {
+      time_t start; // seconds since local midnight, inclusive
+      time_t end;   // exclusive
+    } window;
+    unsigned short month_mask; // bit n set: valid in tm_mon n
+    unsigned month_days;       // bit n set: valid on day n of the month
+    struct {
+      int week; // 1 to 5, or -1 for the last one of the month
+      int day_of_week;
+    } nth;
+    struct {
+      time_t start; // inclusive
+      time_t end;   // exclusive
+    } range;
     struct {
       struct Filter *left;
       struct Filter *right;
@@ -33,10 +61,37 @@ typedef struct Filter {
   } data;
 } Filter;
 
+// Block of filter nodes handed out in order
+typedef struct FilterBlock {
+  struct FilterBlock *next;
+  size_t used;
+  size_t capacity;
+  Filter nodes[];
+} FilterBlock;
+
+// Allocates filter nodes contiguously from large blocks, so a parsed filter
+// sits in one place and is released all at once. Combinators and
+// optimize_filter put new nodes in the arena of their operands, and
+// destroy_filter leaves arena nodes alone.
+typedef struct FilterArena {
+  FilterBlock *blocks; // the block being filled first
+  size_t block_size;   // nodes per block
+} FilterArena;
+
+// Creates an arena; a block_size of 0 picks a default. Returns NULL on
+// allocation failure.
+FilterArena *create_filter_arena(size_t block_size);
+// Releases every node allocated from the arena, keeping one block for
+// reuse. Filters from the arena must not be used afterwards.
+void reset_filter_arena(FilterArena *arena);
+void free_filter_arena(FilterArena *arena);
+
 // combinators
 
 // Creates a basic filter of the specified type
 Filter *make_filter(FilterType type);
+// Creates a basic filter in an arena, or with malloc if arena is NULL
+Filter *make_filter_in(FilterArena *arena, FilterType type);
 // Combines two filters with a logical OR
 Filter *or_filter(Filter *left, Filter *right);
 // Combines two filters with a logical AND
@@ -48,6 +103,16 @@ Filter *not_filter(Filter *operand);
 
 // Parses a filter string into a Filter structure
 Filter *parse_filter(const char *filter_str);
+// Same as parse_filter, with every node allocated from the arena
+Filter *parse_filter_in(FilterArena *arena, const char *filter_str);
+
+// Rewrites a filter into an equivalent, smaller one: unions and
+// intersections of days (or months) become a single day (or month) mask,
+// time of day bounds that are ANDed together become one window, NONE
+// operands and double negations are folded away. The operands of AND and OR
+// chains are put cheapest first, so evaluation can stop before the costly
+// ones. Takes ownership of the filter and returns the new root.
+Filter *optimize_filter(Filter *filter);
 
 // Evaluates whether a candidate time satisfies the filter conditions
 bool evaluate_filter(const Filter *filter, const time_t candidate,
@@ -66,7 +131,179 @@ time_t until_valid(const Filter *filter, const time_t candidate,
 time_t find_optimal_time(const Calendar *calendar, const Filter *filter,
                          const time_t start_time, const time_t duration);
 
-// Frees a Filter structure and its sub-filters
+// Limits for search_optimal_time; zero fields mean no limit (or, for
+// max_iterations, the default used by find_optimal_time)
+typedef struct SearchOptions {
+  time_t horizon;               // latest start time considered
+  unsigned long max_iterations; // candidate evaluations
+  long time_limit_ms;           // wall-clock budget
+  // Polled with cancel_arg every few iterations; returning true stops the
+  // search (e.g. when another thread has found an earlier slot)
+  bool (*cancelled)(void *arg);
+  void *cancel_arg;
+  // Records per-node statistics of the search filter when set; evaluation
+  // then walks the tree instead of running the compiled code
+  struct FilterProfile *profile;
+} SearchOptions;
+
+typedef enum {
+  SEARCH_FOUND,
+  SEARCH_UNSATISFIABLE, // the filter can never be satisfied again
+  SEARCH_HORIZON,
+  SEARCH_ITERATIONS,
+  SEARCH_DEADLINE,
+  SEARCH_CANCELLED,
+} SearchStatus;
+
+typedef struct SearchStats {
+  unsigned long iterations;  // candidates evaluated
+  unsigned long evaluations; // filter nodes evaluated
+  time_t skipped;            // seconds skipped over in total
+  SearchStatus status;       // why the search stopped
+} SearchStats;
+
+// find_optimal_time with explicit limits. Fills in stats if not NULL.
+// Returns -1 if no slot was found; stats->status tells whether the filter
+// is unsatisfiable or a limit was reached first.
+time_t search_optimal_time(const Calendar *calendar, const Filter *filter,
+                           const time_t start_time, const time_t duration,
+                           const SearchOptions *options, SearchStats *stats);
+
+// Finds up to k non-overlapping slots in one forward search: each slot after
+// the first starts no earlier than the end of the previous one, or, with no
+// duration, after the valid range of the previous one. Stores them in `out`
+// in order and returns how many were found.
+size_t find_optimal_times(const Calendar *calendar, const Filter *filter,
+                          const time_t start_time, const time_t duration,
+                          const size_t k, time_t *out);
+
+// Finds the latest slot that satisfies the filter and ends by the deadline,
+// by skipping back from deadline - duration the way find_optimal_time skips
+// forward: the last second of the last valid range. Returns -1 if there is
+// none.
+time_t find_latest_time(const Calendar *calendar, const Filter *filter,
+                        const time_t deadline, const time_t duration);
+
+// A find_optimal_times search that can be resumed, for paging through
+// slots: the filter is compiled once and each call to next_slot carries on
+// from where the previous one stopped.
+typedef struct SlotCursor {
+  const Calendar *calendar; // may change between calls
+  const Filter *filter;     // must outlive the cursor
+  struct CompiledFilter *compiled;
+  time_t position;       // next candidate
+  time_t duration;
+  SearchOptions options; // limits for each call; horizon is absolute
+  SearchStats stats;     // of the last call
+  bool done;             // no slot is left before the horizon
+} SlotCursor;
+
+// Starts a cursor at start_time. options may be NULL. Returns NULL on
+// allocation failure.
+SlotCursor *create_slot_cursor(const Calendar *calendar, const Filter *filter,
+                               const time_t start_time, const time_t duration,
+                               const SearchOptions *options);
+
+// Returns the next slot, as find_optimal_times would, or -1. When a
+// per-call limit (iterations, deadline, cancellation) stopped the search,
+// stats.status says so and the next call resumes where it stopped;
+// otherwise the cursor is exhausted.
+time_t next_slot(SlotCursor *cursor);
+
+void free_slot_cursor(SlotCursor *cursor);
+
+// profiling
+
+// What one node returned over a search. Time includes the node's operands.
+typedef struct FilterNodeProfile {
+  const Filter *node;
+  size_t size;           // nodes in the subtree, this one included
+  int depth;             // 0 for the root
+  unsigned long calls;   // evaluations of the node
+  unsigned long valid;   // calls that returned 0
+  unsigned long never;   // calls that returned -1
+  long long skipped;     // sum of the positive distances returned
+  long long nanoseconds; // spent in the node
+} FilterNodeProfile;
+
+// Per-node statistics of a filter, in pre-order
+typedef struct FilterProfile {
+  const Filter *filter;
+  size_t count;
+  FilterNodeProfile *nodes;
+} FilterProfile;
+
+// Creates an empty profile for the filter, to be passed in SearchOptions
+// of searches over that same filter. Returns NULL on allocation failure.
+FilterProfile *create_filter_profile(const Filter *filter);
+
+// Prints the filter as an indented tree, each node annotated with its call
+// count, valid and -1 results, average skip and time
+void print_filter_profile(const FilterProfile *profile, FILE *out);
+
+void free_filter_profile(FilterProfile *profile);
+
+// compiled evaluation
+
+// One instruction of a compiled filter. Leaves carry their constant with
+// anything that does not depend on the candidate already resolved; AND, OR
+// and NOT combine the values on top of the evaluation stack.
+typedef struct FilterInstr {
+  FilterType type;
+  union {
+    int day_of_week;
+    unsigned char day_mask;
+    struct {
+      time_t start;
+      time_t end;
+    } window; // FILTER_TIME_WINDOW, FILTER_DATE_RANGE
+    unsigned short month_mask;
+    unsigned month_days;
+    struct {
+      int week;
+      int day_of_week;
+    } nth;
+    time_t time_value; // FILTER_AFTER_DATETIME, FILTER_BEFORE_DATETIME
+    time_t seconds;    // time of day filters: seconds since local midnight
+    int minutes;
+    uint64_t *week_bits; // FILTER_WEEK_MASK, owned by the compiled filter
+  } arg;
+  // AND/OR: nonzero on the test that follows the left operand; the number
+  // of instructions to skip when that operand decides the result
+  size_t jump;
+} FilterInstr;
+
+// Minutes in a week, one bit each in a FILTER_WEEK_MASK: bit
+// tm_wday * 1440 + minute of the day
+#define WEEK_MINUTES (7 * 1440)
+
+// A filter tree flattened into post-order instructions in one array.
+// Subtrees that depend only on the weekday and the time of day (day masks
+// and time windows with AND, OR and NOT) are precomputed into a single
+// FILTER_WEEK_MASK instruction: evaluating them is a bit lookup, and their
+// skip distance a search for the next set (or clear) bit.
+// Evaluation reuses one stack, so a compiled filter must not be evaluated
+// by several threads at once.
+typedef struct CompiledFilter {
+  FilterInstr *code;
+  size_t length;
+  size_t depth;              // evaluation stack slots needed
+  struct FilterValue *stack; // `depth` slots
+} CompiledFilter;
+
+// Lowers a filter into its compiled form. Returns NULL on allocation failure.
+CompiledFilter *compile_filter(const Filter *filter);
+
+// Same result as until_valid, evaluated without recursion and with the
+// candidate's local time derived once rather than per node
+time_t until_valid_compiled(const CompiledFilter *compiled,
+                            const time_t candidate, const time_t duration,
+                            const Calendar *calendar);
+
+void free_compiled_filter(CompiledFilter *compiled);
+
+// Frees a Filter structure and its sub-filters. Nodes that belong to an
+// arena are skipped; they go with the arena.
 void destroy_filter(Filter *filter);
 
 #endif // FILTER_H
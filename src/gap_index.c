@@ -0,0 +1,318 @@
+#include "gap_index.h"
+#include <stdlib.h>
+
+static time_t later(const time_t a, const time_t b) { return a > b ? a : b; }
+
+// Recomputes a node's subtree aggregates from its children
+static void update_node(GapNode *node) {
+  node->first_start = node->left ? node->left->first_start : node->start;
+  node->last_end = node->right ? node->right->last_end : node->end;
+  time_t gap = node->gap_before;
+  if (node->left && node->left->max_gap > gap) {
+    gap = node->left->max_gap;
+  }
+  if (node->right && node->right->max_gap > gap) {
+    gap = node->right->max_gap;
+  }
+  node->max_gap = gap;
+}
+
+// Splits a subtree into the intervals starting before key and the rest
+static void split_nodes(GapNode *node, const time_t key, GapNode **before,
+                  GapNode **after) {
+  if (!node) {
+    *before = NULL;
+    *after = NULL;
+    return;
+  }
+  if (node->start < key) {
+    split_nodes(node->right, key, &node->right, after);
+    *before = node;
+  } else {
+    split_nodes(node->left, key, before, &node->left);
+    *after = node;
+  }
+  update_node(node);
+}
+
+// Joins two subtrees where every interval of a precedes those of b
+static GapNode *merge_nodes(GapNode *a, GapNode *b) {
+  if (!a) {
+    return b;
+  }
+  if (!b) {
+    return a;
+  }
+  if (a->priority > b->priority) {
+    a->right = merge_nodes(a->right, b);
+    update_node(a);
+    return a;
+  }
+  b->left = merge_nodes(a, b->left);
+  update_node(b);
+  return b;
+}
+
+static const GapNode *rightmost(const GapNode *node) {
+  while (node->right) {
+    node = node->right;
+  }
+  return node;
+}
+
+// Sets the gap of a subtree's first interval to follow `before`
+static void set_first_gap(GapNode *node, const GapNode *before) {
+  if (node->left) {
+    set_first_gap(node->left, before);
+  } else {
+    node->gap_before = before ? node->start - before->last_end : -1;
+  }
+  update_node(node);
+}
+
+static size_t free_nodes(GapNode *node) {
+  if (!node) {
+    return 0;
+  }
+  size_t count = 1 + free_nodes(node->left) + free_nodes(node->right);
+  free(node);
+  return count;
+}
+
+static unsigned next_priority(GapIndex *index) {
+  // xorshift32
+  unsigned x = index->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  index->seed = x;
+  return x;
+}
+
+GapIndex *create_gap_index(void) {
+  GapIndex *index = calloc(1, sizeof(GapIndex));
+  if (!index) {
+    return NULL;
+  }
+  index->seed = 2463534242u;
+  return index;
+}
+
+bool gap_index_add(GapIndex *index, time_t start, time_t end) {
+  if (!index) {
+    return false;
+  }
+  // Allocate first: once merging starts, the tree must not be left torn
+  GapNode *node = malloc(sizeof(GapNode));
+  if (!node) {
+    return false;
+  }
+  if (end < start) {
+    end = start;
+  }
+  GapNode *before;
+  GapNode *rest;
+  split_nodes(index->root, start, &before, &rest);
+  // Only the last interval before can reach into the new one
+  if (before && before->last_end > start) {
+    GapNode *last;
+    split_nodes(before, rightmost(before)->start, &before, &last);
+    start = last->start;
+    end = later(end, last->end);
+    index->count -= free_nodes(last);
+  }
+  // Intervals starting inside the new one (or with it) are absorbed
+  GapNode *inside;
+  GapNode *after;
+  split_nodes(rest, end > start ? end : start + 1, &inside, &after);
+  if (inside) {
+    end = later(end, inside->last_end);
+    index->count -= free_nodes(inside);
+  }
+
+  node->start = start;
+  node->end = end;
+  node->gap_before = before ? start - before->last_end : -1;
+  node->priority = next_priority(index);
+  node->left = NULL;
+  node->right = NULL;
+  update_node(node);
+  if (after) {
+    set_first_gap(after, node);
+  }
+  index->root = merge_nodes(merge_nodes(before, node), after);
+  index->count++;
+  return true;
+}
+
+bool gap_index_remove(GapIndex *index, const Calendar *calendar,
+                      const time_t start) {
+  if (!index || !calendar || !calendar->event_list) {
+    return false;
+  }
+  // The interval holding the event is the last one starting at or before it
+  GapNode *before;
+  GapNode *after;
+  split_nodes(index->root, start + 1, &before, &after);
+  if (!before) {
+    index->root = after; // Not indexed
+    return true;
+  }
+  GapNode *holder;
+  split_nodes(before, rightmost(before)->start, &before, &holder);
+  const time_t from = holder->start;
+  const time_t to = holder->end;
+  index->count -= free_nodes(holder);
+  if (after) {
+    set_first_gap(after, before);
+  }
+  index->root = merge_nodes(before, after);
+
+  // Rebuild that stretch from the events still in it
+  Event *event = get_event_on_or_before(calendar, from - 1);
+  if (!event) {
+    event = calendar->event_list->head;
+  }
+  while (event && event->start_time < from) {
+    event = event->next;
+  }
+  bool ok = true;
+  for (; ok && event && (event->start_time < to || event->start_time == from);
+       event = event->next) {
+    ok = gap_index_add(index, event->start_time, event->end_time);
+  }
+  return ok;
+}
+
+// First interval, in order, that starts after `after` and follows a gap of
+// at least `length`
+static const GapNode *first_gap(const GapNode *node, const time_t after,
+                                const time_t length) {
+  if (!node || node->max_gap < length) {
+    return NULL;
+  }
+  if (node->start > after) {
+    const GapNode *found = first_gap(node->left, after, length);
+    if (found) {
+      return found;
+    }
+    if (node->gap_before >= length) {
+      return node;
+    }
+  }
+  return first_gap(node->right, after, length);
+}
+
+time_t gap_index_next_free(const GapIndex *index, const time_t from,
+                           const time_t duration, const time_t pad) {
+  if (!index || !index->root) {
+    return from;
+  }
+  // The first interval whose padded end is still ahead blocks `from` if its
+  // padded start is too close; earlier ones are out of reach
+  const GapNode *blocking = NULL;
+  for (const GapNode *node = index->root; node;) {
+    if (node->end + pad > from) {
+      blocking = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  if (!blocking || from + duration + pad <= blocking->start) {
+    return from;
+  }
+  // Resume right after the first later gap that fits the event and padding
+  // on both sides, or after the last interval
+  const GapNode *next = first_gap(index->root, blocking->start,
+                                  duration + 2 * pad);
+  if (!next) {
+    return index->root->last_end + pad;
+  }
+  return next->start - next->gap_before + pad;
+}
+
+// Last interval, in order, that starts no later than `upto` and follows a
+// gap of at least `length`
+static const GapNode *last_gap(const GapNode *node, const time_t upto,
+                               const time_t length) {
+  if (!node || node->max_gap < length) {
+    return NULL;
+  }
+  if (node->start <= upto) {
+    const GapNode *found = last_gap(node->right, upto, length);
+    if (found) {
+      return found;
+    }
+    if (node->gap_before >= length) {
+      return node;
+    }
+  }
+  return last_gap(node->left, upto, length);
+}
+
+time_t gap_index_prev_free(const GapIndex *index, const time_t from,
+                           const time_t duration, const time_t pad) {
+  if (!index || !index->root) {
+    return from;
+  }
+  // The last interval whose padded start is before the padded end of the
+  // event blocks it if its padded end is too late; earlier ones end sooner
+  const GapNode *blocking = NULL;
+  for (const GapNode *node = index->root; node;) {
+    if (node->start < from + duration + pad) {
+      blocking = node;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  if (!blocking || from >= blocking->end + pad) {
+    return from;
+  }
+  // End the event a pad before the last earlier gap that fits it and its
+  // padding on both sides, or before the first interval
+  const GapNode *prev = last_gap(index->root, blocking->start,
+                                 duration + 2 * pad);
+  if (!prev) {
+    return index->root->first_start - pad - duration;
+  }
+  return prev->start - pad - duration;
+}
+
+GapIndex *calendar_gap_index(const Calendar *calendar) {
+  if (!calendar || !calendar->event_list) {
+    return NULL;
+  }
+  if (calendar->gaps) {
+    return calendar->gaps;
+  }
+  GapIndex *index = create_gap_index();
+  if (!index) {
+    return NULL;
+  }
+  for (Event *event = calendar->event_list->head; event;
+       event = event->next) {
+    if (!gap_index_add(index, event->start_time, event->end_time)) {
+      free_gap_index(index);
+      return NULL;
+    }
+  }
+  ((Calendar *)calendar)->gaps = index;
+  return index;
+}
+
+void invalidate_gap_index(Calendar *calendar) {
+  if (!calendar) {
+    return;
+  }
+  free_gap_index(calendar->gaps);
+  calendar->gaps = NULL;
+}
+
+void free_gap_index(GapIndex *index) {
+  if (!index)
+    return;
+  free_nodes(index->root);
+  free(index);
+}
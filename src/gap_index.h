@@ -0,0 +1,70 @@
+#ifndef GAP_INDEX_H
+#define GAP_INDEX_H
+
+#include "calendar.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Index of the free gaps between a calendar's busy intervals, used by the
+// `spaced` filter.
+//
+// Events are merged into disjoint busy intervals (overlapping events share
+// one), kept in a treap ordered by start. Each node stores the gap to the
+// interval before it, and every subtree the largest such gap, so the first
+// gap of at least a given length after a given time is found in O(log n)
+// instead of by walking the events in between. Adding an event merges
+// intervals in O(log n); removing one rebuilds only the interval it was in.
+
+// One busy interval [start, end) and the aggregates of its subtree
+typedef struct GapNode {
+  time_t start;
+  time_t end;
+  time_t gap_before; // start minus the previous interval's end, -1 if first
+  unsigned priority;
+  struct GapNode *left;
+  struct GapNode *right;
+  time_t first_start; // of the leftmost interval in the subtree
+  time_t last_end;    // of the rightmost interval in the subtree
+  time_t max_gap;     // largest gap_before in the subtree
+} GapNode;
+
+typedef struct GapIndex {
+  GapNode *root;
+  size_t count; // busy intervals
+  unsigned seed;
+} GapIndex;
+
+GapIndex *create_gap_index(void);
+
+// Marks [start, end) busy, merging it with the intervals it overlaps.
+// Returns false on allocation failure.
+bool gap_index_add(GapIndex *index, const time_t start, const time_t end);
+
+// Updates the index after an event starting at `start` was removed from the
+// calendar: the busy interval it belonged to is rebuilt from the calendar's
+// remaining events. Returns false on allocation failure.
+bool gap_index_remove(GapIndex *index, const Calendar *calendar,
+                      const time_t start);
+
+// Returns the earliest time >= from at which an event of `duration` keeps
+// at least `pad` seconds (pad >= 0) away from every busy interval
+time_t gap_index_next_free(const GapIndex *index, const time_t from,
+                           const time_t duration, const time_t pad);
+
+// Returns the latest time <= from at which an event of `duration` keeps at
+// least `pad` seconds (pad >= 0) away from every busy interval
+time_t gap_index_prev_free(const GapIndex *index, const time_t from,
+                           const time_t duration, const time_t pad);
+
+// Returns the calendar's index, building it from the resident events on
+// first use (a cache fill, like decoding archives). NULL if that fails.
+GapIndex *calendar_gap_index(const Calendar *calendar);
+
+// Drops the calendar's index, to be rebuilt on next use. For bulk changes
+// that are cheaper to index from scratch.
+void invalidate_gap_index(Calendar *calendar);
+
+void free_gap_index(GapIndex *index);
+
+#endif // GAP_INDEX_H
@@ -0,0 +1,307 @@
+#include "holiday.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const HolidayRule default_rules[] = {
+    {HOLIDAY_DATE, 1, 1, 0, 0, false},   // New Year's Day
+    {HOLIDAY_DATE, 7, 4, 0, 0, false},   // Independence Day
+    {HOLIDAY_DATE, 12, 25, 0, 0, false}, // Christmas Day
+    {HOLIDAY_DATE, 12, 31, 0, 0, false}, // New Year's Eve
+};
+#define DEFAULT_RULE_COUNT (sizeof(default_rules) / sizeof(default_rules[0]))
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static long day_number(int y, const int m, const int d) {
+  y -= m <= 2;
+  const long era = (y >= 0 ? y : y - 399) / 400;
+  const long yoe = y - era * 400;
+  const long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Day of the week of a day number, 0 = Sunday (1970-01-01 was a Thursday)
+static int day_weekday(const long day) {
+  return (int)(((day + 4) % 7 + 7) % 7);
+}
+
+static long first_of_next_month(const int year, const int month) {
+  return month == 12 ? day_number(year + 1, 1, 1)
+                     : day_number(year, month + 1, 1);
+}
+
+// Returns the day a rule falls on in `year`, or -1 if it does not exist
+// there (e.g. a fifth Monday)
+static long rule_day(const HolidayRule *rule, const int year) {
+  const long first = day_number(year, rule->month, 1);
+  const long next_month = first_of_next_month(year, rule->month);
+  long day;
+  if (rule->type == HOLIDAY_DATE) {
+    day = first + rule->day - 1;
+    if (rule->day < 1 || day >= next_month) {
+      return -1;
+    }
+    if (rule->observed) {
+      int weekday = day_weekday(day);
+      day += weekday == 6 ? -1 : weekday == 0 ? 1 : 0;
+    }
+    return day;
+  }
+  if (rule->nth < 0) {
+    long last = next_month - 1;
+    return last - (day_weekday(last) - rule->weekday + 7) % 7;
+  }
+  day = first + (rule->weekday - day_weekday(first) + 7) % 7 +
+        7 * (rule->nth - 1);
+  return day < next_month ? day : -1;
+}
+
+static int compare_days(const void *a, const void *b) {
+  long x = *(const long *)a;
+  long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+// Writes the sorted, distinct holidays of `year` to out (room for three
+// per rule: observed days can cross into the neighbouring years) and
+// returns how many there are
+static size_t expand_year(const HolidayRule *rules, const size_t count,
+                          const int year, long *out) {
+  const long start = day_number(year, 1, 1);
+  const long end = day_number(year + 1, 1, 1);
+  size_t n = 0;
+  for (int y = year - 1; y <= year + 1; y++) {
+    for (size_t i = 0; i < count; i++) {
+      long day = rule_day(&rules[i], y);
+      if (day >= start && day < end) {
+        out[n++] = day;
+      }
+    }
+  }
+  qsort(out, n, sizeof(long), compare_days);
+  size_t distinct = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (distinct == 0 || out[distinct - 1] != out[i]) {
+      out[distinct++] = out[i];
+    }
+  }
+  return distinct;
+}
+
+// Returns the holiday table of a year: from the calendar's cache, filling it
+// on first use, or expanded into `scratch` (room for the default rules) when
+// the built-in set is in use
+static const long *holiday_days(const Calendar *calendar, const int year,
+                                size_t *count, long *scratch) {
+  HolidaySet *set = calendar ? calendar->holidays : NULL;
+  if (!set) {
+    *count = expand_year(default_rules, DEFAULT_RULE_COUNT, year, scratch);
+    return scratch;
+  }
+  for (HolidayYear *y = set->years; y; y = y->next) {
+    if (y->year == year) {
+      *count = y->count;
+      return y->days;
+    }
+  }
+  *count = 0;
+  HolidayYear *entry = malloc(sizeof(HolidayYear));
+  long *days = malloc((3 * set->rule_count + 1) * sizeof(long));
+  if (!entry || !days) {
+    free(entry);
+    free(days);
+    return NULL;
+  }
+  entry->year = year;
+  entry->days = days;
+  entry->count = expand_year(set->rules, set->rule_count, year, days);
+  entry->next = set->years;
+  set->years = entry;
+  *count = entry->count;
+  return entry->days;
+}
+
+// Index of the first entry >= day
+static size_t lower_bound(const long *days, const size_t count,
+                          const long day) {
+  size_t lo = 0;
+  size_t hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (days[mid] < day) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool is_holiday(const Calendar *calendar, const struct tm *date) {
+  long scratch[3 * DEFAULT_RULE_COUNT];
+  const int year = date->tm_year + 1900;
+  const long today = day_number(year, date->tm_mon + 1, date->tm_mday);
+  size_t count;
+  const long *days = holiday_days(calendar, year, &count, scratch);
+  if (!days) {
+    return false;
+  }
+  size_t i = lower_bound(days, count, today);
+  return i < count && days[i] == today;
+}
+
+// Whether the calendar's set has no rules at all
+static bool no_holiday_rules(const Calendar *calendar) {
+  return calendar && calendar->holidays &&
+         calendar->holidays->rule_count == 0;
+}
+
+long days_until_holiday(const Calendar *calendar, const struct tm *date) {
+  long scratch[3 * DEFAULT_RULE_COUNT];
+  const int year = date->tm_year + 1900;
+  const long today = day_number(year, date->tm_mon + 1, date->tm_mday);
+  if (no_holiday_rules(calendar)) {
+    return -1;
+  }
+  for (int y = year; y <= year + HOLIDAY_SCAN_YEARS; y++) {
+    size_t count;
+    const long *days = holiday_days(calendar, y, &count, scratch);
+    if (!days) {
+      return -1;
+    }
+    size_t i = lower_bound(days, count, today);
+    if (i < count) {
+      return days[i] - today;
+    }
+  }
+  return -1;
+}
+
+long days_since_holiday(const Calendar *calendar, const struct tm *date) {
+  long scratch[3 * DEFAULT_RULE_COUNT];
+  const int year = date->tm_year + 1900;
+  const long today = day_number(year, date->tm_mon + 1, date->tm_mday);
+  if (no_holiday_rules(calendar)) {
+    return -1;
+  }
+  for (int y = year; y >= year - HOLIDAY_SCAN_YEARS; y--) {
+    size_t count;
+    const long *days = holiday_days(calendar, y, &count, scratch);
+    if (!days) {
+      return -1;
+    }
+    size_t i = lower_bound(days, count, today + 1);
+    if (i > 0) {
+      return today - days[i - 1];
+    }
+  }
+  return -1;
+}
+
+void prepare_holiday_years(const Calendar *calendar, const int first,
+                           const int last) {
+  if (!calendar || !calendar->holidays) {
+    return; // The built-in set is expanded on the stack every time
+  }
+  for (int year = first; year <= last; year++) {
+    size_t count;
+    holiday_days(calendar, year, &count, NULL);
+  }
+}
+
+// Parses one rule line. Returns false if it is malformed.
+static bool parse_rule(const char *line, HolidayRule *rule) {
+  char kind[8];
+  char flag[16] = "";
+  memset(rule, 0, sizeof(HolidayRule));
+  if (sscanf(line, "%7s", kind) != 1) {
+    return false;
+  }
+  if (strcmp(kind, "date") == 0) {
+    rule->type = HOLIDAY_DATE;
+    if (sscanf(line, "%*s %d %d %15s", &rule->month, &rule->day, flag) < 2) {
+      return false;
+    }
+    rule->observed = strcmp(flag, "observed") == 0;
+  } else if (strcmp(kind, "nth") == 0) {
+    rule->type = HOLIDAY_NTH_WEEKDAY;
+    if (sscanf(line, "%*s %d %d %d", &rule->month, &rule->weekday,
+               &rule->nth) != 3) {
+      return false;
+    }
+    if (rule->weekday < 0 || rule->weekday > 6 || rule->nth == 0 ||
+        rule->nth < -1 || rule->nth > 5) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  return rule->month >= 1 && rule->month <= 12;
+}
+
+HolidaySet *load_holidays(const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    return NULL;
+  }
+  HolidaySet *set = calloc(1, sizeof(HolidaySet));
+  size_t capacity = 0;
+  char line[256];
+  bool ok = set != NULL;
+  while (ok && fgets(line, sizeof(line), file)) {
+    const char *p = line;
+    while (*p == ' ' || *p == '\t') {
+      p++;
+    }
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+      continue;
+    }
+    if (set->rule_count == capacity) {
+      capacity = capacity ? capacity * 2 : 16;
+      HolidayRule *rules =
+          realloc(set->rules, capacity * sizeof(HolidayRule));
+      if (!rules) {
+        ok = false;
+        break;
+      }
+      set->rules = rules;
+    }
+    ok = parse_rule(p, &set->rules[set->rule_count]);
+    set->rule_count += ok;
+  }
+  fclose(file);
+  if (!ok) {
+    free_holidays(set);
+    return NULL;
+  }
+  return set;
+}
+
+bool load_calendar_holidays(Calendar *calendar, const char *filename) {
+  if (!calendar) {
+    return false;
+  }
+  HolidaySet *set = load_holidays(filename);
+  if (!set) {
+    return false;
+  }
+  free_holidays(calendar->holidays);
+  calendar->holidays = set;
+  calendar->holiday_generation++;
+  return true;
+}
+
+void free_holidays(HolidaySet *set) {
+  if (!set)
+    return;
+  HolidayYear *year = set->years;
+  while (year) {
+    HolidayYear *next = year->next;
+    free(year->days);
+    free(year);
+    year = next;
+  }
+  free(set->rules);
+  free(set);
+}
@@ -0,0 +1,88 @@
+#ifndef HOLIDAY_H
+#define HOLIDAY_H
+
+#include "calendar.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Holiday sets used by the `holidays` filter.
+//
+// A set is a list of rules read from a text file, one per line:
+//
+//   date <month> <day> [observed] [name...]
+//   nth <month> <weekday> <n> [name...]
+//
+// Months are 1-12, weekdays 0-6 (Sunday is 0) and n is 1-5, or -1 for the
+// last such weekday of the month. An `observed` date that falls on a
+// Saturday is taken on the Friday before and one on a Sunday on the Monday
+// after. Blank lines and lines starting with `#` are ignored.
+//
+// Each year is expanded once into a sorted table of day numbers (days since
+// 1970-01-01) that is cached with the set, so lookups are binary searches
+// with no libc time calls. Without a loaded set, the built-in fixed dates
+// are used: New Year's Day, Independence Day, Christmas Day and New Year's
+// Eve.
+
+// Years days_until_holiday and days_since_holiday look through. Some rules
+// match in some years only (a fifth weekday of a month, or February 29th on
+// a given weekday); within a century dates fall on the same weekdays again
+// every 28 years.
+#define HOLIDAY_SCAN_YEARS 28
+
+typedef enum { HOLIDAY_DATE, HOLIDAY_NTH_WEEKDAY } HolidayRuleType;
+
+typedef struct HolidayRule {
+  HolidayRuleType type;
+  int month;
+  int day;     // HOLIDAY_DATE
+  int weekday; // HOLIDAY_NTH_WEEKDAY
+  int nth;     // HOLIDAY_NTH_WEEKDAY
+  bool observed;
+} HolidayRule;
+
+// The holidays of one year as sorted day numbers
+typedef struct HolidayYear {
+  int year;
+  long *days;
+  size_t count;
+  struct HolidayYear *next;
+} HolidayYear;
+
+typedef struct HolidaySet {
+  HolidayRule *rules;
+  size_t rule_count;
+  HolidayYear *years; // expanded years, most recently added first
+} HolidaySet;
+
+// Reads a holiday set from a file. Returns NULL if the file cannot be read
+// or a line is malformed.
+HolidaySet *load_holidays(const char *filename);
+
+// Replaces the calendar's holiday set with the one in the file.
+// Returns false, keeping the current set, if it cannot be loaded.
+bool load_calendar_holidays(Calendar *calendar, const char *filename);
+
+// Returns true if the local date is a holiday of the calendar's set
+bool is_holiday(const Calendar *calendar, const struct tm *date);
+
+// Returns the number of days from the local date to the next holiday of the
+// calendar's set (0 if it is one), or -1 if the set has none in the next
+// 28 years.
+long days_until_holiday(const Calendar *calendar, const struct tm *date);
+
+// Returns the number of days from the last holiday of the calendar's set to
+// the local date (0 if it is one), or -1 if the set has none in the last
+// 28 years.
+long days_since_holiday(const Calendar *calendar, const struct tm *date);
+
+// Expands the years first..last of the calendar's set ahead of time. Lookups
+// that only reach those years then only read the set, so they are safe to
+// run from several threads at once; days_until_holiday and
+// days_since_holiday reach HOLIDAY_SCAN_YEARS past the date's year.
+void prepare_holiday_years(const Calendar *calendar, const int first,
+                           const int last);
+
+void free_holidays(HolidaySet *set);
+
+#endif // HOLIDAY_H
@@ -0,0 +1,477 @@
+#include "ics.h"
+#include "archive.h"
+#include "calendar.h"
+#include "event_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICS_BUFFER_SIZE 65536
+#define ICS_LINE_MAX 8192 // longer unfolded lines are truncated
+#define ICS_FOLD_WIDTH 75 // octets per physical line when writing
+
+typedef struct {
+  FILE *file;
+  size_t pos;
+  size_t len;
+  bool error;
+  char buf[ICS_BUFFER_SIZE];
+} IcsReader;
+
+static bool ics_fill(IcsReader *r) {
+  if (r->pos < r->len) {
+    return true;
+  }
+  r->len = fread(r->buf, 1, sizeof(r->buf), r->file);
+  r->pos = 0;
+  if (r->len == 0 && ferror(r->file)) {
+    r->error = true;
+  }
+  return r->len > 0;
+}
+
+static int ics_getc(IcsReader *r) {
+  return ics_fill(r) ? (unsigned char)r->buf[r->pos++] : EOF;
+}
+
+static int ics_peekc(IcsReader *r) {
+  return ics_fill(r) ? (unsigned char)r->buf[r->pos] : EOF;
+}
+
+// Reads one logical line, joining folded continuation lines (a line break
+// followed by a space or tab). Returns false at end of input.
+static bool ics_read_line(IcsReader *r, char *line, const size_t cap) {
+  size_t n = 0;
+  bool any = false;
+  int c;
+  while ((c = ics_getc(r)) != EOF) {
+    any = true;
+    if (c == '\r') {
+      continue;
+    }
+    if (c == '\n') {
+      int next = ics_peekc(r);
+      if (next == ' ' || next == '\t') {
+        ics_getc(r); // Folded: drop the break and the leading whitespace
+        continue;
+      }
+      break;
+    }
+    if (n + 1 < cap) {
+      line[n++] = (char)c;
+    }
+  }
+  line[n] = '\0';
+  return any;
+}
+
+static bool ics_equals(const char *a, const char *b) {
+  for (; *a && *b; a++, b++) {
+    char ca = (*a >= 'a' && *a <= 'z') ? *a - 'a' + 'A' : *a;
+    char cb = (*b >= 'a' && *b <= 'z') ? *b - 'a' + 'A' : *b;
+    if (ca != cb) {
+      return false;
+    }
+  }
+  return *a == *b;
+}
+
+// Splits `NAME;PARAM=...:VALUE` in place. Quoted parameter values may
+// contain ':'. Returns false if the line has no value.
+static bool split_property(char *line, char **name, char **value) {
+  *name = line;
+  char *p = line;
+  while (*p && *p != ';' && *p != ':') {
+    p++;
+  }
+  bool quoted = false;
+  for (char *q = p; *q; q++) {
+    if (*q == '"') {
+      quoted = !quoted;
+    } else if (*q == ':' && !quoted) {
+      *p = '\0'; // Terminates the name; parameters are not needed
+      *value = q + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static long long days_from_civil(int y, const int m, const int d) {
+  y -= m <= 2;
+  const long long era = (y >= 0 ? y : y - 399) / 400;
+  const long long yoe = y - era * 400;
+  const long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Parses DATE (YYYYMMDD) or DATE-TIME (YYYYMMDDTHHMMSS[Z]) values
+static bool parse_ics_time(const char *value, time_t *out, bool *is_date) {
+  int y, mo, d, h = 0, mi = 0, s = 0;
+  if (strlen(value) < 8 || sscanf(value, "%4d%2d%2d", &y, &mo, &d) != 3) {
+    return false;
+  }
+  *is_date = value[8] != 'T';
+  if (!*is_date && sscanf(value + 9, "%2d%2d%2d", &h, &mi, &s) != 3) {
+    return false;
+  }
+  if (!*is_date && value[15] == 'Z') {
+    long long days = days_from_civil(y, mo, d);
+    *out = (time_t)(days * 86400 + h * 3600 + mi * 60 + s);
+    return true;
+  }
+  struct tm local = {0};
+  local.tm_year = y - 1900;
+  local.tm_mon = mo - 1;
+  local.tm_mday = d;
+  local.tm_hour = h;
+  local.tm_min = mi;
+  local.tm_sec = s;
+  local.tm_isdst = -1;
+  *out = mktime(&local);
+  return true;
+}
+
+// Parses a DURATION value such as P1W, PT1H30M or -P1DT12H into seconds
+static bool parse_ics_duration(const char *value, time_t *out) {
+  long sign = 1;
+  if (*value == '+' || *value == '-') {
+    sign = *value == '-' ? -1 : 1;
+    value++;
+  }
+  if (*value++ != 'P') {
+    return false;
+  }
+  long total = 0;
+  bool in_time = false;
+  while (*value) {
+    if (*value == 'T') {
+      in_time = true;
+      value++;
+      continue;
+    }
+    char *end;
+    long n = strtol(value, &end, 10);
+    if (end == value) {
+      return false;
+    }
+    switch (*end) {
+    case 'W':
+      total += n * 7 * 86400;
+      break;
+    case 'D':
+      total += n * 86400;
+      break;
+    case 'H':
+      total += n * 3600;
+      break;
+    case 'M':
+      total += in_time ? n * 60 : 0;
+      break;
+    case 'S':
+      total += n;
+      break;
+    default:
+      return false;
+    }
+    value = end + 1;
+  }
+  *out = sign * total;
+  return true;
+}
+
+// Copies a TEXT value, resolving \n, \, \; and \\ escapes
+static void unescape_text(char *dst, const size_t cap, const char *src) {
+  size_t n = 0;
+  for (; *src && n + 1 < cap; src++) {
+    char c = *src;
+    if (c == '\\' && src[1]) {
+      src++;
+      c = (*src == 'n' || *src == 'N') ? '\n' : *src;
+    }
+    dst[n++] = c;
+  }
+  dst[n] = '\0';
+}
+
+typedef struct {
+  IcsEvent event;
+  bool has_start;
+  bool has_end;
+  bool has_duration;
+  bool start_is_date;
+  time_t duration;
+  int nested; // depth of sub-components such as VALARM
+} IcsEventState;
+
+static bool finish_event(IcsEventState *state, IcsEventHandler handler,
+                         void *context) {
+  IcsEvent *event = &state->event;
+  if (state->has_duration && !state->has_end) {
+    event->end = event->start + state->duration;
+  } else if (!state->has_end && state->start_is_date) {
+    struct tm next_day = *localtime(&event->start);
+    next_day.tm_mday += 1;
+    next_day.tm_isdst = -1;
+    event->end = mktime(&next_day);
+  } else if (!state->has_end) {
+    event->end = event->start;
+  }
+  return handler(event, context);
+}
+
+static void apply_property(IcsEventState *state, const char *name,
+                           const char *value) {
+  IcsEvent *event = &state->event;
+  bool is_date;
+  if (ics_equals(name, "SUMMARY")) {
+    unescape_text(event->summary, sizeof(event->summary), value);
+  } else if (ics_equals(name, "DESCRIPTION")) {
+    unescape_text(event->description, sizeof(event->description), value);
+  } else if (ics_equals(name, "UID")) {
+    unescape_text(event->uid, sizeof(event->uid), value);
+  } else if (ics_equals(name, "DTSTART")) {
+    state->has_start = parse_ics_time(value, &event->start, &is_date);
+    state->start_is_date = is_date;
+  } else if (ics_equals(name, "DTEND")) {
+    state->has_end = parse_ics_time(value, &event->end, &is_date);
+  } else if (ics_equals(name, "DURATION")) {
+    state->has_duration = parse_ics_duration(value, &state->duration);
+  }
+}
+
+long read_ics_events(FILE *file, IcsEventHandler handler, void *context) {
+  if (!file || !handler) {
+    return -1;
+  }
+  IcsReader *reader = malloc(sizeof(IcsReader));
+  char *line = malloc(ICS_LINE_MAX);
+  IcsEventState *state = malloc(sizeof(IcsEventState));
+  if (!reader || !line || !state) {
+    free(reader);
+    free(line);
+    free(state);
+    return -1;
+  }
+  reader->file = file;
+  reader->pos = reader->len = 0;
+  reader->error = false;
+
+  long count = 0;
+  bool in_event = false;
+  while (ics_read_line(reader, line, ICS_LINE_MAX)) {
+    char *name, *value;
+    if (!split_property(line, &name, &value)) {
+      continue;
+    }
+    if (ics_equals(name, "BEGIN")) {
+      if (in_event) {
+        state->nested++;
+      } else if (ics_equals(value, "VEVENT")) {
+        memset(state, 0, sizeof(*state));
+        in_event = true;
+      }
+    } else if (ics_equals(name, "END")) {
+      if (!in_event) {
+        continue;
+      }
+      if (state->nested > 0) {
+        state->nested--;
+      } else if (ics_equals(value, "VEVENT")) {
+        in_event = false;
+        if (!state->has_start) {
+          continue; // DTSTART is required
+        }
+        if (!finish_event(state, handler, context)) {
+          break;
+        }
+        count++;
+      }
+    } else if (in_event && state->nested == 0) {
+      apply_property(state, name, value);
+    }
+  }
+
+  bool error = reader->error;
+  free(reader);
+  free(line);
+  free(state);
+  return error ? -1 : count;
+}
+
+typedef struct {
+  Calendar *calendar;
+  Event *head;
+  Event *tail;
+  bool sorted;
+  unsigned last_year;
+  bool failed; // an event could not be allocated
+} IcsImport;
+
+// The storage format is line and '|' delimited
+static void sanitize_field(char *s) {
+  for (; *s; s++) {
+    if (*s == '\n' || *s == '\r') {
+      *s = ' ';
+    } else if (*s == '|') {
+      *s = '/';
+    }
+  }
+}
+
+static bool import_event(const IcsEvent *ics, void *context) {
+  IcsImport *import = context;
+  Event *event = make_event(import->calendar->event_list, ics->summary,
+                            ics->description, ics->start, ics->end);
+  if (!event) {
+    import->failed = true;
+    return false;
+  }
+  sanitize_field(event->title);
+  sanitize_field(event->description);
+
+  // Archived years must be resident before they gain events
+  struct tm *tm_start = localtime(&event->start_time);
+  if (tm_start && (unsigned)tm_start->tm_year + 1900 != import->last_year) {
+    import->last_year = tm_start->tm_year + 1900;
+    ensure_year_loaded(import->calendar, import->last_year);
+  }
+
+  if (import->tail) {
+    if (event->start_time < import->tail->start_time) {
+      import->sorted = false;
+    }
+    import->tail->next = event;
+  } else {
+    import->head = event;
+  }
+  event->parent = import->tail;
+  import->tail = event;
+  return true;
+}
+
+long import_ics(Calendar *calendar, const char *filename) {
+  if (!calendar || !calendar->event_list || !filename) {
+    return -1;
+  }
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return -1;
+  }
+  IcsImport import = {calendar, NULL, NULL, true, 0, false};
+  long count = read_ics_events(file, import_event, &import);
+  fclose(file);
+  if (count == -1 || import.failed) {
+    // Nothing of a file that could not be read in full is added
+    free_event_chain(import.head);
+    return -1;
+  }
+
+  // Feeds are usually in order; only pay for a sort when they are not
+  Event *chain = import.sorted ? import.head : sort_event_chain(import.head);
+  attach_calendar_events(calendar, chain);
+  calendar->generation++;
+  return count;
+}
+
+typedef struct {
+  FILE *file;
+  size_t column;
+} IcsWriter;
+
+static void ics_put(IcsWriter *w, const char *s, size_t n) {
+  for (; n > 0; s++, n--) {
+    // Fold long lines, never inside a UTF-8 sequence
+    bool continuation = ((unsigned char)*s & 0xc0) == 0x80;
+    if (w->column >= ICS_FOLD_WIDTH && !continuation) {
+      fputs("\r\n ", w->file);
+      w->column = 1;
+    }
+    putc(*s, w->file);
+    w->column++;
+  }
+}
+
+static void ics_put_str(IcsWriter *w, const char *s) {
+  ics_put(w, s, strlen(s));
+}
+
+static void ics_end_line(IcsWriter *w) {
+  fputs("\r\n", w->file);
+  w->column = 0;
+}
+
+static void ics_put_line(IcsWriter *w, const char *line) {
+  ics_put_str(w, line);
+  ics_end_line(w);
+}
+
+// Writes a TEXT value with `\`, `;`, `,` and newlines escaped
+static void ics_put_text(IcsWriter *w, const char *text) {
+  for (; *text; text++) {
+    switch (*text) {
+    case '\\':
+    case ';':
+    case ',':
+      ics_put(w, "\\", 1);
+      ics_put(w, text, 1);
+      break;
+    case '\n':
+      ics_put(w, "\\n", 2);
+      break;
+    default:
+      ics_put(w, text, 1);
+    }
+  }
+}
+
+static void ics_put_utc(IcsWriter *w, const time_t t) {
+  char buf[32];
+  strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", gmtime(&t));
+  ics_put_str(w, buf);
+}
+
+bool export_ics(const Calendar *calendar, const char *filename) {
+  if (!calendar || !calendar->event_list || !filename) {
+    return false;
+  }
+  load_all_archives(calendar);
+  FILE *file = fopen(filename, "wb");
+  if (!file) {
+    return false;
+  }
+  IcsWriter w = {file, 0};
+  const time_t now = time(NULL);
+  ics_put_line(&w, "BEGIN:VCALENDAR");
+  ics_put_line(&w, "VERSION:2.0");
+  ics_put_line(&w, "PRODID:-//cal-manager//EN");
+  for (Event *e = calendar->event_list->head; e; e = e->next) {
+    char uid[64];
+    snprintf(uid, sizeof(uid), "UID:%u@cal-manager", e->id);
+    ics_put_line(&w, "BEGIN:VEVENT");
+    ics_put_line(&w, uid);
+    ics_put_str(&w, "DTSTAMP:");
+    ics_put_utc(&w, now);
+    ics_end_line(&w);
+    ics_put_str(&w, "DTSTART:");
+    ics_put_utc(&w, e->start_time);
+    ics_end_line(&w);
+    ics_put_str(&w, "DTEND:");
+    ics_put_utc(&w, e->end_time);
+    ics_end_line(&w);
+    ics_put_str(&w, "SUMMARY:");
+    ics_put_text(&w, e->title);
+    ics_end_line(&w);
+    if (e->description[0]) {
+      ics_put_str(&w, "DESCRIPTION:");
+      ics_put_text(&w, e->description);
+      ics_end_line(&w);
+    }
+    ics_put_line(&w, "END:VEVENT");
+  }
+  ics_put_line(&w, "END:VCALENDAR");
+  bool ok = !ferror(file);
+  return (fclose(file) == 0) && ok;
+}
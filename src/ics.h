@@ -0,0 +1,43 @@
+#ifndef ICS_H
+#define ICS_H
+
+#include "calendar.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+// Streaming iCalendar (RFC 5545) VEVENT reader and writer.
+//
+// The reader unfolds continuation lines on the fly from a fixed read buffer
+// and decodes each VEVENT's properties straight into fixed-size fields, so
+// memory use does not depend on the size of the feed. Nested components
+// (e.g. VALARM) are skipped. Understood properties: UID, SUMMARY,
+// DESCRIPTION, DTSTART, DTEND and DURATION. Times ending in `Z` are UTC;
+// floating times and TZID parameters are read as local time. DATE values
+// are all-day events from local midnight.
+
+// One VEVENT as decoded from a feed. Only valid during the handler call.
+typedef struct IcsEvent {
+  char uid[256];
+  char summary[256];      // same capacity as Event.title
+  char description[1024]; // same capacity as Event.description
+  time_t start;
+  time_t end;
+} IcsEvent;
+
+// Called for each complete VEVENT. Return false to stop reading.
+typedef bool (*IcsEventHandler)(const IcsEvent *event, void *context);
+
+// Streams every VEVENT of an open file to the handler.
+// Returns the number of events the handler accepted, or -1 on a read error.
+long read_ics_events(FILE *file, IcsEventHandler handler, void *context);
+
+// Imports all VEVENTs of a file into the calendar in one bulk insert.
+// Returns the number of events added, or -1 if the file cannot be read in
+// full, in which case none of its events are added.
+long import_ics(Calendar *calendar, const char *filename);
+
+// Writes every event of the calendar as a VCALENDAR of VEVENTs with UTC times
+bool export_ics(const Calendar *calendar, const char *filename);
+
+#endif // ICS_H
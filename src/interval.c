@@ -0,0 +1,347 @@
+#include "interval.h"
+#include "archive.h"
+#include "calendar.h"
+#include "holiday.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Local days covering the horizon: day i spans [starts[i], starts[i + 1])
+// and its date fields are in dates[i]
+typedef struct {
+  time_t from;
+  time_t to;
+  time_t duration;
+  const Calendar *calendar;
+  time_t *starts;
+  struct tm *dates;
+  size_t days;
+} IntervalContext;
+
+static bool build_days(IntervalContext *ctx) {
+  struct tm *tm_from = localtime(&ctx->from);
+  if (!tm_from) {
+    return false;
+  }
+  struct tm day = *tm_from;
+  day.tm_hour = 0;
+  day.tm_min = 0;
+  day.tm_sec = 0;
+  day.tm_isdst = -1;
+  time_t start = mktime(&day);
+
+  size_t capacity = 8;
+  ctx->starts = malloc((capacity + 1) * sizeof(time_t));
+  ctx->dates = malloc(capacity * sizeof(struct tm));
+  ctx->days = 0;
+  while (ctx->starts && ctx->dates) {
+    if (ctx->days == capacity) {
+      capacity *= 2;
+      time_t *starts = realloc(ctx->starts, (capacity + 1) * sizeof(time_t));
+      if (starts) {
+        ctx->starts = starts;
+      }
+      struct tm *dates = realloc(ctx->dates, capacity * sizeof(struct tm));
+      if (dates) {
+        ctx->dates = dates;
+      }
+      if (!starts || !dates) {
+        break;
+      }
+    }
+    ctx->starts[ctx->days] = start;
+    if (start >= ctx->to) {
+      return true; // The closing boundary of the last day
+    }
+    ctx->dates[ctx->days++] = day;
+    day.tm_mday++;
+    day.tm_isdst = -1;
+    start = mktime(&day);
+  }
+  free(ctx->starts);
+  free(ctx->dates);
+  ctx->starts = NULL;
+  ctx->dates = NULL;
+  return false;
+}
+
+// Appends [start, end) clipped to the horizon, merging it with the last
+// interval if they touch. Intervals must arrive sorted by start.
+static bool push_interval(IntervalSet *set, const IntervalContext *ctx,
+                          time_t start, time_t end) {
+  if (start < ctx->from) {
+    start = ctx->from;
+  }
+  if (end > ctx->to) {
+    end = ctx->to;
+  }
+  if (start >= end) {
+    return true;
+  }
+  if (set->count > 0 && start <= set->items[set->count - 1].end) {
+    Interval *last = &set->items[set->count - 1];
+    if (end > last->end) {
+      last->end = end;
+    }
+    return true;
+  }
+  if (set->count == set->capacity) {
+    size_t capacity = set->capacity ? set->capacity * 2 : 16;
+    Interval *items = realloc(set->items, capacity * sizeof(Interval));
+    if (!items) {
+      return false;
+    }
+    set->items = items;
+    set->capacity = capacity;
+  }
+  set->items[set->count].start = start;
+  set->items[set->count].end = end;
+  set->count++;
+  return true;
+}
+
+static bool unite(const IntervalSet *a, const IntervalSet *b,
+                  const IntervalContext *ctx, IntervalSet *out) {
+  size_t i = 0;
+  size_t j = 0;
+  bool ok = true;
+  while (ok && (i < a->count || j < b->count)) {
+    const Interval *next;
+    if (j == b->count ||
+        (i < a->count && a->items[i].start <= b->items[j].start)) {
+      next = &a->items[i++];
+    } else {
+      next = &b->items[j++];
+    }
+    ok = push_interval(out, ctx, next->start, next->end);
+  }
+  return ok;
+}
+
+static bool intersect(const IntervalSet *a, const IntervalSet *b,
+                      const IntervalContext *ctx, IntervalSet *out) {
+  size_t i = 0;
+  size_t j = 0;
+  bool ok = true;
+  while (ok && i < a->count && j < b->count) {
+    const Interval *x = &a->items[i];
+    const Interval *y = &b->items[j];
+    time_t start = x->start > y->start ? x->start : y->start;
+    time_t end = x->end < y->end ? x->end : y->end;
+    if (start < end) {
+      ok = push_interval(out, ctx, start, end);
+    }
+    // Drop whichever interval ends first
+    if (x->end < y->end) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+  return ok;
+}
+
+static bool complement(const IntervalSet *a, const IntervalContext *ctx,
+                       IntervalSet *out) {
+  time_t cursor = ctx->from;
+  bool ok = true;
+  for (size_t i = 0; ok && i < a->count; i++) {
+    ok = push_interval(out, ctx, cursor, a->items[i].start);
+    cursor = a->items[i].end;
+  }
+  return ok && push_interval(out, ctx, cursor, ctx->to);
+}
+
+static bool day_matches(const Filter *filter, const IntervalContext *ctx,
+                        const struct tm *date) {
+  switch (filter->type) {
+  case FILTER_DAY_OF_WEEK:
+    return date->tm_wday == filter->data.day_of_week;
+  case FILTER_DAY_MASK:
+    return (filter->data.day_mask >> date->tm_wday) & 1;
+  case FILTER_MONTH_MASK:
+    return (filter->data.month_mask >> date->tm_mon) & 1;
+  case FILTER_MONTH_DAYS:
+    return (filter->data.month_days & ~1u) >> date->tm_mday & 1;
+  case FILTER_NTH_WEEKDAY: {
+    if (date->tm_wday != filter->data.nth.day_of_week) {
+      return false;
+    }
+    if (filter->data.nth.week < 0) {
+      return date->tm_mday + 7 >
+             (int)days_in_month((unsigned)date->tm_mon + 1,
+                                (unsigned)date->tm_year + 1900);
+    }
+    return (date->tm_mday - 1) / 7 + 1 == filter->data.nth.week;
+  }
+  default: // FILTER_HOLIDAY
+    return is_holiday(ctx->calendar, date);
+  }
+}
+
+// Time `seconds` past midnight by the wall clock on day i, which is not
+// that long after the midnight itself when the clock changes that day
+static time_t wall_time_on(const IntervalContext *ctx, const size_t i,
+                           const time_t seconds) {
+  if (ctx->starts[i + 1] - ctx->starts[i] == 24 * 60 * 60) {
+    return ctx->starts[i] + seconds;
+  }
+  const struct tm *date = &ctx->dates[i];
+  return wall_clock_time(date->tm_year + 1900, date->tm_mon, date->tm_mday,
+                         seconds);
+}
+
+// Part of each day, as wall clock times since midnight: [start, end)
+static bool daily_intervals(const IntervalContext *ctx, const time_t start,
+                            const time_t end, IntervalSet *out) {
+  bool ok = true;
+  for (size_t i = 0; ok && i < ctx->days; i++) {
+    time_t day_end = ctx->starts[i + 1];
+    time_t lo = wall_time_on(ctx, i, start);
+    time_t hi = wall_time_on(ctx, i, end);
+    ok = push_interval(out, ctx, lo, hi < day_end ? hi : day_end);
+  }
+  return ok;
+}
+
+// Start times at which an event of the context's duration keeps `minutes`
+// away from every event boundary, as checked by FILTER_MIN_DISTANCE
+static bool distance_intervals(const IntervalContext *ctx, const int minutes,
+                               IntervalSet *out) {
+  const Calendar *calendar = ctx->calendar;
+  if (!calendar || !calendar->event_list) {
+    return push_interval(out, ctx, ctx->from, ctx->to);
+  }
+  const time_t pad = (time_t)minutes * 60;
+  IntervalSet blocked = {NULL, 0, 0};
+  bool ok = true;
+  Event *current = get_event_on_or_before(calendar, ctx->from);
+  if (!current) {
+    current = calendar->event_list->head;
+  }
+  for (; ok && current; current = current->next) {
+    // Too close when start + duration + pad > s and start < e + pad
+    time_t lo = current->start_time - pad - ctx->duration + 1;
+    time_t hi = current->end_time + pad;
+    if (lo >= ctx->to) {
+      break;
+    }
+    ok = push_interval(&blocked, ctx, lo, hi);
+  }
+  ok = ok && complement(&blocked, ctx, out);
+  free_interval_set(&blocked);
+  return ok;
+}
+
+static bool eval_intervals(const Filter *filter, const IntervalContext *ctx,
+                           IntervalSet *out) {
+  if (!filter) {
+    return push_interval(out, ctx, ctx->from, ctx->to);
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR: {
+    IntervalSet left = {NULL, 0, 0};
+    IntervalSet right = {NULL, 0, 0};
+    bool ok = eval_intervals(filter->data.logical.left, ctx, &left) &&
+              eval_intervals(filter->data.logical.right, ctx, &right);
+    if (ok) {
+      ok = filter->type == FILTER_AND ? intersect(&left, &right, ctx, out)
+                                      : unite(&left, &right, ctx, out);
+    }
+    free_interval_set(&left);
+    free_interval_set(&right);
+    return ok;
+  }
+  case FILTER_NOT: {
+    IntervalSet operand = {NULL, 0, 0};
+    bool ok = eval_intervals(filter->data.operand, ctx, &operand) &&
+              complement(&operand, ctx, out);
+    free_interval_set(&operand);
+    return ok;
+  }
+  case FILTER_DAY_OF_WEEK:
+  case FILTER_DAY_MASK:
+  case FILTER_MONTH_MASK:
+  case FILTER_MONTH_DAYS:
+  case FILTER_NTH_WEEKDAY:
+  case FILTER_HOLIDAY: {
+    bool ok = true;
+    for (size_t i = 0; ok && i < ctx->days; i++) {
+      if (day_matches(filter, ctx, &ctx->dates[i])) {
+        ok = push_interval(out, ctx, ctx->starts[i], ctx->starts[i + 1]);
+      }
+    }
+    return ok;
+  }
+  case FILTER_AFTER_DATETIME:
+    return push_interval(out, ctx, filter->data.time_value + 1, ctx->to);
+  case FILTER_BEFORE_DATETIME:
+    return push_interval(out, ctx, ctx->from, filter->data.time_value);
+  case FILTER_AFTER_TIME:
+    return daily_intervals(ctx, filter->data.seconds, 1440 * 60, out);
+  case FILTER_BEFORE_TIME:
+    return daily_intervals(ctx, 0, filter->data.seconds, out);
+  case FILTER_TIME_WINDOW:
+    return daily_intervals(ctx, filter->data.window.start,
+                           filter->data.window.end, out);
+  case FILTER_DATE_RANGE:
+    return push_interval(out, ctx, filter->data.range.start,
+                         filter->data.range.end);
+  case FILTER_MIN_DISTANCE:
+    return distance_intervals(ctx, filter->data.minutes, out);
+  default: // FILTER_NONE
+    return push_interval(out, ctx, ctx->from, ctx->to);
+  }
+}
+
+bool filter_intervals(const Filter *filter, const Calendar *calendar,
+                      const time_t from, const time_t to,
+                      const time_t duration, IntervalSet *out) {
+  out->items = NULL;
+  out->count = 0;
+  out->capacity = 0;
+  if (from >= to) {
+    return true;
+  }
+  IntervalContext ctx = {from, to, duration, calendar, NULL, NULL, 0};
+  if (!build_days(&ctx)) {
+    return false;
+  }
+  if (calendar) {
+    // Iterating events across the horizon needs its archived years resident
+    for (size_t i = 0; i < ctx.days; i++) {
+      if (i == 0 || ctx.dates[i].tm_year != ctx.dates[i - 1].tm_year) {
+        ensure_year_loaded(calendar, ctx.dates[i].tm_year + 1900);
+      }
+    }
+  }
+  bool ok = eval_intervals(filter, &ctx, out);
+  free(ctx.starts);
+  free(ctx.dates);
+  if (!ok) {
+    free_interval_set(out);
+  }
+  return ok;
+}
+
+time_t find_first_slot(const Calendar *calendar, const Filter *filter,
+                       const time_t start_time, const time_t end_time,
+                       const time_t duration) {
+  IntervalSet valid;
+  if (!filter_intervals(filter, calendar, start_time, end_time, duration,
+                        &valid)) {
+    return -1;
+  }
+  time_t first = valid.count > 0 ? valid.items[0].start : -1;
+  free_interval_set(&valid);
+  return first;
+}
+
+void free_interval_set(IntervalSet *set) {
+  if (!set)
+    return;
+  free(set->items);
+  set->items = NULL;
+  set->count = 0;
+  set->capacity = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "calendar.h"
+#include "filter.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Interval-set filter engine.
+//
+// Instead of hopping from candidate to candidate, every node of a filter is
+// turned into the sorted list of disjoint intervals of start times it
+// accepts within a horizon, and the lists are combined with linear-time
+// union, intersection and complement. The cost is proportional to the
+// number of intervals (days, events) in the horizon, with no iteration cap.
+// A start time is accepted exactly when evaluate_filter accepts it.
+
+// Half-open interval [start, end)
+typedef struct Interval {
+  time_t start;
+  time_t end;
+} Interval;
+
+// Sorted, disjoint and non-adjacent intervals
+typedef struct IntervalSet {
+  Interval *items;
+  size_t count;
+  size_t capacity;
+} IntervalSet;
+
+// Computes the start times within [from, to) at which an event of
+// `duration` seconds satisfies the filter. A NULL filter accepts the whole
+// horizon. Returns false on allocation failure.
+bool filter_intervals(const Filter *filter, const Calendar *calendar,
+                      const time_t from, const time_t to,
+                      const time_t duration, IntervalSet *out);
+
+// Returns the earliest start in [start_time, end_time) that satisfies the
+// filter, or -1 if there is none.
+time_t find_first_slot(const Calendar *calendar, const Filter *filter,
+                       const time_t start_time, const time_t end_time,
+                       const time_t duration);
+
+void free_interval_set(IntervalSet *set);
+
+#endif // INTERVAL_H
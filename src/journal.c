@@ -0,0 +1,347 @@
+#include "journal.h"
+#include "calendar.h"
+#include "event_list.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define JOURNAL_COMPACT_AFTER 1024
+
+// Returns a newly allocated `<path><suffix>`
+static char *journal_file(const char *path, const char *suffix) {
+  size_t path_len = strlen(path);
+  size_t suffix_len = strlen(suffix);
+  char *out = malloc(path_len + suffix_len + 1);
+  if (!out) {
+    return NULL;
+  }
+  memcpy(out, path, path_len);
+  memcpy(out + path_len, suffix, suffix_len + 1);
+  return out;
+}
+
+// Flushes stdio buffers and asks the OS to put the file on stable storage
+static bool sync_file(FILE *file) {
+  if (fflush(file) != 0) {
+    return false;
+  }
+#ifdef _WIN32
+  return _commit(_fileno(file)) == 0;
+#else
+  return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool file_exists(const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+// Applies the records of a journal file to the calendar. A sealed prefix
+// found at startup may already be covered by the snapshot (the process
+// stopped between the snapshot rename and the prefix removal), so its adds
+// are skipped when `dedupe` finds the id already present.
+static void replay_journal(Calendar *calendar, const char *filename,
+                           const bool dedupe) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    return;
+  }
+  char line[2048];
+  Event record;
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == 'A' && line[1] == '|') {
+      read_event(line + 2, &record);
+      if (dedupe && get_event_calendar(calendar, record.id)) {
+        continue;
+      }
+      Event *event =
+          add_event_calendar(calendar, record.title, record.description,
+                             record.start_time, record.end_time);
+      if (event) {
+        // Keep the recorded id so later removal records still match
+        event->id = record.id;
+        if (record.id >= calendar->event_list->next_id) {
+          calendar->event_list->next_id = record.id + 1;
+        }
+      }
+    } else if (line[0] == 'R' && line[1] == '|') {
+      free(remove_event_calendar(calendar, (EventID)atol(line + 2)));
+    }
+  }
+  fclose(file);
+}
+
+Journal *open_journal(Calendar *calendar, const char *path) {
+  if (!calendar || !calendar->event_list || !path) {
+    return NULL;
+  }
+  Journal *journal = calloc(1, sizeof(Journal));
+  if (!journal) {
+    return NULL;
+  }
+  journal->calendar = calendar;
+  journal->compact_after = JOURNAL_COMPACT_AFTER;
+  journal->path = journal_file(path, "");
+  char *active = journal_file(path, ".journal");
+  char *sealed = journal_file(path, ".journal.1");
+  if (!journal->path || !active || !sealed) {
+    free(journal->path);
+    free(active);
+    free(sealed);
+    free(journal);
+    return NULL;
+  }
+
+  load_calendar_events(calendar, path);
+  replay_journal(calendar, sealed, true);
+  replay_journal(calendar, active, false);
+
+  journal->log = fopen(active, "a");
+  free(active);
+  free(sealed);
+  if (!journal->log) {
+    free(journal->path);
+    free(journal);
+    return NULL;
+  }
+  pthread_mutex_init(&journal->lock, NULL);
+  return journal;
+}
+
+// Joins a finished (or, with `block`, any) snapshot worker and frees what
+// it held. Returns the result of the snapshot, or true if none was reaped.
+static bool reap_snapshot(Journal *journal, const bool block) {
+  if (!journal->snapshot_running) {
+    return true;
+  }
+  pthread_mutex_lock(&journal->lock);
+  bool done = journal->snapshot_done;
+  pthread_mutex_unlock(&journal->lock);
+  if (!done && !block) {
+    return true;
+  }
+  pthread_join(journal->worker, NULL);
+  journal->snapshot_running = false;
+  free(journal->frozen);
+  journal->frozen = NULL;
+  journal->frozen_count = 0;
+  free_event_chain(journal->retired);
+  journal->retired = NULL;
+  return journal->snapshot_ok;
+}
+
+static void maybe_compact(Journal *journal) {
+  if (journal->compact_after && journal->records >= journal->compact_after &&
+      !journal->snapshot_running) {
+    start_snapshot(journal);
+  }
+}
+
+static bool append_record(Journal *journal) {
+  journal->records++;
+  return !ferror(journal->log) && sync_file(journal->log);
+}
+
+Event *journal_add_event(Journal *journal, const char *title,
+                         const char *description, const time_t start,
+                         const time_t end) {
+  if (!journal) {
+    return NULL;
+  }
+  reap_snapshot(journal, false);
+  Event *event =
+      add_event_calendar(journal->calendar, title, description, start, end);
+  if (!event) {
+    return NULL;
+  }
+  fputs("A|", journal->log);
+  write_event(journal->log, event);
+  append_record(journal);
+  maybe_compact(journal);
+  return event;
+}
+
+bool journal_remove_event(Journal *journal, const EventID id) {
+  if (!journal) {
+    return false;
+  }
+  reap_snapshot(journal, false);
+  Event *event = remove_event_calendar(journal->calendar, id);
+  if (!event) {
+    return false;
+  }
+  fprintf(journal->log, "R|%u\n", id);
+  append_record(journal);
+  if (journal->snapshot_running) {
+    // The worker may still be reading it
+    event->next = journal->retired;
+    journal->retired = event;
+  } else {
+    free(event);
+  }
+  maybe_compact(journal);
+  return true;
+}
+
+// Appends the contents of src to dst
+static bool append_file(const char *src, const char *dst) {
+  FILE *in = fopen(src, "rb");
+  if (!in) {
+    return true; // Nothing to append
+  }
+  FILE *out = fopen(dst, "ab");
+  if (!out) {
+    fclose(in);
+    return false;
+  }
+  char buf[8192];
+  size_t n;
+  bool ok = true;
+  while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    ok = fwrite(buf, 1, n, out) == n;
+  }
+  ok = ok && !ferror(in) && sync_file(out);
+  fclose(in);
+  ok = (fclose(out) == 0) && ok;
+  return ok;
+}
+
+// Moves the active journal to the sealed prefix and reopens an empty one.
+// A prefix left by a failed or interrupted snapshot is extended instead.
+static bool seal_active_journal(Journal *journal) {
+  char *active = journal_file(journal->path, ".journal");
+  char *sealed = journal_file(journal->path, ".journal.1");
+  bool ok = active && sealed;
+  if (ok) {
+    fclose(journal->log);
+    if (file_exists(sealed)) {
+      ok = append_file(active, sealed) && remove(active) == 0;
+    } else {
+      ok = rename(active, sealed) == 0;
+    }
+    // Keep journaling either way; on failure the records stay in `active`
+    journal->log = fopen(active, "a");
+    ok = ok && journal->log;
+  }
+  if (ok) {
+    journal->records = 0;
+  }
+  free(active);
+  free(sealed);
+  return ok;
+}
+
+static bool write_snapshot(const char *path, Event **events,
+                           const size_t count) {
+  char *tmp = journal_file(path, ".tmp");
+  if (!tmp) {
+    return false;
+  }
+  FILE *file = fopen(tmp, "w");
+  if (!file) {
+    free(tmp);
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    write_event(file, events[i]);
+  }
+  bool ok = !ferror(file) && sync_file(file);
+  ok = (fclose(file) == 0) && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) {
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+// Worker thread: only reads the frozen event array, whose events are not
+// freed until the snapshot has been reaped
+static void *snapshot_worker(void *arg) {
+  Journal *journal = arg;
+  bool ok = write_snapshot(journal->path, journal->frozen,
+                           journal->frozen_count);
+  if (ok) {
+    // The snapshot now covers the sealed prefix
+    char *sealed = journal_file(journal->path, ".journal.1");
+    ok = sealed && remove(sealed) == 0;
+    free(sealed);
+  }
+  pthread_mutex_lock(&journal->lock);
+  journal->snapshot_ok = ok;
+  journal->snapshot_done = true;
+  pthread_mutex_unlock(&journal->lock);
+  return NULL;
+}
+
+bool start_snapshot(Journal *journal) {
+  if (!journal) {
+    return false;
+  }
+  reap_snapshot(journal, false);
+  if (journal->snapshot_running) {
+    return false;
+  }
+
+  // Freeze the current view before sealing so nothing is missed
+  size_t count = 0;
+  for (Event *e = journal->calendar->event_list->head; e; e = e->next) {
+    count++;
+  }
+  Event **frozen = malloc((count ? count : 1) * sizeof(Event *));
+  if (!frozen) {
+    return false;
+  }
+  size_t i = 0;
+  for (Event *e = journal->calendar->event_list->head; e; e = e->next) {
+    frozen[i++] = e;
+  }
+  if (!seal_active_journal(journal)) {
+    free(frozen);
+    return false;
+  }
+
+  journal->frozen = frozen;
+  journal->frozen_count = count;
+  journal->snapshot_done = false;
+  journal->snapshot_ok = false;
+  journal->snapshot_running = true;
+  if (pthread_create(&journal->worker, NULL, snapshot_worker, journal) != 0) {
+    // The sealed prefix stays and is replayed or extended later
+    journal->snapshot_running = false;
+    journal->frozen = NULL;
+    journal->frozen_count = 0;
+    free(frozen);
+    return false;
+  }
+  return true;
+}
+
+bool wait_for_snapshot(Journal *journal) {
+  if (!journal) {
+    return false;
+  }
+  return reap_snapshot(journal, true);
+}
+
+void close_journal(Journal *journal) {
+  if (!journal) {
+    return;
+  }
+  reap_snapshot(journal, true);
+  if (journal->log) {
+    fclose(journal->log);
+  }
+  pthread_mutex_destroy(&journal->lock);
+  free(journal->path);
+  free(journal);
+}
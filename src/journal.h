@@ -0,0 +1,67 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "calendar.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Journaled persistence: a full snapshot in the save_events format plus an
+// append-only journal of edits since that snapshot.
+//
+//   <path>            snapshot
+//   <path>.journal    active journal, one `A|id|title|desc|start|end` or
+//                     `R|id` record per edit
+//   <path>.journal.1  sealed journal prefix covered by a snapshot in progress
+//
+// Edits only append one record, so their latency does not depend on the size
+// of the calendar. Snapshots run on a background thread: starting one seals
+// the active journal and captures the current events; the worker writes the
+// snapshot through a temporary file and rename, then deletes the sealed
+// prefix. Events are never modified in place, so the frozen view is an array
+// of event pointers; events removed while a snapshot runs are freed once it
+// has finished.
+typedef struct Journal {
+  Calendar *calendar;
+  char *path;
+  FILE *log;
+  unsigned records;       // records in the active journal
+  unsigned compact_after; // start a snapshot after this many records, 0: never
+
+  pthread_t worker;
+  bool snapshot_running;
+  Event **frozen; // events captured for the running snapshot
+  size_t frozen_count;
+  Event *retired; // removed while a snapshot runs, freed when it finishes
+
+  pthread_mutex_t lock; // guards the fields below, shared with the worker
+  bool snapshot_done;
+  bool snapshot_ok;
+} Journal;
+
+// Loads the snapshot at `path` into the calendar, replays any journals and
+// opens the active journal for appending. Returns NULL on failure.
+Journal *open_journal(Calendar *calendar, const char *path);
+
+// Adds an event to the calendar and appends it to the journal
+Event *journal_add_event(Journal *journal, const char *title,
+                         const char *description, const time_t start,
+                         const time_t end);
+
+// Removes and frees an event, appending the removal to the journal.
+// Returns false if no event has that ID.
+bool journal_remove_event(Journal *journal, const EventID id);
+
+// Seals the active journal and starts writing a snapshot in the background.
+// Returns false if a snapshot is already running or could not be started.
+bool start_snapshot(Journal *journal);
+
+// Blocks until the running snapshot, if any, is durable.
+// Returns false if it failed; its journal prefix is then kept for replay.
+bool wait_for_snapshot(Journal *journal);
+
+// Waits for any running snapshot and closes the journal. The calendar is
+// left to the caller.
+void close_journal(Journal *journal);
+
+#endif // JOURNAL_H
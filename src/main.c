@@ -1,6 +1,13 @@
+#include "archive.h"
 #include "calendar.h"
 #include "event_list.h"
 #include "filter.h"
+#include "holiday.h"
+#include "ics.h"
+#include "journal.h"
+#include "parallel_search.h"
+#include "scheduler.h"
+#include "segment.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,13 +17,26 @@ static void print_usage(const char *prog_name) {
   printf("Usage: %s [options] <command>\n", prog_name);
   printf("Options:\n");
   printf("  -f <file>    Use persistent storage file\n");
+  printf("  -d <dir>     Use per-year segment directory\n");
+  printf("  -j <file>    Use journaled storage (snapshot + edit log)\n");
+  printf("  -H <file>    Load holiday rules (after any storage option)\n");
   printf("\nCommands:\n");
   printf("  list [start] [end]           List events in date range\n");
   printf("  add <title> <desc> <start> <end>  Add event\n");
   printf("  find [filter]     Find optimal time slot\n");
   printf(
       "  find [filter] --add <title> <desc> <duration>  Find and add event\n");
+  printf("  find [filter] --count <K>    List the next K free slots\n");
+  printf("  find [filter] --latest <time>  Latest slot ending by the time\n");
+  printf("  find [filter] --profile      Print per-node filter statistics\n");
+  printf("  find [filter] --within <days>  Search the next days on all "
+         "cores\n");
+  printf("  schedule <file> [--add] [--backtrack <N>] [--within <days>]\n");
+  printf("                               Place several meetings at once\n");
   printf("  remove <id>                  Remove event by ID\n");
+  printf("  archive <year>               Compress a past year (with -d)\n");
+  printf("  import <file.ics>            Import events from iCalendar\n");
+  printf("  export <file.ics>            Export events as iCalendar\n");
   printf("\nTime format: YYYY-MM-DD-HH:MM\n");
   printf("Date format (filters): YYYY-M-D\n");
   printf("\nFilter keywords:\n");
@@ -24,6 +44,10 @@ static void print_usage(const char *prog_name) {
   printf("  on <day>[,<day>...]         (e.g., on Monday, Friday)\n");
   printf("  before <date>, after <date>\n");
   printf("  spaced <N> <unit>           (units: minutes/hours/days)\n");
+  printf("  in <month>[-<month>][,...]  (e.g., in March-May)\n");
+  printf("  days <N>[-<M>][,...]        (days of the month)\n");
+  printf("  first..fifth/last <day>     (e.g., first Monday)\n");
+  printf("  within <N> <unit>, from <date> to <date>\n");
   printf("  not, and, or                (logical operators)\n");
   printf("\nExamples:\n");
   printf("  weekdays and not holidays\n");
@@ -43,20 +67,58 @@ static time_t parse_time(const char *str) {
   return time(NULL);
 }
 
-int main(int argc, char *argv[]) {
-  Calendar *cal = create_calendar();
-  char *filename = NULL;
-  int arg_offset = 1;
+// Storage selected on the command line; at most one is set
+typedef struct {
+  const char *filename;
+  const char *directory;
+  Journal *journal;
+} Storage;
 
-  if (argc > 2 && strcmp(argv[1], "-f") == 0) {
-    filename = argv[2];
-    arg_offset = 3;
-    load_calendar_events(cal, filename);
+// Writes changes back to whichever storage the calendar was loaded from.
+// Journaled edits are already durable; bulk changes get a fresh snapshot.
+static void persist(Calendar *cal, const Storage *storage) {
+  if (storage->filename)
+    save_events(cal->event_list, storage->filename);
+  if (storage->directory)
+    save_calendar_segments(cal, storage->directory);
+  if (storage->journal)
+    start_snapshot(storage->journal);
+}
+
+static Event *store_add(Calendar *cal, const Storage *storage,
+                        const char *title, const char *desc, time_t start,
+                        time_t end) {
+  if (storage->journal)
+    return journal_add_event(storage->journal, title, desc, start, end);
+  Event *ev = add_event_calendar(cal, title, desc, start, end);
+  persist(cal, storage);
+  return ev;
+}
+
+static void store_remove(Calendar *cal, const Storage *storage, EventID id) {
+  if (storage->journal) {
+    journal_remove_event(storage->journal, id);
+    return;
+  }
+  free(remove_event_calendar(cal, id));
+  persist(cal, storage);
+}
+
+// Runs the command from argv[arg_offset] on, after any -H option, on the
+// loaded calendar. Returns the exit status; the caller releases the
+// calendar and storage either way.
+static int run_command(Calendar *cal, const Storage *storage, int argc,
+                       char *argv[], int arg_offset) {
+  if (argc > arg_offset + 1 && strcmp(argv[arg_offset], "-H") == 0) {
+    if (!load_calendar_holidays(cal, argv[arg_offset + 1])) {
+      printf("Error: could not load holidays from %s\n", argv[arg_offset + 1]);
+      return 1;
+    }
+    arg_offset += 2;
   }
 
   if (argc <= arg_offset) {
     print_usage(argv[0]);
-    free_calendar(cal);
     return 1;
   }
 
@@ -67,12 +129,16 @@ int main(int argc, char *argv[]) {
         (arg_offset + 1 < argc) ? parse_time(argv[arg_offset + 1]) : time(NULL);
     time_t end = (arg_offset + 2 < argc) ? parse_time(argv[arg_offset + 2])
                                          : start + 86400 * 30;
+    // Decode any archived years the range touches
+    unsigned first_year = localtime(&start)->tm_year + 1900;
+    unsigned last_year = localtime(&end)->tm_year + 1900;
+    while (load_archive_between(cal, first_year - 1, last_year + 1))
+      ;
     list_events(cal->event_list, start, end);
 
   } else if (strcmp(command, "add") == 0) {
     if (argc < arg_offset + 5) {
       printf("Error: add requires title, description, start, end\n");
-      free_calendar(cal);
       return 1;
     }
 
@@ -81,12 +147,9 @@ int main(int argc, char *argv[]) {
     time_t start = parse_time(argv[arg_offset + 3]);
     time_t end = parse_time(argv[arg_offset + 4]);
 
-    Event *ev = add_event_calendar(cal, title, desc, start, end);
+    Event *ev = store_add(cal, storage, title, desc, start, end);
     printf("Event added with ID: %d\n", ev->id);
 
-    if (filename)
-      save_events(cal->event_list, filename);
-
   } else if (strcmp(command, "find") == 0) {
     // Check for --add option
     // If present, we will add the event after finding the optimal time
@@ -94,12 +157,39 @@ int main(int argc, char *argv[]) {
     const char *add_title = NULL;
     const char *add_desc = NULL;
     int duration = 0;
+    int count = 1;
+    int within = 0;
+    bool do_profile = false;
+    time_t deadline = 0;
     for (int i = arg_offset + 2; i < argc; i++) {
+      if (strcmp(argv[i], "--profile") == 0) {
+        do_profile = true;
+        continue;
+      }
+      if (strcmp(argv[i], "--latest") == 0 && i + 1 < argc) {
+        deadline = parse_time(argv[++i]);
+        continue;
+      }
+      if (strcmp(argv[i], "--within") == 0 && i + 1 < argc) {
+        within = atoi(argv[++i]);
+        if (within < 1) {
+          printf("Error: --within requires a positive number of days\n");
+          return 1;
+        }
+        continue;
+      }
+      if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+        count = atoi(argv[++i]);
+        if (count < 1) {
+          printf("Error: --count requires a positive number\n");
+          return 1;
+        }
+        continue;
+      }
       if (strcmp(argv[i], "--add") == 0) {
         do_add = true;
         if (i + 3 >= argc) {
           printf("Error: --add requires title, description, and duration\n");
-          free_calendar(cal);
           return 1;
         }
         add_title = argv[i + 1];
@@ -114,58 +204,220 @@ int main(int argc, char *argv[]) {
     const char *filter_str =
         (arg_offset + 1 < argc) ? argv[arg_offset + 1] : "";
 
-    Filter *filter = parse_filter(filter_str);
+    Filter *filter = optimize_filter(parse_filter(filter_str));
 
     if (!filter) {
       printf("Error: invalid filter\n");
-      free_calendar(cal);
       return 1;
     }
 
-    time_t optimal = find_optimal_time(cal, filter, time(NULL), (time_t)duration * 60);
-    if (optimal == -1) {
+    time_t *slots = malloc((size_t)count * sizeof(time_t));
+    size_t found = 0;
+    time_t now = time(NULL);
+    const time_t horizon =
+        within > 0 ? now + (time_t)within * 24 * 60 * 60 : 0;
+    if (slots && deadline) {
+      // Latest slot that ends by the deadline, if it is not already past
+      slots[0] =
+          find_latest_time(cal, filter, deadline, (time_t)duration * 60);
+      found = slots[0] >= now;
+    } else if (slots && within > 0 && count == 1 && !do_profile) {
+      slots[0] = find_optimal_time_parallel(cal, filter, now, horizon,
+                                            (time_t)duration * 60, 0);
+      found = slots[0] != -1;
+    } else if (slots && (do_profile || within > 0)) {
+      // A cursor stops at the horizon, and is single-threaded, so a
+      // profile sees every evaluation
+      FilterProfile *profile =
+          do_profile ? create_filter_profile(filter) : NULL;
+      SearchOptions options = {.horizon = horizon, .profile = profile};
+      SlotCursor *cursor = create_slot_cursor(
+          cal, filter, now, (time_t)duration * 60, &options);
+      while (cursor && (profile || !do_profile) && found < (size_t)count) {
+        time_t slot = next_slot(cursor);
+        if (slot == -1) {
+          break;
+        }
+        slots[found++] = slot;
+      }
+      free_slot_cursor(cursor);
+      if (profile) {
+        print_filter_profile(profile, stdout);
+      }
+      free_filter_profile(profile);
+    } else if (slots) {
+      found = find_optimal_times(cal, filter, now, (time_t)duration * 60,
+                                 (size_t)count, slots);
+    }
+    if (found == 0) {
       printf("No valid time slot found within constraints\n");
+      free(slots);
       destroy_filter(filter);
-      free_calendar(cal);
       return 1;
     }
 
     char buf[64];
-    strftime(buf, 64, "%Y-%m-%d %H:%M", localtime(&optimal));
-    printf("Optimal time: %s\n", buf);
+    for (size_t i = 0; i < found; i++) {
+      strftime(buf, 64, "%Y-%m-%d %H:%M", localtime(&slots[i]));
+      if (count == 1) {
+        printf("Optimal time: %s\n", buf);
+      } else {
+        printf("Option %zu: %s\n", i + 1, buf);
+      }
+    }
+    time_t optimal = slots[0];
+    free(slots);
 
     if (do_add) {
       time_t end_time = optimal + duration * 60;
       Event *ev =
-          add_event_calendar(cal, add_title, add_desc, optimal, end_time);
+          store_add(cal, storage, add_title, add_desc, optimal, end_time);
       printf("Event added with ID: %d\n", ev->id);
-
-      if (filename)
-        save_events(cal->event_list, filename);
     }
 
     destroy_filter(filter);
 
+  } else if (strcmp(command, "schedule") == 0) {
+    if (argc < arg_offset + 2) {
+      printf("Error: schedule requires a request file\n");
+      return 1;
+    }
+    bool do_add = false;
+    ScheduleOptions options = {0, 0};
+    time_t now = time(NULL);
+    for (int i = arg_offset + 2; i < argc; i++) {
+      if (strcmp(argv[i], "--add") == 0) {
+        do_add = true;
+      } else if (strcmp(argv[i], "--backtrack") == 0 && i + 1 < argc) {
+        options.max_backtracks = (unsigned)atoi(argv[++i]);
+      } else if (strcmp(argv[i], "--within") == 0 && i + 1 < argc) {
+        options.horizon = now + (time_t)atoi(argv[++i]) * 24 * 60 * 60;
+      }
+    }
+
+    size_t count;
+    ScheduleRequest *requests =
+        read_schedule_requests(argv[arg_offset + 1], &count);
+    if (!requests) {
+      if (count)
+        printf("Error: invalid request on line %zu\n", count);
+      else
+        printf("Error: could not read %s\n", argv[arg_offset + 1]);
+      return 1;
+    }
+    time_t *starts = malloc((count ? count : 1) * sizeof(time_t));
+    size_t placed =
+        starts ? schedule_requests(cal, requests, count, now, &options, starts)
+               : 0;
+
+    char buf[64];
+    for (size_t i = 0; starts && i < count; i++) {
+      if (starts[i] == -1) {
+        printf("%s: no slot found\n", requests[i].title);
+        continue;
+      }
+      strftime(buf, 64, "%Y-%m-%d %H:%M", localtime(&starts[i]));
+      printf("%s: %s\n", requests[i].title, buf);
+      if (!do_add)
+        continue;
+      time_t end_time = starts[i] + requests[i].duration;
+      if (storage->journal)
+        journal_add_event(storage->journal, requests[i].title, "", starts[i],
+                          end_time);
+      else
+        add_event_calendar(cal, requests[i].title, "", starts[i], end_time);
+    }
+    printf("Placed %zu of %zu meetings\n", placed, count);
+    // Saved once for the whole batch; journaled adds are already durable
+    if (do_add && placed > 0 && !storage->journal)
+      persist(cal, storage);
+    free(starts);
+    free_schedule_requests(requests, count);
+
   } else if (strcmp(command, "remove") == 0) {
     if (argc < arg_offset + 2) {
       printf("Error: remove requires event ID\n");
-      free_calendar(cal);
       return 1;
     }
 
     int id = atoi(argv[arg_offset + 1]);
-    remove_event_calendar(cal, id);
+    store_remove(cal, storage, id);
     printf("Event %d removed\n", id);
 
-    if (filename)
-      save_events(cal->event_list, filename);
+  } else if (strcmp(command, "archive") == 0) {
+    if (argc < arg_offset + 2 || !storage->directory) {
+      printf("Error: archive requires a year and a -d directory\n");
+      return 1;
+    }
+
+    unsigned year = (unsigned)atoi(argv[arg_offset + 1]);
+    // Flush pending edits first so the archive and segments agree
+    save_calendar_segments(cal, storage->directory);
+    if (!archive_segment_year(cal, storage->directory, year)) {
+      printf("Error: could not archive %u\n", year);
+      return 1;
+    }
+    printf("Year %u archived\n", year);
+
+  } else if (strcmp(command, "import") == 0) {
+    if (argc < arg_offset + 2) {
+      printf("Error: import requires an .ics file\n");
+      return 1;
+    }
+
+    long count = import_ics(cal, argv[arg_offset + 1]);
+    if (count < 0) {
+      printf("Error: could not read %s\n", argv[arg_offset + 1]);
+      return 1;
+    }
+    printf("Imported %ld events\n", count);
+
+    persist(cal, storage);
+
+  } else if (strcmp(command, "export") == 0) {
+    if (argc < arg_offset + 2) {
+      printf("Error: export requires an .ics file\n");
+      return 1;
+    }
+
+    if (!export_ics(cal, argv[arg_offset + 1])) {
+      printf("Error: could not write %s\n", argv[arg_offset + 1]);
+      return 1;
+    }
 
   } else {
     print_usage(argv[0]);
-    free_calendar(cal);
     return 1;
   }
 
-  free_calendar(cal);
   return 0;
 }
+
+int main(int argc, char *argv[]) {
+  Calendar *cal = create_calendar();
+  Storage storage = {NULL, NULL, NULL};
+  int arg_offset = 1;
+
+  if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+    storage.filename = argv[2];
+    arg_offset = 3;
+    load_calendar_events(cal, storage.filename);
+  } else if (argc > 2 && strcmp(argv[1], "-d") == 0) {
+    storage.directory = argv[2];
+    arg_offset = 3;
+    load_calendar_segments(cal, storage.directory);
+  } else if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    arg_offset = 3;
+    storage.journal = open_journal(cal, argv[2]);
+    if (!storage.journal) {
+      printf("Error: could not open journal %s\n", argv[2]);
+      free_calendar(cal);
+      return 1;
+    }
+  }
+
+  const int status = run_command(cal, &storage, argc, argv, arg_offset);
+  close_journal(storage.journal);
+  free_calendar(cal);
+  return status;
+}
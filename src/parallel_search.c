@@ -0,0 +1,192 @@
+#include "parallel_search.h"
+#include "archive.h"
+#include "gap_index.h"
+#include "holiday.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CHUNKS_PER_THREAD 4
+#define MIN_CHUNK_SECONDS (60 * 60)
+
+typedef struct {
+  const Calendar *calendar;
+  const Filter *filter;
+  time_t start;
+  time_t end;
+  time_t duration;
+  time_t chunk_length;
+  size_t chunks;
+  pthread_mutex_t lock;
+  size_t next_chunk; // next chunk nobody has claimed
+  size_t best_chunk; // earliest chunk with a final answer, chunks if none
+  time_t best_slot;
+} ParallelSearch;
+
+// The chunk a worker is searching, passed to its cancellation check
+typedef struct {
+  ParallelSearch *search;
+  size_t chunk;
+} ChunkSearch;
+
+static unsigned cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  long n = (long)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return n > 0 ? (unsigned)n : 1;
+}
+
+// Returns true if any node of the filter has the given type
+static bool parallel_uses(const Filter *filter, const FilterType type) {
+  if (!filter) {
+    return false;
+  }
+  if (filter->type == type) {
+    return true;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return parallel_uses(filter->data.logical.left, type) ||
+           parallel_uses(filter->data.logical.right, type);
+  case FILTER_NOT:
+    return parallel_uses(filter->data.operand, type);
+  default:
+    return false;
+  }
+}
+
+// Fills the caches the workers would otherwise fill concurrently
+static void prepare_calendar(const Calendar *calendar, const Filter *filter,
+                             const time_t start, const time_t end) {
+  if (!calendar) {
+    return;
+  }
+  if (parallel_uses(filter, FILTER_MIN_DISTANCE)) {
+    // Spacing looks at the events before a candidate, in any earlier year
+    load_all_archives(calendar);
+    calendar_gap_index(calendar);
+  }
+  struct tm first;
+  struct tm last;
+  if (parallel_uses(filter, FILTER_HOLIDAY) && local_time(start, &first) &&
+      local_time(end, &last)) {
+    // Lookups near the end of a year read the next one too, and with rules
+    // that skip years the distance to a holiday scans years further away
+    prepare_holiday_years(calendar,
+                          first.tm_year + 1900 - HOLIDAY_SCAN_YEARS,
+                          last.tm_year + 1900 + 1 + HOLIDAY_SCAN_YEARS);
+  }
+}
+
+static bool chunk_cancelled(void *arg) {
+  ChunkSearch *self = arg;
+  pthread_mutex_lock(&self->search->lock);
+  bool cancelled = self->search->best_chunk < self->chunk;
+  pthread_mutex_unlock(&self->search->lock);
+  return cancelled;
+}
+
+// Claims chunks in order until none is left that could improve on the best
+// answer found so far
+static void *search_worker(void *arg) {
+  ParallelSearch *search = arg;
+  while (true) {
+    pthread_mutex_lock(&search->lock);
+    size_t chunk = search->next_chunk;
+    bool done = chunk >= search->chunks || chunk > search->best_chunk;
+    if (!done) {
+      search->next_chunk++;
+    }
+    pthread_mutex_unlock(&search->lock);
+    if (done) {
+      break;
+    }
+
+    time_t from = search->start + (time_t)chunk * search->chunk_length;
+    time_t to = from + search->chunk_length - 1;
+    if (to > search->end) {
+      to = search->end;
+    }
+    ChunkSearch self = {search, chunk};
+    SearchOptions options = {.horizon = to,
+                             .max_iterations = ULONG_MAX,
+                             .cancelled = chunk_cancelled,
+                             .cancel_arg = &self};
+    SearchStats stats;
+    time_t slot = search_optimal_time(search->calendar, search->filter, from,
+                                      search->duration, &options, &stats);
+    // An unsatisfiable filter stays so in every later chunk: also final
+    if (stats.status == SEARCH_FOUND ||
+        stats.status == SEARCH_UNSATISFIABLE) {
+      pthread_mutex_lock(&search->lock);
+      if (chunk < search->best_chunk) {
+        search->best_chunk = chunk;
+        search->best_slot = slot;
+      }
+      pthread_mutex_unlock(&search->lock);
+    }
+  }
+  return NULL;
+}
+
+time_t find_optimal_time_parallel(const Calendar *calendar,
+                                  const Filter *filter,
+                                  const time_t start_time,
+                                  const time_t end_time,
+                                  const time_t duration,
+                                  const unsigned threads) {
+  if (start_time > end_time) {
+    return -1;
+  }
+  if (!filter) {
+    return start_time; // No filter means now is valid
+  }
+  const unsigned n = threads ? threads : cpu_count();
+  prepare_calendar(calendar, filter, start_time, end_time);
+
+  const time_t span = end_time - start_time + 1;
+  const time_t wanted = (time_t)n * CHUNKS_PER_THREAD;
+  time_t chunk_length = (span + wanted - 1) / wanted;
+  if (chunk_length < MIN_CHUNK_SECONDS) {
+    chunk_length = MIN_CHUNK_SECONDS;
+  }
+  ParallelSearch search;
+  search.calendar = calendar;
+  search.filter = filter;
+  search.start = start_time;
+  search.end = end_time;
+  search.duration = duration;
+  search.chunk_length = chunk_length;
+  search.chunks = (size_t)((span + chunk_length - 1) / chunk_length);
+  search.next_chunk = 0;
+  search.best_chunk = search.chunks;
+  search.best_slot = -1;
+  pthread_mutex_init(&search.lock, NULL);
+
+  // The calling thread works too; if a thread cannot be started the others
+  // simply claim more chunks
+  pthread_t *workers = n > 1 ? malloc((n - 1) * sizeof(pthread_t)) : NULL;
+  unsigned started = 0;
+  while (workers && started < n - 1 &&
+         pthread_create(&workers[started], NULL, search_worker, &search) ==
+             0) {
+    started++;
+  }
+  search_worker(&search);
+  for (unsigned i = 0; i < started; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  pthread_mutex_destroy(&search.lock);
+  return search.best_chunk < search.chunks ? search.best_slot : -1;
+}
@@ -0,0 +1,30 @@
+#ifndef PARALLEL_SEARCH_H
+#define PARALLEL_SEARCH_H
+
+#include "calendar.h"
+#include "filter.h"
+#include <time.h>
+
+// Parallel slot search over a bounded horizon.
+//
+// The horizon is split into chunks that worker threads claim in order, each
+// running its own forward search bounded by the end of its chunk. The first
+// slot of the earliest chunk that has one is the answer, the same one a
+// sequential search finds: skip distances never pass over a valid time.
+// Once a chunk finds a slot, the searches of later chunks are cancelled.
+//
+// Lazily filled caches that the evaluation reads (archived years, the gap
+// index, expanded holiday years) are loaded before the threads start. The
+// calendar must not be modified while a search runs.
+
+// Finds the earliest slot starting in [start_time, end_time] that satisfies
+// the filter, using up to `threads` threads (0: one per online CPU).
+// Returns -1 if there is none.
+time_t find_optimal_time_parallel(const Calendar *calendar,
+                                  const Filter *filter,
+                                  const time_t start_time,
+                                  const time_t end_time,
+                                  const time_t duration,
+                                  const unsigned threads);
+
+#endif // PARALLEL_SEARCH_H
@@ -11,12 +11,22 @@
 //   unary      := NOT unary | primary
 //   primary    := '(' expr ')' | weekdays | holidays | 'on' day_list
 //               | 'before' datetime | 'after' datetime | 'spaced' duration
+//               | 'in' month_list | ('day'|'days') mday_list
+//               | ordinal day_name ['of' ['the'] 'month']
+//               | 'within' ['the'] ['next'] span
+//               | 'from' date [time] 'to' date [time]
 //   day_list   := day_name (',' day_name)*
+//   month_list := month_name ['-' month_name] (',' month_list)*
+//   mday_list  := int ['-' int] (',' mday_list)*
+//   ordinal    := first|second|third|fourth|fifth|last
+//   span       := int ('minutes'|'hours'|'days'|'weeks'|'months'), days by
+//                 default
 //   duration   := signed_int ('minute'|'minutes'|'hour'|'hours')
 //   datetime   := date [time] | time
 //   date       := YYYY '-' M '-' D
 //   time       := HH ':' MM [':' SS]
 //   day_name   := Sunday|Monday|Tuesday|Wednesday|Thursday|Friday|Saturday
+//   month_name := January|...|December, or their first three letters
 
 static char lower_char(char c) {
   if (c >= 'A' && c <= 'Z')
@@ -86,6 +96,21 @@ static bool match_ci(Parser *p, const char *lit) {
   return true;
 }
 
+// Match exactly n letters of word case-insensitively, not followed by
+// another letter (so "Mar" does not match the start of "March")
+static bool match_letters(Parser *p, const char *word, size_t n) {
+  size_t start = p->pos;
+  for (size_t i = 0; i < n; i++) {
+    if (start + i >= p->len || lower_char(p->s[start + i]) != word[i])
+      return false;
+  }
+  char next = lower_char(start + n < p->len ? p->s[start + n] : '\0');
+  if (next >= 'a' && next <= 'z')
+    return false;
+  p->pos = start + n;
+  return true;
+}
+
 static bool parse_int(Parser *p, int *out) {
   skip_ws(p);
   int val = 0;
@@ -194,7 +219,8 @@ static bool parse_time(Parser *p, int *hour, int *minute, int *second) {
   return true;
 }
 
-// Parse datetime as either `date [time]` or `time`
+// Parse datetime as either `date [time]` or `time`. A time on its own is
+// returned as seconds since midnight.
 static bool parse_datetime(Parser *p, time_t *out, bool *has_date) {
   size_t save = p->pos;
   int h = 0, m = 0, s = 0;
@@ -217,8 +243,7 @@ static bool parse_datetime(Parser *p, time_t *out, bool *has_date) {
   if (has_date)
     *has_date = false;
 
-  // Use epoch date for time-only
-  *out = make_date_time(1970, 1, 1, h, m, s);
+  *out = h * 3600 + m * 60 + s;
   return true;
 }
 
@@ -241,8 +266,25 @@ static int day_name_to_wday(Parser *p) {
   return -1;
 }
 
-static Filter *day_filter(int wday) {
-  Filter *f = make_filter(FILTER_DAY_OF_WEEK);
+static int month_name_to_mon(Parser *p) {
+  static const char *const names[] = {
+      "january", "february", "march",     "april",   "may",      "june",
+      "july",    "august",   "september", "october", "november", "december"};
+  skip_ws(p);
+  for (int m = 0; m < 12; m++) {
+    if (match_letters(p, names[m], strlen(names[m])) ||
+        match_letters(p, names[m], 3))
+      return m;
+  }
+  return -1;
+}
+
+static Filter *new_filter(Parser *p, FilterType type) {
+  return make_filter_in(p->arena, type);
+}
+
+static Filter *day_filter(Parser *p, int wday) {
+  Filter *f = new_filter(p, FILTER_DAY_OF_WEEK);
 
   f->data.day_of_week = wday;
   return f;
@@ -256,7 +298,7 @@ static Filter *parse_on(Parser *p) {
   int w = day_name_to_wday(p);
   if (w < 0)
     return NULL;
-  acc = day_filter(w);
+  acc = day_filter(p, w);
   while (1) {
     skip_ws(p);
     if (peek_char(p, ',')) {
@@ -264,7 +306,7 @@ static Filter *parse_on(Parser *p) {
       int w2 = day_name_to_wday(p);
       if (w2 < 0)
         break;
-      acc = or_filter(acc, day_filter(w2));
+      acc = or_filter(acc, day_filter(p, w2));
       continue;
     }
     break;
@@ -277,7 +319,7 @@ static Filter *parse_weekdays(Parser *p) {
     return NULL;
   Filter *acc = NULL;
   for (int i = 1; i <= 5; i++) {
-    Filter *d = day_filter(i);
+    Filter *d = day_filter(p, i);
     if (!acc)
       acc = d;
     else
@@ -291,36 +333,36 @@ static Filter *parse_business_days(Parser *p) {
     return NULL;
   Filter *acc = NULL;
   for (int i = 1; i <= 5; i++) {
-    Filter *d = day_filter(i);
+    Filter *d = day_filter(p, i);
     if (!acc)
       acc = d;
     else
       acc = or_filter(acc, d);
   }
-  return and_filter(acc, not_filter(make_filter(FILTER_HOLIDAY)));
+  return and_filter(acc, not_filter(new_filter(p, FILTER_HOLIDAY)));
 }
 
 static Filter *parse_weekend(Parser *p) {
   if (!match_word(p, "weekend"))
     return NULL;
-  Filter *sat = day_filter(6);
-  Filter *sun = day_filter(0);
+  Filter *sat = day_filter(p, 6);
+  Filter *sun = day_filter(p, 0);
   return or_filter(sat, sun);
 }
 
 static Filter *parse_holidays(Parser *p) {
   if (!match_word(p, "holidays"))
     return NULL;
-  return make_filter(FILTER_HOLIDAY);
+  return new_filter(p, FILTER_HOLIDAY);
 }
 
 static Filter *parse_business_hours(Parser *p) {
   if (!match_word(p, "business_hours"))
     return NULL;
-  Filter *after_nine = make_filter(FILTER_AFTER_TIME);
-  after_nine->data.time_value = make_date_time(1970, 1, 1, 9, 0, 0);
-  Filter *before_five = make_filter(FILTER_BEFORE_TIME);
-  before_five->data.time_value = make_date_time(1970, 1, 1, 17, 0, 0);
+  Filter *after_nine = new_filter(p, FILTER_AFTER_TIME);
+  after_nine->data.seconds = 9 * 3600;
+  Filter *before_five = new_filter(p, FILTER_BEFORE_TIME);
+  before_five->data.seconds = 17 * 3600;
   return and_filter(after_nine, before_five);
 }
 
@@ -333,9 +375,14 @@ static Filter *parse_before(Parser *p) {
   if (!parse_datetime(p, &t, &has_date))
     return NULL;
 
-  Filter *f =
-      make_filter(has_date ? FILTER_BEFORE_DATETIME : FILTER_BEFORE_TIME);
-  f->data.time_value = t;
+  Filter *f;
+  if (has_date) {
+    f = new_filter(p, FILTER_BEFORE_DATETIME);
+    f->data.time_value = t;
+  } else {
+    f = new_filter(p, FILTER_BEFORE_TIME);
+    f->data.seconds = t;
+  }
   return f;
 }
 
@@ -347,8 +394,14 @@ static Filter *parse_after(Parser *p) {
   if (!parse_datetime(p, &t, &has_date))
     return NULL;
 
-  Filter *f = make_filter(has_date ? FILTER_AFTER_DATETIME : FILTER_AFTER_TIME);
-  f->data.time_value = t;
+  Filter *f;
+  if (has_date) {
+    f = new_filter(p, FILTER_AFTER_DATETIME);
+    f->data.time_value = t;
+  } else {
+    f = new_filter(p, FILTER_AFTER_TIME);
+    f->data.seconds = t;
+  }
   return f;
 }
 
@@ -374,12 +427,165 @@ static Filter *parse_spaced(Parser *p) {
     // Assume minutes if no unit specified
   }
 
-  Filter *f = make_filter(FILTER_MIN_DISTANCE);
+  Filter *f = new_filter(p, FILTER_MIN_DISTANCE);
   f->data.minutes = val;
 
   return f;
 }
 
+// Months, with ranges that may wrap around the year: in Nov-Feb, Jul
+static Filter *parse_in(Parser *p) {
+  if (!match_word(p, "in"))
+    return NULL;
+  unsigned mask = 0;
+  int first = month_name_to_mon(p);
+  while (first >= 0) {
+    int last = first;
+    if (match_char(p, '-')) {
+      last = month_name_to_mon(p);
+      if (last < 0)
+        return NULL;
+    }
+    for (int m = first;; m = (m + 1) % 12) {
+      mask |= 1u << m;
+      if (m == last)
+        break;
+    }
+    first = match_char(p, ',') ? month_name_to_mon(p) : -1;
+  }
+  if (!mask)
+    return NULL;
+  Filter *f = new_filter(p, FILTER_MONTH_MASK);
+  f->data.month_mask = (unsigned short)mask;
+  return f;
+}
+
+// Days of the month: days 1-7, 15
+static Filter *parse_days(Parser *p) {
+  if (!match_word(p, "days") && !match_word(p, "day"))
+    return NULL;
+  unsigned mask = 0;
+  int first = 0;
+  bool more = parse_int(p, &first);
+  while (more) {
+    int last = first;
+    if (match_char(p, '-') && !parse_int(p, &last))
+      return NULL;
+    if (first < 1 || last > 31 || first > last)
+      return NULL;
+    for (int d = first; d <= last; d++) {
+      mask |= 1u << d;
+    }
+    more = match_char(p, ',') && parse_int(p, &first);
+  }
+  if (!mask)
+    return NULL;
+  Filter *f = new_filter(p, FILTER_MONTH_DAYS);
+  f->data.month_days = mask;
+  return f;
+}
+
+// first Monday, last Friday of the month
+static Filter *parse_nth_weekday(Parser *p) {
+  static const char *const ordinals[] = {"first", "second", "third",
+                                         "fourth", "fifth"};
+  int week = 0;
+  for (int i = 0; i < 5 && !week; i++) {
+    if (match_word(p, ordinals[i]))
+      week = i + 1;
+  }
+  if (!week && match_word(p, "last"))
+    week = -1;
+  if (!week)
+    return NULL;
+  int wday = day_name_to_wday(p);
+  if (wday < 0)
+    return NULL;
+  size_t save = p->pos;
+  if (match_word(p, "of")) {
+    match_word(p, "the");
+    if (!match_word(p, "month"))
+      p->pos = save;
+  }
+  Filter *f = new_filter(p, FILTER_NTH_WEEKDAY);
+  f->data.nth.week = week;
+  f->data.nth.day_of_week = wday;
+  return f;
+}
+
+// Relative window starting now: within the next 10 days
+static Filter *parse_within(Parser *p) {
+  if (!match_word(p, "within"))
+    return NULL;
+  match_word(p, "the");
+  match_word(p, "next");
+  int val = 0;
+  if (!parse_int(p, &val))
+    return NULL;
+  skip_ws(p);
+  time_t unit = 24 * 60 * 60;
+  time_t start = time(NULL);
+  if (match_ci(p, "months") || match_ci(p, "month")) {
+    // Calendar months vary in length
+    struct tm date;
+    if (!local_time(start, &date))
+      return NULL;
+    date.tm_mon += val;
+    date.tm_isdst = -1;
+    Filter *f = new_filter(p, FILTER_DATE_RANGE);
+    f->data.range.start = start;
+    f->data.range.end = mktime(&date);
+    return f;
+  }
+  if (match_ci(p, "minutes") || match_ci(p, "minute") || match_ci(p, "mins") ||
+      match_ci(p, "min") || match_ci(p, "m")) {
+    unit = 60;
+  } else if (match_ci(p, "hours") || match_ci(p, "hour") ||
+             match_ci(p, "hrs") || match_ci(p, "hr") || match_ci(p, "h")) {
+    unit = 60 * 60;
+  } else if (match_ci(p, "weeks") || match_ci(p, "week") ||
+             match_ci(p, "w")) {
+    unit = 7 * 24 * 60 * 60;
+  } else if (match_ci(p, "days") || match_ci(p, "day") || match_ci(p, "d")) {
+    // the default
+  }
+
+  Filter *f = new_filter(p, FILTER_DATE_RANGE);
+  f->data.range.start = start;
+  f->data.range.end = start + val * unit;
+  return f;
+}
+
+// Date range; an end date without a time includes that whole day
+static Filter *parse_from(Parser *p) {
+  if (!match_word(p, "from"))
+    return NULL;
+  int h = 0, m = 0, s = 0;
+  time_t start;
+  if (!parse_date(p, &start))
+    return NULL;
+  if (parse_time(p, &h, &m, &s))
+    start += h * 3600 + m * 60 + s;
+  time_t end;
+  if (!match_word(p, "to") || !parse_date(p, &end))
+    return NULL;
+  if (parse_time(p, &h, &m, &s)) {
+    end += h * 3600 + m * 60 + s;
+  } else {
+    struct tm day;
+    if (!local_time(end, &day))
+      return NULL;
+    day.tm_mday++;
+    day.tm_isdst = -1;
+    end = mktime(&day);
+  }
+
+  Filter *f = new_filter(p, FILTER_DATE_RANGE);
+  f->data.range.start = start;
+  f->data.range.end = end;
+  return f;
+}
+
 static Filter *parse_expr(Parser *p); // forward
 
 static Filter *parse_primary(Parser *p) {
@@ -387,7 +593,7 @@ static Filter *parse_primary(Parser *p) {
   if (match_char(p, '(')) {
     Filter *inside = parse_expr(p);
     match_char(p, ')'); // best-effort close
-    return inside ? inside : make_filter(FILTER_NONE);
+    return inside ? inside : new_filter(p, FILTER_NONE);
   }
 
   size_t save = p->pos;
@@ -406,9 +612,14 @@ static Filter *parse_primary(Parser *p) {
   parse(business_days);
   parse(business_hours);
   parse(weekend);
+  parse(in);
+  parse(days);
+  parse(nth_weekday);
+  parse(within);
+  parse(from);
 #undef parse
 
-  return make_filter(FILTER_NONE);
+  return new_filter(p, FILTER_NONE);
 }
 
 static Filter *parse_unary(Parser *p) {
@@ -417,7 +628,7 @@ static Filter *parse_unary(Parser *p) {
     return parse_primary(p);
   }
   Filter *operand = parse_unary(p);
-  return not_filter(operand ? operand : make_filter(FILTER_NONE));
+  return not_filter(operand ? operand : new_filter(p, FILTER_NONE));
 }
 
 static Filter *parse_and(Parser *p) {
@@ -429,7 +640,7 @@ static Filter *parse_and(Parser *p) {
       break;
     }
     Filter *right = parse_unary(p);
-    left = and_filter(left, right ? right : make_filter(FILTER_NONE));
+    left = and_filter(left, right ? right : new_filter(p, FILTER_NONE));
   }
   return left;
 }
@@ -443,18 +654,22 @@ static Filter *parse_or(Parser *p) {
       break;
     }
     Filter *right = parse_and(p);
-    left = or_filter(left, right ? right : make_filter(FILTER_NONE));
+    left = or_filter(left, right ? right : new_filter(p, FILTER_NONE));
   }
   return left;
 }
 
 static Filter *parse_expr(Parser *p) { return parse_or(p); }
 
-Filter *parse_filter(const char *filter_str) {
-  size_t len = strlen(filter_str);
-  if (!filter_str || len == 0) {
-    return make_filter(FILTER_NONE);
+Filter *parse_filter_in(FilterArena *arena, const char *filter_str) {
+  size_t len = filter_str ? strlen(filter_str) : 0;
+  if (len == 0) {
+    return make_filter_in(arena, FILTER_NONE);
   }
-  Parser parser = {filter_str, 0, len};
+  Parser parser = {filter_str, 0, len, arena};
   return parse_expr(&parser);
 }
+
+Filter *parse_filter(const char *filter_str) {
+  return parse_filter_in(NULL, filter_str);
+}
@@ -6,8 +6,10 @@ typedef struct {
   const char *s;
   size_t pos;
   size_t len;
+  FilterArena *arena; // where nodes are allocated, NULL for malloc
 } Parser;
 
 Filter *parse_filter(const char *filter_str);
+Filter *parse_filter_in(FilterArena *arena, const char *filter_str);
 
 #endif // PARSER_H
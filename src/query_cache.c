@@ -0,0 +1,339 @@
+#include "query_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *copy_string(const char *s) {
+  size_t len = strlen(s);
+  char *out = malloc(len + 1);
+  if (out) {
+    memcpy(out, s, len + 1);
+  }
+  return out;
+}
+
+static char *leaf_key(const Filter *filter) {
+  char buf[64];
+  switch (filter->type) {
+  case FILTER_DAY_OF_WEEK:
+    snprintf(buf, sizeof(buf), "d%d", filter->data.day_of_week);
+    break;
+  case FILTER_DAY_MASK:
+    snprintf(buf, sizeof(buf), "m%02x", filter->data.day_mask);
+    break;
+  case FILTER_HOLIDAY:
+    snprintf(buf, sizeof(buf), "h");
+    break;
+  case FILTER_AFTER_DATETIME:
+    snprintf(buf, sizeof(buf), "a%lld", (long long)filter->data.time_value);
+    break;
+  case FILTER_BEFORE_DATETIME:
+    snprintf(buf, sizeof(buf), "b%lld", (long long)filter->data.time_value);
+    break;
+  case FILTER_AFTER_TIME:
+    snprintf(buf, sizeof(buf), "A%lld", (long long)filter->data.seconds);
+    break;
+  case FILTER_BEFORE_TIME:
+    snprintf(buf, sizeof(buf), "B%lld", (long long)filter->data.seconds);
+    break;
+  case FILTER_TIME_WINDOW:
+    snprintf(buf, sizeof(buf), "w%lld-%lld",
+             (long long)filter->data.window.start,
+             (long long)filter->data.window.end);
+    break;
+  case FILTER_MIN_DISTANCE:
+    snprintf(buf, sizeof(buf), "s%d", filter->data.minutes);
+    break;
+  case FILTER_MONTH_MASK:
+    snprintf(buf, sizeof(buf), "M%03x", filter->data.month_mask);
+    break;
+  case FILTER_MONTH_DAYS:
+    snprintf(buf, sizeof(buf), "D%08x", filter->data.month_days);
+    break;
+  case FILTER_NTH_WEEKDAY:
+    snprintf(buf, sizeof(buf), "n%d.%d", filter->data.nth.week,
+             filter->data.nth.day_of_week);
+    break;
+  case FILTER_DATE_RANGE:
+    snprintf(buf, sizeof(buf), "r%lld-%lld",
+             (long long)filter->data.range.start,
+             (long long)filter->data.range.end);
+    break;
+  default: // FILTER_NONE
+    snprintf(buf, sizeof(buf), "*");
+    break;
+  }
+  return copy_string(buf);
+}
+
+// Number of operands of a chain of `type` nodes
+static size_t count_operands(const Filter *filter, const FilterType type) {
+  if (filter && filter->type == type) {
+    return count_operands(filter->data.logical.left, type) +
+           count_operands(filter->data.logical.right, type);
+  }
+  return 1;
+}
+
+static void collect_operands(const Filter *filter, const FilterType type,
+                             const Filter **out, size_t *count) {
+  if (filter && filter->type == type) {
+    collect_operands(filter->data.logical.left, type, out, count);
+    collect_operands(filter->data.logical.right, type, out, count);
+    return;
+  }
+  out[(*count)++] = filter;
+}
+
+static int compare_keys(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Key of an AND/OR chain: its operands' keys sorted, so operand order and
+// grouping do not matter
+static char *chain_key(const Filter *filter) {
+  const FilterType type = filter->type;
+  size_t count = count_operands(filter, type);
+  const Filter **operands = malloc(count * sizeof(Filter *));
+  char **keys = calloc(count, sizeof(char *));
+  size_t n = 0;
+  bool ok = operands && keys;
+  if (ok) {
+    collect_operands(filter, type, operands, &n);
+  }
+  size_t len = 3; // operator and parentheses
+  for (size_t i = 0; ok && i < n; i++) {
+    keys[i] = filter_key(operands[i]);
+    ok = keys[i] != NULL;
+    len += ok ? strlen(keys[i]) + 1 : 0;
+  }
+  char *out = ok ? malloc(len + 1) : NULL;
+  if (out) {
+    qsort(keys, n, sizeof(char *), compare_keys);
+    char *p = out;
+    *p++ = type == FILTER_AND ? '&' : '|';
+    *p++ = '(';
+    for (size_t i = 0; i < n; i++) {
+      size_t key_len = strlen(keys[i]);
+      memcpy(p, keys[i], key_len);
+      p += key_len;
+      *p++ = i + 1 < n ? ',' : ')';
+    }
+    *p = '\0';
+  }
+  for (size_t i = 0; keys && i < n; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+  free(operands);
+  return out;
+}
+
+char *filter_key(const Filter *filter) {
+  if (!filter) {
+    return copy_string("*");
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return chain_key(filter);
+  case FILTER_NOT: {
+    char *operand = filter_key(filter->data.operand);
+    if (!operand) {
+      return NULL;
+    }
+    size_t len = strlen(operand);
+    char *out = malloc(len + 4);
+    if (out) {
+      snprintf(out, len + 4, "!(%s)", operand);
+    }
+    free(operand);
+    return out;
+  }
+  default:
+    return leaf_key(filter);
+  }
+}
+
+// Returns true if any node of the filter has the given type
+static bool filter_uses(const Filter *filter, const FilterType type) {
+  if (!filter) {
+    return false;
+  }
+  if (filter->type == type) {
+    return true;
+  }
+  switch (filter->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return filter_uses(filter->data.logical.left, type) ||
+           filter_uses(filter->data.logical.right, type);
+  case FILTER_NOT:
+    return filter_uses(filter->data.operand, type);
+  default:
+    return false;
+  }
+}
+
+QueryCache *create_query_cache(const size_t capacity) {
+  if (capacity == 0) {
+    return NULL;
+  }
+  QueryCache *cache = calloc(1, sizeof(QueryCache));
+  if (!cache) {
+    return NULL;
+  }
+  cache->entries = calloc(capacity, sizeof(QueryCacheEntry));
+  if (!cache->entries) {
+    free(cache);
+    return NULL;
+  }
+  cache->capacity = capacity;
+  return cache;
+}
+
+// FNV-1a over the key, mixed with the duration and start bucket
+static size_t entry_index(const QueryCache *cache, const char *key,
+                          const time_t duration, const time_t bucket) {
+  unsigned long long hash = 1469598103934665603ULL;
+  for (const char *p = key; *p; p++) {
+    hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+  }
+  hash = (hash ^ (unsigned long long)duration) * 1099511628211ULL;
+  hash = (hash ^ (unsigned long long)bucket) * 1099511628211ULL;
+  return (size_t)(hash % cache->capacity);
+}
+
+static unsigned long event_generation(const Calendar *calendar) {
+  return calendar ? calendar->generation : 0;
+}
+
+static unsigned long holiday_generation(const Calendar *calendar) {
+  return calendar ? calendar->holiday_generation : 0;
+}
+
+static bool lookup_result(const QueryCache *cache, const Calendar *calendar,
+                          const char *key, const time_t start,
+                          const time_t duration, time_t *result) {
+  const time_t bucket = start / QUERY_CACHE_BUCKET;
+  const QueryCacheEntry *e =
+      &cache->entries[entry_index(cache, key, duration, bucket)];
+  if (!e->key || e->duration != duration || e->bucket != bucket ||
+      strcmp(e->key, key) != 0) {
+    return false;
+  }
+  if ((e->uses_events && e->generation != event_generation(calendar)) ||
+      (e->uses_holidays &&
+       e->holiday_generation != holiday_generation(calendar))) {
+    return false; // Stale
+  }
+  // Nothing valid in [e->start, e->result), so the same answer holds for
+  // any start in that range
+  if (start < e->start || (e->result != -1 && start > e->result)) {
+    return false;
+  }
+  *result = e->result;
+  return true;
+}
+
+// Stores a result, taking ownership of the key
+static void store_result(QueryCache *cache, const Calendar *calendar,
+                         const Filter *filter, char *key, const time_t start,
+                         const time_t duration, const time_t result) {
+  const time_t bucket = start / QUERY_CACHE_BUCKET;
+  QueryCacheEntry *e =
+      &cache->entries[entry_index(cache, key, duration, bucket)];
+  free(e->key);
+  e->key = key;
+  e->duration = duration;
+  e->bucket = bucket;
+  e->start = start;
+  e->result = result;
+  e->uses_events = filter_uses(filter, FILTER_MIN_DISTANCE);
+  e->uses_holidays = filter_uses(filter, FILTER_HOLIDAY);
+  e->generation = event_generation(calendar);
+  e->holiday_generation = holiday_generation(calendar);
+}
+
+// For an AND with operands that ignore events, returns the first time from
+// start at which all of those hold, or -1 if they never do. Their result
+// survives event edits, and the full filter cannot be valid any earlier.
+static time_t independent_start(QueryCache *cache, const Calendar *calendar,
+                                const Filter *filter, const time_t start,
+                                const time_t duration) {
+  size_t count = count_operands(filter, FILTER_AND);
+  const Filter **operands = malloc(count * sizeof(Filter *));
+  Filter *links = malloc(count * sizeof(Filter));
+  if (!operands || !links) {
+    free(operands);
+    free(links);
+    return start;
+  }
+  size_t n = 0;
+  collect_operands(filter, FILTER_AND, operands, &n);
+
+  // Chain the independent operands with temporary AND nodes
+  Filter *chain = NULL;
+  size_t used = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (filter_uses(operands[i], FILTER_MIN_DISTANCE)) {
+      continue;
+    }
+    if (!chain) {
+      chain = (Filter *)operands[i];
+      continue;
+    }
+    Filter *link = &links[used++];
+    link->type = FILTER_AND;
+    link->arena = NULL;
+    link->data.logical.left = chain;
+    link->data.logical.right = (Filter *)operands[i];
+    chain = link;
+  }
+  time_t first = start;
+  if (chain) {
+    first = cached_find_optimal_time(cache, calendar, chain, start, duration);
+  }
+  free(operands);
+  free(links);
+  return first;
+}
+
+time_t cached_find_optimal_time(QueryCache *cache, const Calendar *calendar,
+                                const Filter *filter, const time_t start_time,
+                                const time_t duration) {
+  if (!cache) {
+    return find_optimal_time(calendar, filter, start_time, duration);
+  }
+  char *key = filter_key(filter);
+  if (!key) {
+    return find_optimal_time(calendar, filter, start_time, duration);
+  }
+  time_t result;
+  if (lookup_result(cache, calendar, key, start_time, duration, &result)) {
+    cache->hits++;
+    free(key);
+    return result;
+  }
+  cache->misses++;
+
+  time_t from = start_time;
+  if (filter && filter->type == FILTER_AND &&
+      filter_uses(filter, FILTER_MIN_DISTANCE)) {
+    from = independent_start(cache, calendar, filter, start_time, duration);
+  }
+  result =
+      from == -1 ? -1 : find_optimal_time(calendar, filter, from, duration);
+  store_result(cache, calendar, filter, key, start_time, duration, result);
+  return result;
+}
+
+void free_query_cache(QueryCache *cache) {
+  if (!cache)
+    return;
+  for (size_t i = 0; i < cache->capacity; i++) {
+    free(cache->entries[i].key);
+  }
+  free(cache->entries);
+  free(cache);
+}
@@ -0,0 +1,59 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include "calendar.h"
+#include "filter.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Result cache for repeated slot searches.
+//
+// Entries are keyed on a canonical form of the filter (AND/OR operands
+// flattened and sorted, so `a and b` and `b and a` share an entry), the
+// duration and the start time's QUERY_CACHE_BUCKET-second bucket. A result
+// found from start s0 also answers any later start s with s0 <= s <= result.
+//
+// Each entry records the calendar generations it was computed at. Only
+// filters that look at events (`spaced`) are invalidated by event edits and
+// only filters with `holidays` by a new holiday set, so purely periodic
+// filters stay cached across edits. For an AND whose operands are partly
+// calendar independent, the independent part is cached on its own and its
+// first valid time is where the full search starts after an edit.
+
+#define QUERY_CACHE_BUCKET (15 * 60)
+
+typedef struct QueryCacheEntry {
+  char *key; // canonical filter, NULL if the slot is empty
+  time_t duration;
+  time_t bucket;
+  time_t start;
+  time_t result;
+  bool uses_events;
+  bool uses_holidays;
+  unsigned long generation;
+  unsigned long holiday_generation;
+} QueryCacheEntry;
+
+typedef struct QueryCache {
+  QueryCacheEntry *entries; // direct mapped
+  size_t capacity;
+  unsigned long hits;
+  unsigned long misses;
+} QueryCache;
+
+// Creates a cache with room for `capacity` results. Returns NULL on failure.
+QueryCache *create_query_cache(const size_t capacity);
+
+// Same result as find_optimal_time, answered from the cache when possible
+time_t cached_find_optimal_time(QueryCache *cache, const Calendar *calendar,
+                                const Filter *filter, const time_t start_time,
+                                const time_t duration);
+
+// Returns a newly allocated canonical string for the filter, or NULL on
+// allocation failure
+char *filter_key(const Filter *filter);
+
+void free_query_cache(QueryCache *cache);
+
+#endif // QUERY_CACHE_H
@@ -0,0 +1,302 @@
+#include "scheduler.h"
+#include "interval.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const Calendar *calendar;
+  const ScheduleRequest *requests;
+  const size_t *order; // requests to place, highest priority first
+  size_t count;
+  time_t start;
+  time_t horizon;
+  unsigned backtracks_left;
+  IntervalSet placed; // sorted and disjoint, one interval per meeting
+  time_t *starts;
+} ScheduleState;
+
+// Index of the first placed meeting that ends after t
+static size_t first_ending_after(const IntervalSet *placed, const time_t t) {
+  size_t lo = 0;
+  size_t hi = placed->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (placed->items[mid].end > t) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+static bool add_placement(IntervalSet *placed, const time_t start,
+                          const time_t end) {
+  if (placed->count == placed->capacity) {
+    size_t capacity = placed->capacity ? placed->capacity * 2 : 16;
+    Interval *items = realloc(placed->items, capacity * sizeof(Interval));
+    if (!items) {
+      return false;
+    }
+    placed->items = items;
+    placed->capacity = capacity;
+  }
+  size_t at = first_ending_after(placed, start);
+  memmove(&placed->items[at + 1], &placed->items[at],
+          (placed->count - at) * sizeof(Interval));
+  placed->items[at].start = start;
+  placed->items[at].end = end;
+  placed->count++;
+  return true;
+}
+
+static void remove_placement(IntervalSet *placed, const time_t start) {
+  size_t at = first_ending_after(placed, start);
+  if (at < placed->count && placed->items[at].start == start) {
+    memmove(&placed->items[at], &placed->items[at + 1],
+            (placed->count - at - 1) * sizeof(Interval));
+    placed->count--;
+  }
+}
+
+// Seconds the filter always keeps between a slot and the events around it:
+// the largest MIN_DISTANCE that every valid time must pass, 0 if none
+static time_t required_spacing(const Filter *filter) {
+  if (!filter) {
+    return 0;
+  }
+  switch (filter->type) {
+  case FILTER_MIN_DISTANCE:
+    return filter->data.minutes > 0 ? (time_t)filter->data.minutes * 60 : 0;
+  case FILTER_AND: {
+    time_t left = required_spacing(filter->data.logical.left);
+    time_t right = required_spacing(filter->data.logical.right);
+    return left > right ? left : right;
+  }
+  default:
+    return 0;
+  }
+}
+
+// Earliest start >= from that satisfies the request's filter and overlaps
+// no placed meeting: each search that lands on a meeting resumes after it.
+// The filter's spacing only sees calendar events, so placed meetings are
+// kept that far away here, as if each had been added to the calendar.
+static time_t next_free_slot(const ScheduleState *state,
+                             const ScheduleRequest *request, time_t from) {
+  SearchOptions options = {.horizon = state->horizon};
+  const time_t pad = required_spacing(request->filter);
+  while (true) {
+    time_t slot = search_optimal_time(state->calendar, request->filter, from,
+                                      request->duration, &options, NULL);
+    if (slot == -1) {
+      return -1;
+    }
+    size_t at = first_ending_after(&state->placed, slot - pad);
+    if (at == state->placed.count ||
+        state->placed.items[at].start >= slot + request->duration + pad) {
+      return slot;
+    }
+    from = state->placed.items[at].end + pad;
+  }
+}
+
+// Places requests k.. of the order, moving earlier ones to their next
+// alternative while backtracks are left. Returns true if all of them fit.
+static bool place_from(ScheduleState *state, const size_t k) {
+  if (k == state->count) {
+    return true;
+  }
+  const size_t i = state->order[k];
+  const ScheduleRequest *request = &state->requests[i];
+  time_t from = state->start;
+  while (true) {
+    time_t slot = next_free_slot(state, request, from);
+    if (slot == -1 ||
+        !add_placement(&state->placed, slot, slot + request->duration)) {
+      return false;
+    }
+    state->starts[i] = slot;
+    if (place_from(state, k + 1)) {
+      return true;
+    }
+    remove_placement(&state->placed, slot);
+    state->starts[i] = -1;
+    if (state->backtracks_left == 0) {
+      return false;
+    }
+    state->backtracks_left--;
+    // The next alternative no longer overlaps this one
+    from = slot + request->duration;
+  }
+}
+
+// Places each request at its earliest slot, leaving out those that do not
+// fit
+static size_t place_greedy(ScheduleState *state) {
+  size_t placed = 0;
+  for (size_t k = 0; k < state->count; k++) {
+    const size_t i = state->order[k];
+    const ScheduleRequest *request = &state->requests[i];
+    time_t slot = next_free_slot(state, request, state->start);
+    if (slot != -1 &&
+        add_placement(&state->placed, slot, slot + request->duration)) {
+      state->starts[i] = slot;
+      placed++;
+    }
+  }
+  return placed;
+}
+
+size_t schedule_requests(const Calendar *calendar,
+                         const ScheduleRequest *requests, const size_t count,
+                         const time_t start_time,
+                         const ScheduleOptions *options, time_t *starts) {
+  for (size_t i = 0; i < count; i++) {
+    starts[i] = -1;
+  }
+  size_t *order = malloc((count ? count : 1) * sizeof(size_t));
+  if (!order) {
+    return 0;
+  }
+  // Stable insertion sort by descending priority
+  size_t valid = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (requests[i].duration <= 0) {
+      continue;
+    }
+    size_t j = valid++;
+    for (; j > 0 && requests[order[j - 1]].priority < requests[i].priority;
+         j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  ScheduleState state = {calendar,
+                         requests,
+                         order,
+                         valid,
+                         start_time,
+                         options ? options->horizon : 0,
+                         options ? options->max_backtracks : 0,
+                         {NULL, 0, 0},
+                         starts};
+  // Requests that do not fit even alone would only use up backtracks
+  size_t viable = 0;
+  for (size_t k = 0; k < valid; k++) {
+    if (next_free_slot(&state, &requests[order[k]], start_time) != -1) {
+      order[viable++] = order[k];
+    }
+  }
+  state.count = viable;
+  size_t placed = viable;
+  if (!place_from(&state, 0)) {
+    // Some request cannot fit next to the others: keep the greedy result
+    for (size_t i = 0; i < count; i++) {
+      starts[i] = -1;
+    }
+    state.placed.count = 0;
+    placed = place_greedy(&state);
+  }
+  free_interval_set(&state.placed);
+  free(order);
+  return placed;
+}
+
+// Strips leading and trailing whitespace in place
+static char *trim(char *s) {
+  while (*s == ' ' || *s == '\t') {
+    s++;
+  }
+  size_t len = strlen(s);
+  while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t' ||
+                     s[len - 1] == '\n' || s[len - 1] == '\r')) {
+    s[--len] = '\0';
+  }
+  return s;
+}
+
+static bool parse_request(char *line, ScheduleRequest *request) {
+  char *fields[4];
+  fields[0] = line;
+  for (int f = 1; f < 4; f++) {
+    char *bar = strchr(fields[f - 1], '|');
+    if (!bar) {
+      return false;
+    }
+    *bar = '\0';
+    fields[f] = bar + 1;
+  }
+  char *end;
+  long minutes = strtol(fields[1], &end, 10);
+  if (end == fields[1] || *trim(end) != '\0' || minutes <= 0) {
+    return false;
+  }
+  long priority = strtol(fields[2], &end, 10);
+  if (end == fields[2] || *trim(end) != '\0') {
+    return false;
+  }
+  const char *title = trim(fields[0]);
+  request->title = malloc(strlen(title) + 1);
+  if (!request->title) {
+    return false;
+  }
+  strcpy(request->title, title);
+  request->filter = optimize_filter(parse_filter(trim(fields[3])));
+  request->duration = (time_t)minutes * 60;
+  request->priority = (int)priority;
+  return true;
+}
+
+ScheduleRequest *read_schedule_requests(const char *filename, size_t *count) {
+  *count = 0;
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    return NULL;
+  }
+  size_t capacity = 8;
+  size_t n = 0;
+  ScheduleRequest *requests = malloc(capacity * sizeof(ScheduleRequest));
+  bool ok = requests != NULL;
+  size_t line_number = 0;
+  char line[1024];
+  while (ok && fgets(line, sizeof(line), file)) {
+    line_number++;
+    char *p = trim(line);
+    if (*p == '#' || *p == '\0') {
+      continue;
+    }
+    if (n == capacity) {
+      capacity *= 2;
+      ScheduleRequest *grown =
+          realloc(requests, capacity * sizeof(ScheduleRequest));
+      if (!grown) {
+        ok = false;
+        break;
+      }
+      requests = grown;
+    }
+    ok = parse_request(p, &requests[n]);
+    n += ok;
+  }
+  fclose(file);
+  if (!ok) {
+    free_schedule_requests(requests, n);
+    *count = line_number;
+    return NULL;
+  }
+  *count = n;
+  return requests;
+}
+
+void free_schedule_requests(ScheduleRequest *requests, const size_t count) {
+  if (!requests)
+    return;
+  for (size_t i = 0; i < count; i++) {
+    free(requests[i].title);
+    destroy_filter(requests[i].filter);
+  }
+  free(requests);
+}
@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "calendar.h"
+#include "filter.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+// Batch scheduling of several meetings in one pass.
+//
+// Requests are placed greedily, highest priority first, each at the earliest
+// start that satisfies its filter and does not overlap the meetings placed
+// before it; a filter's `spaced` distance is kept from those meetings too,
+// as from calendar events. The placed meetings are kept as a sorted list of
+// busy intervals that every search jumps over, so nothing is added to the
+// calendar until the caller decides to. If a request does not fit, earlier
+// placements can be moved to their next alternative (bounded backtracking)
+// to make room.
+
+// One meeting to place
+typedef struct ScheduleRequest {
+  char *title;          // owned when read with read_schedule_requests
+  Filter *filter;       // NULL accepts any time
+  time_t duration;      // seconds; must be positive
+  int priority;         // higher is placed first; ties keep input order
+} ScheduleRequest;
+
+// Limits for schedule_requests; zero fields mean no limit (or, for
+// max_backtracks, a plain greedy pass)
+typedef struct ScheduleOptions {
+  time_t horizon;          // latest start time considered
+  unsigned max_backtracks; // earlier placements moved in total
+} ScheduleOptions;
+
+// Places the requests non-overlapping, starting no earlier than start_time.
+// starts[i] receives the start of requests[i], or -1 if it could not be
+// placed. Returns the number of requests placed.
+//
+// Requests with no valid slot at all are left out first. If the greedy
+// pass then leaves a request out, up to max_backtracks earlier placements
+// are moved to later alternatives to try to fit every request; when that
+// fails too, the greedy placement is kept.
+size_t schedule_requests(const Calendar *calendar,
+                         const ScheduleRequest *requests, const size_t count,
+                         const time_t start_time,
+                         const ScheduleOptions *options, time_t *starts);
+
+// Reads requests from a file, one per line as
+//   title | duration in minutes | priority | filter
+// Blank lines and lines starting with '#' are skipped. Returns NULL (with
+// *count set to the offending line, or 0 if the file could not be read)
+// on error.
+ScheduleRequest *read_schedule_requests(const char *filename, size_t *count);
+
+void free_schedule_requests(ScheduleRequest *requests, const size_t count);
+
+#endif // SCHEDULER_H
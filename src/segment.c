@@ -0,0 +1,151 @@
+#include "segment.h"
+#include "archive.h"
+#include "calendar.h"
+#include "event_list.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#define SEGMENT_PATH_MAX 4096
+
+static void segment_path(char *out, const char *directory, const unsigned year,
+                         const char *extension) {
+  snprintf(out, SEGMENT_PATH_MAX, "%s/%u.%s", directory, year, extension);
+}
+
+static bool make_directory(const char *directory) {
+#ifdef _WIN32
+  int rc = _mkdir(directory);
+#else
+  int rc = mkdir(directory, 0755);
+#endif
+  return rc == 0 || errno == EEXIST;
+}
+
+// Loads one `<year>.seg` file and marks its year clean
+static bool load_segment(Calendar *calendar, const char *path,
+                         const unsigned year) {
+  EventList *segment = create_event_list();
+  if (!segment) {
+    return false;
+  }
+  bool ok = load_events(segment, path);
+  Event *chain = segment->head;
+  free(segment); // The events now belong to the calendar
+  attach_calendar_events(calendar, chain);
+  calendar->generation++;
+  YearBucket *bucket = get_year_bucket(calendar, year);
+  if (bucket) {
+    bucket->dirty = false;
+  }
+  return ok;
+}
+
+bool load_calendar_segments(Calendar *calendar, const char *directory) {
+  if (!calendar || !calendar->event_list || !directory) {
+    return false;
+  }
+  DIR *dir = opendir(directory);
+  if (!dir) {
+    return false;
+  }
+  char path[SEGMENT_PATH_MAX];
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    unsigned year;
+    char extension[8];
+    int consumed = 0;
+    if (sscanf(entry->d_name, "%u.%7s%n", &year, extension, &consumed) != 2 ||
+        entry->d_name[consumed] != '\0') {
+      continue; // Not a segment; also skips leftover `.tmp` files
+    }
+    snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+    if (strcmp(extension, "seg") == 0) {
+      load_segment(calendar, path, year);
+    } else if (strcmp(extension, "cala") == 0) {
+      attach_year_archive(calendar, path);
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+// Writes the events of `year` to path via a temporary file and rename, or
+// removes path if the year has no events left
+static bool write_segment(const Calendar *calendar, const unsigned year,
+                          const char *path) {
+  Event *first = get_first_event_of_year(calendar, year);
+  if (!first) {
+    return remove(path) == 0 || errno == ENOENT;
+  }
+  char tmp[SEGMENT_PATH_MAX + 4];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *file = fopen(tmp, "w");
+  if (!file) {
+    return false;
+  }
+  const time_t year_end = year_start_time(year + 1);
+  for (Event *e = first; e && e->start_time < year_end; e = e->next) {
+    write_event(file, e);
+  }
+  bool ok = !ferror(file);
+  ok = (fclose(file) == 0) && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) {
+    remove(tmp);
+  }
+  return ok;
+}
+
+bool save_calendar_segments(Calendar *calendar, const char *directory) {
+  if (!calendar || !calendar->event_list || !directory) {
+    return false;
+  }
+  if (!make_directory(directory)) {
+    return false;
+  }
+  bool ok = true;
+  char path[SEGMENT_PATH_MAX];
+  for (YearBucket *bucket = calendar->years; bucket; bucket = bucket->next) {
+    if (!bucket->dirty) {
+      continue;
+    }
+    bool written;
+    YearArchive *archive = get_year_archive(calendar, bucket->year);
+    if (archive) {
+      written = get_first_event_of_year(calendar, bucket->year)
+                    ? write_year_archive(calendar, bucket->year, archive->path)
+                    : remove(archive->path) == 0;
+    } else {
+      segment_path(path, directory, bucket->year, "seg");
+      written = write_segment(calendar, bucket->year, path);
+    }
+    if (written) {
+      bucket->dirty = false;
+    }
+    ok = ok && written;
+  }
+  return ok;
+}
+
+bool archive_segment_year(Calendar *calendar, const char *directory,
+                          const unsigned year) {
+  if (!calendar || !directory) {
+    return false;
+  }
+  ensure_year_loaded(calendar, year);
+  char path[SEGMENT_PATH_MAX];
+  segment_path(path, directory, year, "cala");
+  if (!archive_calendar_year(calendar, year, path)) {
+    return false;
+  }
+  segment_path(path, directory, year, "seg");
+  remove(path);
+  return true;
+}
@@ -0,0 +1,29 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "calendar.h"
+#include <stdbool.h>
+
+// Per-year storage layout: a directory holding one segment file per year,
+// `<year>.seg` in the same `id|title|description|start|end` line format as
+// save_events, or a compressed `<year>.cala` archive (see archive.h).
+//
+// Year buckets are marked dirty when they gain or lose events, so a save only
+// rewrites the years that changed since the last load or save.
+
+// Loads every segment in the directory and registers its archives.
+// Returns false if the directory cannot be read.
+bool load_calendar_segments(Calendar *calendar, const char *directory);
+
+// Rewrites the segment of every dirty year, each atomically via a temporary
+// file and rename, and clears the dirty flags. A dirty year that is archived
+// has its archive re-encoded instead. Years left with no events have their
+// file removed. Creates the directory if needed.
+bool save_calendar_segments(Calendar *calendar, const char *directory);
+
+// Moves `year` from its segment file into a compressed archive in the same
+// directory; the year is decoded again on first use.
+bool archive_segment_year(Calendar *calendar, const char *directory,
+                          const unsigned year);
+
+#endif // SEGMENT_H
@@ -1,7 +1,18 @@
+#include "test_archive.h"
+#include "test_batch.h"
 #include "test_calendar.h"
 #include "test_event_list.h"
 #include "test_filter.h"
+#include "test_gap_index.h"
+#include "test_holiday.h"
+#include "test_ics.h"
+#include "test_interval.h"
+#include "test_journal.h"
+#include "test_parallel_search.h"
 #include "test_parse.h"
+#include "test_query_cache.h"
+#include "test_scheduler.h"
+#include "test_segment.h"
 #include <stdio.h>
 
 static unsigned assertions = 0;
@@ -32,6 +43,17 @@ int main() {
   run_filter_tests();
   run_event_list_tests();
   run_parse_tests();
+  run_archive_tests();
+  run_segment_tests();
+  run_ics_tests();
+  run_journal_tests();
+  run_interval_tests();
+  run_batch_tests();
+  run_holiday_tests();
+  run_query_cache_tests();
+  run_parallel_search_tests();
+  run_gap_index_tests();
+  run_scheduler_tests();
 
   printf("Out of %u assertions, %u failed\n", assertions, failures);
   printf("Success rate: %.2f%%\n",
@@ -0,0 +1,132 @@
+#ifndef TEST_ARCHIVE_H
+#define TEST_ARCHIVE_H
+
+#include "../src/archive.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t ta_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static long ta_file_size(const char *filename) {
+  FILE *file = fopen(filename, "rb");
+  if (!file) {
+    return -1;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// 1) archiving a year drops it from memory and decodes it on first query
+static void test_archive_year_lazy_decode(void) {
+  const char *fname = "test_archive_2015.cala";
+  Calendar *cal = create_calendar();
+  Event *old = add_event_calendar(cal, "Standup", "daily",
+                                  ta_mktime(2015, 3, 2, 9, 0),
+                                  ta_mktime(2015, 3, 2, 9, 15));
+  EventID old_id = old->id;
+  add_event_calendar(cal, "Retro", "", ta_mktime(2015, 3, 6, 16, 0),
+                     ta_mktime(2015, 3, 6, 17, 0));
+  Event *recent = add_event_calendar(cal, "Planning", "",
+                                     ta_mktime(2025, 1, 6, 10, 0),
+                                     ta_mktime(2025, 1, 6, 11, 0));
+
+  expect(archive_calendar_year(cal, 2015, fname),
+         "archive_calendar_year should succeed");
+  expect(cal->event_list->head == recent,
+         "archived year should no longer be in memory");
+  expect(cal->archives && !cal->archives->resident,
+         "archive should be registered but not resident");
+
+  Event *first = get_first_event(cal, 2015, 3, 2);
+  expect(first != NULL && strcmp(first->title, "Standup") == 0,
+         "query on archived year should decode it");
+  expect(first != NULL && first->id == old_id,
+         "decoded event should keep its id");
+  expect(first != NULL &&
+             first->end_time - first->start_time == 15 * 60,
+         "decoded event should keep its duration");
+  expect(first != NULL && strcmp(first->description, "daily") == 0,
+         "decoded event should keep its description");
+  expect(cal->event_list->tail == recent,
+         "decoded events should be merged before later years");
+
+  free_calendar(cal);
+  remove(fname);
+}
+
+// 2) attached archives are found by ordered queries and id lookups
+static void test_attach_archive_queries(void) {
+  const char *fname = "test_archive_2016.cala";
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Offsite", "", ta_mktime(2016, 6, 1, 9, 0),
+                     ta_mktime(2016, 6, 1, 17, 0));
+  write_year_archive(cal, 2016, fname);
+  free_calendar(cal);
+
+  Calendar *fresh = create_calendar();
+  add_event_calendar(fresh, "Kickoff", "", ta_mktime(2025, 2, 3, 9, 0),
+                     ta_mktime(2025, 2, 3, 10, 0));
+  expect(attach_year_archive(fresh, fname), "attach_year_archive succeeds");
+  expect(fresh->archives && fresh->archives->year == 2016,
+         "attached archive should record its year from the header");
+
+  Event *before = get_event_on_or_before(fresh, ta_mktime(2020, 1, 1, 0, 0));
+  expect(before != NULL && strcmp(before->title, "Offsite") == 0,
+         "get_event_on_or_before should decode an earlier archived year");
+  free_calendar(fresh);
+
+  Calendar *by_id = create_calendar();
+  attach_year_archive(by_id, fname);
+  Event *removed = remove_event_calendar(by_id, 1);
+  expect(removed != NULL && strcmp(removed->title, "Offsite") == 0,
+         "remove_event_calendar should find events in archived years");
+  free(removed);
+  free_calendar(by_id);
+  remove(fname);
+}
+
+// 3) repeated strings are dictionary coded
+static void test_archive_is_compact(void) {
+  const char *fname = "test_archive_2017.cala";
+  Calendar *cal = create_calendar();
+  for (int day = 1; day <= 28; day++) {
+    add_event_calendar(cal, "Standup", "Daily team sync",
+                       ta_mktime(2017, 2, day, 9, 0),
+                       ta_mktime(2017, 2, day, 9, 15));
+  }
+  expect(write_year_archive(cal, 2017, fname), "write_year_archive succeeds");
+  long size = ta_file_size(fname);
+  // 28 events, each a handful of varint bytes plus one shared dictionary
+  expect(size > 0 && size < 28 * 12 + 64,
+         "archive should store repeated strings once");
+  expect(!write_year_archive(cal, 2018, "test_archive_empty.cala"),
+         "archiving a year without events should fail");
+  free_calendar(cal);
+  remove(fname);
+}
+
+static inline void run_archive_tests(void) {
+  puts("Running archive tests...");
+  test_archive_year_lazy_decode();
+  test_attach_archive_queries();
+  test_archive_is_compact();
+  puts("Archive tests completed.");
+}
+
+#endif // TEST_ARCHIVE_H
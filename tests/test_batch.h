@@ -0,0 +1,83 @@
+#ifndef TEST_BATCH_H
+#define TEST_BATCH_H
+
+#include "../src/batch.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tb_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static bool tb_bit(const uint64_t *bits, size_t i) {
+  return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+static void test_batch_matches_scalar(void) {
+  const char *inputs[] = {
+      "business_days and business_hours",
+      "not (weekend or holidays) and after 13:00",
+      "on Tuesday,Thursday and before 10:00 or on Saturday",
+      "after 2025-12-24 12:00 and before 2025-12-30",
+      "weekdays and spaced 30 minutes",
+      "not not holidays",
+      "first Monday or last Wednesday and in Dec",
+      "not days 1-10 and from 2025-12-08 to 2025-12-20",
+  };
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Sync", "", tb_mktime(2025, 12, 22, 9, 0),
+                     tb_mktime(2025, 12, 22, 12, 0));
+  add_event_calendar(cal, "Demo", "", tb_mktime(2025, 12, 26, 14, 0),
+                     tb_mktime(2025, 12, 26, 15, 0));
+
+  // Every 15 minutes of a month, not a multiple of 64
+  const size_t n = 31 * 96 - 5;
+  time_t *candidates = malloc(n * sizeof(time_t));
+  uint64_t *bits = malloc(BATCH_WORDS(n) * sizeof(uint64_t));
+  for (size_t i = 0; i < n; i++) {
+    candidates[i] = tb_mktime(2025, 12, 1, 0, 0) + (time_t)i * 15 * 60;
+  }
+  for (size_t f = 0; f < sizeof(inputs) / sizeof(inputs[0]); f++) {
+    for (int optimized = 0; optimized < 2; optimized++) {
+      Filter *filter = parse_filter(inputs[f]);
+      if (optimized) {
+        filter = optimize_filter(filter);
+      }
+      expect(evaluate_filter_batch(filter, candidates, n, 1800, cal, bits),
+             "evaluate_filter_batch succeeds");
+      size_t mismatches = 0;
+      for (size_t i = 0; i < n; i++) {
+        if (tb_bit(bits, i) !=
+            evaluate_filter(filter, candidates[i], 1800, cal)) {
+          mismatches++;
+        }
+      }
+      expect_eq((int)mismatches, 0, inputs[f]);
+      expect(!(bits[BATCH_WORDS(n) - 1] >> (n % 64)),
+             "bits past the last candidate stay clear");
+      destroy_filter(filter);
+    }
+  }
+  free(candidates);
+  free(bits);
+  free_calendar(cal);
+}
+
+static inline void run_batch_tests(void) {
+  puts("Running batch tests...");
+  test_batch_matches_scalar();
+  puts("Batch tests completed.");
+}
+
+#endif // TEST_BATCH_H
@@ -372,6 +372,28 @@ static void test_get_event_on_or_before(void) {
   free_calendar(cal);
 }
 
+// 21) loading an unsorted file still gives correct ordered queries
+static void test_load_unsorted_file_queries(void) {
+  const char *filename = "test_calendar_unsorted.dat";
+  FILE *file = fopen(filename, "w");
+  fprintf(file, "2|Later||%ld|%ld\n", (long)tca_mktime(2025, 10, 22, 15, 0),
+          (long)tca_mktime(2025, 10, 22, 16, 0));
+  fprintf(file, "1|Earlier||%ld|%ld\n", (long)tca_mktime(2025, 10, 22, 9, 0),
+          (long)tca_mktime(2025, 10, 22, 10, 0));
+  fclose(file);
+
+  Calendar *cal = create_calendar();
+  load_calendar_events(cal, filename);
+  Event *first = get_first_event(cal, 2025, 10, 22);
+  expect(first != NULL && strcmp(first->title, "Earlier") == 0,
+         "day bucket should point at the earliest event after sorting");
+  Event *before = get_event_on_or_before(cal, tca_mktime(2025, 10, 22, 12, 0));
+  expect(before != NULL && strcmp(before->title, "Earlier") == 0,
+         "get_event_on_or_before should see the sorted order");
+  free_calendar(cal);
+  remove(filename);
+}
+
 // Aggregate runner for all calendar tests
 static inline void run_calendar_tests(void) {
   puts("Running calendar tests...");
@@ -395,6 +417,7 @@ static inline void run_calendar_tests(void) {
   test_get_first_event_nonexistent_year();
   test_calendar_load_save_roundtrip();
   test_get_event_on_or_before();
+  test_load_unsorted_file_queries();
   puts("Calendar tests completed.");
 }
 
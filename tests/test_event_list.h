@@ -173,6 +173,40 @@ static void test_save_and_load_events_roundtrip(void) {
   remove(fname);
 }
 
+// 8) load_events sorts files that are out of order by start time, then id
+static void test_load_events_sorts_unsorted_file(void) {
+  const char *fname = "cal_test_unsorted.txt";
+  FILE *file = fopen(fname, "w");
+  // Two concatenated exports: ids 7 and 3 share a start time
+  fprintf(file, "5|E|late|%ld|%ld\n", (long)tc_mktime(2025, 3, 1, 9, 0),
+          (long)tc_mktime(2025, 3, 1, 10, 0));
+  fprintf(file, "7|C|tie|%ld|%ld\n", (long)tc_mktime(2024, 6, 1, 9, 0),
+          (long)tc_mktime(2024, 6, 1, 10, 0));
+  fprintf(file, "3|B|tie|%ld|%ld\n", (long)tc_mktime(2024, 6, 1, 9, 0),
+          (long)tc_mktime(2024, 6, 1, 10, 0));
+  fprintf(file, "1|A||%ld|%ld\n", (long)tc_mktime(1969, 12, 31, 12, 0),
+          (long)tc_mktime(1969, 12, 31, 13, 0));
+  fclose(file);
+
+  EventList *list = create_event_list();
+  load_events(list, fname);
+  const char *expected = "ABCE";
+  size_t i = 0;
+  bool links_ok = true;
+  for (Event *e = list->head; e; e = e->next, i++) {
+    expect(i < 4 && e->title[0] == expected[i],
+           "loaded events should be ordered by start time, then id");
+    links_ok = links_ok && (e->next ? e->next->parent == e : list->tail == e);
+  }
+  expect_eq(4, (int)i, "all events should be loaded");
+  expect(links_ok, "parent and tail links should follow the sorted order");
+  expect(list->head->parent == NULL, "head should have no parent");
+  expect_eq(8, (int)list->next_id, "next_id should follow the highest id");
+
+  destroy_event_list(list);
+  remove(fname);
+}
+
 // Aggregate runner
 static inline void run_event_list_tests(void) {
   puts("Running event list tests...");
@@ -183,6 +217,7 @@ static inline void run_event_list_tests(void) {
   test_remove_event_middle_node();
   test_find_event_by_id_finds_correct();
   test_save_and_load_events_roundtrip();
+  test_load_events_sorts_unsorted_file();
   puts("Event list tests completed.");
 }
 
@@ -4,6 +4,8 @@
 #include "../src/filter.c"
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 void expect(const bool condition, const char *message);
@@ -64,9 +66,10 @@ static void test_filter_day_of_week(void) {
   time_t tuesday = tf_mktime(2025, 10, 21, 9, 0);
   expect(!evaluate_filter(f, tuesday, 0, NULL),
          "FILTER_DAY_OF_WEEK does not match Tuesday");
-  // It's Tuesday 9:00. Next Monday is 6 days away.
-  // 6*24*60 - (9*60) = 8640 - 540 = 8100 minutes
-  expect_eq(until_valid(f, tuesday, 0, NULL), 8100 * 60,
+  // It's Tuesday 9:00. Next Monday starts 6 days later at midnight, which
+  // is 8100 minutes away unless the clocks change in between.
+  expect_eq(tuesday + until_valid(f, tuesday, 0, NULL),
+            tf_mktime(2025, 10, 27, 0, 0),
             "FILTER_DAY_OF_WEEK from Tuesday to Monday");
 
   destroy_filter(f);
@@ -120,7 +123,7 @@ static void test_filter_before_datetime(void) {
 
 static void test_filter_after_time(void) {
   Filter *f = make_filter(FILTER_AFTER_TIME);
-  f->data.time_value = tf_mktime(2025, 1, 1, 10, 0); // Date part is ignored
+  f->data.seconds = 10 * 60 * 60;
 
   time_t before = tf_mktime(2025, 10, 22, 9, 0);
   time_t equal = tf_mktime(2025, 10, 22, 10, 0);
@@ -141,7 +144,7 @@ static void test_filter_after_time(void) {
 
 static void test_filter_before_time(void) {
   Filter *f = make_filter(FILTER_BEFORE_TIME);
-  f->data.time_value = tf_mktime(2025, 1, 1, 12, 0); // Date part is ignored
+  f->data.seconds = 12 * 60 * 60;
 
   time_t before = tf_mktime(2025, 10, 22, 11, 0);
   time_t equal = tf_mktime(2025, 10, 22, 12, 0);
@@ -316,6 +319,23 @@ static void test_filter_not(void) {
   destroy_filter(notF);
 }
 
+// Switches the local time zone, saving the current TZ in `saved`
+static void tf_set_zone(const char *zone, char *saved, const size_t size) {
+  const char *current = getenv("TZ");
+  snprintf(saved, size, "%s", current ? current : "");
+  setenv("TZ", zone, 1);
+  tzset();
+}
+
+static void tf_restore_zone(const char *saved) {
+  if (*saved) {
+    setenv("TZ", saved, 1);
+  } else {
+    unsetenv("TZ");
+  }
+  tzset();
+}
+
 static void test_find_optimal_time(void) {
   Calendar *cal = create_calendar();
   add_event_calendar(cal, "Blocker", "", tf_mktime(2025, 11, 13, 10, 0),
@@ -323,7 +343,7 @@ static void test_find_optimal_time(void) {
 
   // Filter: After 9am, with 30min distance from events
   Filter *after9am = make_filter(FILTER_AFTER_TIME);
-  after9am->data.time_value = tf_mktime(2025, 1, 1, 9, 0);
+  after9am->data.seconds = 9 * 60 * 60;
   Filter *min_dist = make_filter(FILTER_MIN_DISTANCE);
   min_dist->data.minutes = 30;
   Filter *f = and_filter(after9am, min_dist);
@@ -349,7 +369,756 @@ static void test_find_optimal_time(void) {
   free_calendar(cal);
 }
 
+// Times of day on the days the clocks change, which are wall clock times
+// rather than offsets from midnight
+static void test_daylight_saving(void) {
+  char zone[64];
+  tf_set_zone("America/New_York", zone, sizeof(zone));
+  const time_t midnight = tf_mktime(2025, 3, 9, 0, 0);
+  Filter *f = parse_filter("after 09:00");
+  expect_time_eq(find_optimal_time(NULL, f, midnight, 0),
+                 tf_mktime(2025, 3, 9, 9, 0) + 1,
+                 "after 09:00 on a spring forward day");
+  destroy_filter(f);
+  f = parse_filter("before 09:00 and after 08:00");
+  const time_t one = tf_mktime(2025, 3, 9, 1, 0);
+  expect_time_eq(one + until_valid(f, one, 0, NULL),
+                 tf_mktime(2025, 3, 9, 8, 0) + 1,
+                 "after 08:00 and before 09:00 on a spring forward day");
+  const time_t nine = tf_mktime(2025, 3, 9, 9, 0);
+  expect(!evaluate_filter(f, nine, 0, NULL) &&
+             evaluate_filter(f, nine - 1, 0, NULL),
+         "before 09:00 ends at 09:00 by the clock");
+  destroy_filter(f);
+  f = optimize_filter(parse_filter("after 09:00 and before 17:00"));
+  const time_t saturday = tf_mktime(2025, 3, 8, 18, 0);
+  expect(f->type == FILTER_TIME_WINDOW &&
+             saturday + until_valid(f, saturday, 0, NULL) == nine &&
+             midnight + until_valid(f, midnight, 0, NULL) == nine,
+         "time window opens at 09:00 on a spring forward day");
+  expect(!evaluate_filter(f, tf_mktime(2025, 3, 9, 17, 0), 0, NULL) &&
+             evaluate_filter(f, tf_mktime(2025, 3, 9, 17, 0) - 1, 0, NULL),
+         "time window closes at 17:00 on a spring forward day");
+  destroy_filter(f);
+  // Compiled into a week mask
+  f = parse_filter("on Sunday and after 09:00 and before 17:00");
+  expect_time_eq(find_optimal_time(NULL, f, midnight, 0), nine,
+                 "week mask on a spring forward day");
+  destroy_filter(f);
+  f = parse_filter("business_hours");
+  expect_time_eq(find_optimal_time(NULL, f, midnight, 0), nine,
+                 "business hours on a spring forward day");
+  destroy_filter(f);
+  // 01:30 the second time round when the clocks fall back
+  const time_t repeated = tf_mktime(2025, 11, 2, 0, 0) + 150 * 60;
+  f = parse_filter("after 01:45");
+  expect_eq((int)until_valid(f, repeated, 0, NULL), 15 * 60 + 1,
+            "after 01:45 in the repeated hour");
+  destroy_filter(f);
+  f = parse_filter("on Sunday and after 01:45 and before 03:00");
+  expect_time_eq(find_optimal_time(NULL, f, repeated, 0),
+                 repeated + 15 * 60, "week mask in the repeated hour");
+  destroy_filter(f);
+  // A time the clocks skip over is reached when they do
+  const time_t jump = tf_mktime(2025, 3, 9, 3, 0);
+  f = parse_filter("after 02:30");
+  expect_time_eq(find_optimal_time(NULL, f, midnight, 0), jump + 1,
+                 "after a skipped time");
+  destroy_filter(f);
+  f = parse_filter("on Sunday and after 02:30");
+  expect_time_eq(find_optimal_time(NULL, f, midnight, 0), jump,
+                 "week mask after a skipped time");
+  destroy_filter(f);
+
+  // Backward, from the evening of the change
+  const time_t evening = tf_mktime(2025, 3, 9, 20, 0);
+  const char *inputs[] = {"on Sunday and after 09:00 and before 17:00",
+                          "before 17:00", "on Sunday and before 02:30",
+                          "before 02:30"};
+  const time_t latest[] = {tf_mktime(2025, 3, 9, 17, 0) - 1,
+                           tf_mktime(2025, 3, 9, 17, 0) - 1, jump - 1,
+                           jump - 1};
+  bool same = true;
+  for (int i = 0; i < 4; i++) {
+    f = optimize_filter(parse_filter(inputs[i]));
+    same = same && find_latest_time(NULL, f, evening, 0) == latest[i] &&
+           search_back(NULL, f, NULL, evening, 0) == latest[i];
+    destroy_filter(f);
+  }
+  expect(same, "backward search on a spring forward day");
+  tf_restore_zone(zone);
+}
+
+static void test_compiled_filter(void) {
+  const char *inputs[] = {
+      "weekdays and after 09:00 and before 17:00",
+      "not (weekend or holidays)",
+      "on Monday,Wednesday,Friday and not after 12:00",
+      "after 2025-12-24 and before 2025-12-31 and spaced 30 minutes",
+      "not not business_days and business_hours",
+  };
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Standup", "", tf_mktime(2025, 12, 22, 9, 0),
+                     tf_mktime(2025, 12, 22, 9, 30));
+  add_event_calendar(cal, "Review", "", tf_mktime(2025, 12, 29, 14, 0),
+                     tf_mktime(2025, 12, 29, 16, 0));
+
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    Filter *f = parse_filter(inputs[i]);
+    CompiledFilter *compiled = compile_filter(f);
+    expect(compiled != NULL, "compile_filter succeeds");
+    bool same = true;
+    // Every 20 minutes over two weeks around the holidays
+    time_t t = tf_mktime(2025, 12, 20, 0, 0);
+    for (int step = 0; step < 14 * 72; step++, t += 20 * 60) {
+      time_t tree = until_valid(f, t, 3600, cal);
+      time_t skip = until_valid_compiled(compiled, t, 3600, cal);
+      if (skip == tree) {
+        continue;
+      }
+      // Week masks skip exactly to the first valid minute of their subtree,
+      // which can be further than the tree's estimate: following the tree's
+      // own skips must not find a valid time before it
+      time_t u = t;
+      while (same && tree > 0 && skip > 0 && u < t + skip) {
+        time_t d = until_valid(f, u, 3600, cal);
+        same = d > 0;
+        u += d;
+      }
+      if (!same || tree <= 0 || skip <= 0) {
+        same = false;
+        break;
+      }
+    }
+    expect(same, "compiled filter matches tree evaluation");
+    free_compiled_filter(compiled);
+    destroy_filter(f);
+  }
+
+  // Post-order layout: leaves first, root last
+  Filter *f = parse_filter("not (holidays or on Sunday) and spaced 10 minutes");
+  CompiledFilter *compiled = compile_filter(f);
+  expect_eq((int)compiled->length, 8,
+            "one instruction per node and a test per AND and OR");
+  expect_eq((int)compiled->depth, 2, "stack depth of the deepest operand");
+  expect_eq(compiled->code[compiled->length - 1].type, FILTER_AND,
+            "root is the last instruction");
+  expect_eq(compiled->code[0].type, FILTER_HOLIDAY,
+            "first leaf is the first instruction");
+  free_compiled_filter(compiled);
+  destroy_filter(f);
+
+  // Weekly subtrees become a single lookup
+  f = parse_filter("not weekend and spaced 10 minutes");
+  compiled = compile_filter(f);
+  expect_eq((int)compiled->length, 4, "weekly subtree is one instruction");
+  expect_eq(compiled->code[0].type, FILTER_WEEK_MASK, "as a week mask");
+  free_compiled_filter(compiled);
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static void test_week_mask(void) {
+  Filter *f = parse_filter("weekdays and (after 09:00 and before 12:00 or "
+                           "after 13:00 and before 17:30) or "
+                           "on Saturday and not before 22:00");
+  CompiledFilter *compiled = compile_filter(f);
+  expect(compiled->length == 1 && compiled->code[0].type == FILTER_WEEK_MASK,
+         "whole weekly filter is one mask");
+  // Two weeks of minutes, sampled half way into each
+  const time_t base = tf_mktime(2026, 1, 12, 0, 0) + 30;
+  static bool valid[2 * WEEK_MINUTES];
+  for (int i = 0; i < 2 * WEEK_MINUTES; i++) {
+    valid[i] = evaluate_filter(f, base + i * 60, 0, NULL);
+  }
+  bool same = true;
+  for (int i = 0, next = 0; i < WEEK_MINUTES && same; i++) {
+    if (next < i) {
+      next = i;
+    }
+    while (!valid[next]) {
+      next++;
+    }
+    time_t expected = next == i ? 0 : (next - i) * 60 - 30;
+    same = until_valid_compiled(compiled, base + i * 60, 0, NULL) == expected;
+  }
+  expect(same, "mask is valid where the tree is and skips to the first "
+               "valid minute");
+  free_compiled_filter(compiled);
+  destroy_filter(f);
+
+  // Weekends with a daylight saving change in the US, Europe and Australia
+  f = optimize_filter(parse_filter("weekdays and business_hours"));
+  const time_t fridays[] = {tf_mktime(2026, 3, 6, 18, 0),
+                            tf_mktime(2026, 3, 27, 18, 0),
+                            tf_mktime(2026, 4, 3, 18, 0)};
+  const time_t mondays[] = {tf_mktime(2026, 3, 9, 9, 0),
+                            tf_mktime(2026, 3, 30, 9, 0),
+                            tf_mktime(2026, 4, 6, 9, 0)};
+  same = true;
+  for (int i = 0; i < 3; i++) {
+    same = same && find_optimal_time(NULL, f, fridays[i], 0) == mondays[i];
+  }
+  expect(same, "skip over a clock change lands on Monday morning");
+  destroy_filter(f);
+
+  f = parse_filter("after 10:00 and before 09:00");
+  compiled = compile_filter(f);
+  expect(until_valid_compiled(compiled, base, 0, NULL) == -1,
+         "empty mask is never valid");
+  free_compiled_filter(compiled);
+  destroy_filter(f);
+}
+
+static void test_single_pass_evaluation(void) {
+  // A `before` that has passed is never valid again; it must not stop the
+  // NOT from becoming valid when the weekend ends
+  Filter *f = parse_filter("not (before 2025-01-01 or weekend)");
+  time_t saturday = tf_mktime(2025, 12, 20, 10, 0);
+  expect_time_eq(saturday + until_valid(f, saturday, 0, NULL),
+                 tf_mktime(2025, 12, 21, 0, 0),
+                 "NOT of OR waits for the valid branch to end");
+  destroy_filter(f);
+
+  // Nested negations are evaluated once per node, not once per path
+  char input[256] = "";
+  for (int i = 0; i < 40; i++) {
+    strcat(input, "not ");
+  }
+  strcat(input, "weekend");
+  f = parse_filter(input);
+  expect(evaluate_filter(f, saturday, 0, NULL),
+         "even number of negations keeps weekend");
+  destroy_filter(f);
+}
+
+static void test_optimize_filter(void) {
+  struct {
+    const char *input;
+    size_t nodes;
+  } cases[] = {
+      {"weekdays", 1},
+      {"business_days and business_hours", 6},
+      {"weekdays and business_hours", 3},
+      {"on Monday,Wednesday,Friday and not weekend", 1},
+      {"not not (weekend or on Monday)", 1},
+      {"bogus and weekdays", 1},
+      {"after 08:00 and weekdays and before 18:00 and after 09:00", 3},
+      {"holidays or not holidays", 4},
+  };
+  Calendar *cal = create_calendar();
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    Filter *original = parse_filter(cases[i].input);
+    Filter *optimized = optimize_filter(parse_filter(cases[i].input));
+    expect_eq((int)count_filter_nodes(optimized), (int)cases[i].nodes,
+              cases[i].input);
+    bool same = true;
+    // Every 30 minutes over three weeks around the holidays
+    time_t t = tf_mktime(2025, 12, 15, 0, 0);
+    for (int step = 0; step < 21 * 48; step++, t += 30 * 60) {
+      if (evaluate_filter(original, t, 0, cal) !=
+          evaluate_filter(optimized, t, 0, cal)) {
+        same = false;
+        break;
+      }
+    }
+    expect(same, "optimized filter accepts the same times");
+    destroy_filter(original);
+    destroy_filter(optimized);
+  }
+
+  Filter *f = optimize_filter(parse_filter("weekdays and business_hours"));
+  expect_eq(f->data.logical.left->type, FILTER_DAY_MASK,
+            "days collapse into a mask");
+  expect_eq(f->data.logical.left->data.day_mask, 0x3E, "Monday to Friday");
+  expect_eq(f->data.logical.right->type, FILTER_TIME_WINDOW,
+            "time bounds merge into a window");
+  // Friday evening: next slot is Monday at nine
+  expect_time_eq(find_optimal_time(cal, f, tf_mktime(2025, 12, 19, 18, 0), 0),
+                 tf_mktime(2025, 12, 22, 9, 0),
+                 "mask and window skip straight to the next window");
+  destroy_filter(f);
+
+  f = optimize_filter(parse_filter("after 17:00 and before 09:00"));
+  expect_eq(until_valid(f, tf_mktime(2025, 12, 19, 18, 0), 0, NULL), -1,
+            "empty window is never valid");
+  destroy_filter(f);
+  f = optimize_filter(parse_filter("on Monday and on Tuesday"));
+  expect_eq(until_valid(f, tf_mktime(2025, 12, 19, 18, 0), 0, NULL), -1,
+            "disjoint days are never valid");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static void test_find_optimal_times(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Busy", "", tf_mktime(2025, 12, 1, 10, 0),
+                     tf_mktime(2025, 12, 1, 11, 0));
+  Filter *f = optimize_filter(
+      parse_filter("business_hours and spaced 0 minutes and weekdays"));
+  time_t slots[6];
+  size_t found =
+      find_optimal_times(cal, f, tf_mktime(2025, 12, 1, 8, 0), 3600, 6, slots);
+  expect_eq((int)found, 6, "six slots found");
+  expect_time_eq(slots[0], tf_mktime(2025, 12, 1, 9, 0), "first slot");
+  expect_time_eq(slots[1], tf_mktime(2025, 12, 1, 11, 0),
+                 "second slot skips the event");
+  expect_time_eq(slots[5], tf_mktime(2025, 12, 1, 15, 0),
+                 "slots pack back to back");
+  expect_time_eq(slots[0], find_optimal_time(cal, f,
+                                             tf_mktime(2025, 12, 1, 8, 0),
+                                             3600),
+                 "first slot matches find_optimal_time");
+
+  // Without a duration each slot starts a new valid range
+  found = find_optimal_times(cal, f, tf_mktime(2025, 12, 5, 12, 0), 0, 3,
+                             slots);
+  expect_eq((int)found, 3, "three ranges found");
+  expect_time_eq(slots[1], tf_mktime(2025, 12, 8, 9, 0),
+                 "next range is Monday morning");
+  destroy_filter(f);
+
+  f = parse_filter("before 2025-12-01 12:00");
+  found = find_optimal_times(cal, f, tf_mktime(2025, 12, 1, 10, 0), 3600, 5,
+                             slots);
+  expect_eq((int)found, 2, "search stops when no more slots exist");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+// Latest second at or before deadline - duration at which the filter is
+// valid, within 45 days, or -1: scans back by minutes, then by seconds over
+// the two minutes that follow the latest valid whole minute
+static time_t tf_latest_second(const Calendar *cal, const Filter *f,
+                               time_t deadline, time_t duration) {
+  const time_t last = deadline - duration;
+  time_t t = last - last % 60;
+  int i = 0;
+  while (i < 45 * 1440 && !evaluate_filter(f, t, duration, cal)) {
+    i++;
+    t -= 60;
+  }
+  if (i == 45 * 1440) {
+    return -1;
+  }
+  for (time_t s = t + 119 < last ? t + 119 : last; s > t; s--) {
+    if (evaluate_filter(f, s, duration, cal)) {
+      return s;
+    }
+  }
+  return t;
+}
+
+static void test_find_latest_time(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Standup", "", tf_mktime(2026, 3, 2, 10, 0),
+                     tf_mktime(2026, 3, 2, 11, 0));
+  add_event_calendar(cal, "Review", "", tf_mktime(2026, 3, 2, 14, 0),
+                     tf_mktime(2026, 3, 2, 15, 30));
+  add_event_calendar(cal, "Workshop", "", tf_mktime(2026, 3, 3, 9, 0),
+                     tf_mktime(2026, 3, 3, 12, 0));
+  const char *inputs[] = {
+      "weekdays and business_hours",
+      "on Monday and after 09:00 and spaced 15 minutes",
+      "spaced 0 minutes and after 08:00 and before 18:00",
+      "spaced -30 minutes",
+      "first Friday and before 12:00",
+      "in Feb and days 1-7",
+      "not holidays and weekdays and after 10:00",
+      "from 2026-02-20 to 2026-02-25 and not before 13:30",
+      "last Monday or on Wednesday and before 07:00",
+  };
+  const time_t deadlines[] = {tf_mktime(2026, 3, 2, 17, 0),
+                              tf_mktime(2026, 3, 3, 11, 30)};
+  const time_t durations[] = {0, 60 * 60};
+  bool same = true;
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    for (int opt = 0; opt < 2; opt++) {
+      Filter *f = parse_filter(inputs[i]);
+      if (opt) {
+        f = optimize_filter(f);
+      }
+      for (int d = 0; d < 4; d++) {
+        time_t deadline = deadlines[d / 2];
+        time_t duration = durations[d % 2];
+        time_t expected = tf_latest_second(cal, f, deadline, duration);
+        time_t latest = find_latest_time(cal, f, deadline, duration);
+        // Also without the compiled code
+        time_t by_tree =
+            search_back(cal, f, NULL, deadline - duration, duration);
+        if (latest != expected || by_tree != expected) {
+          printf("  %s: expected %ld, got %ld\n", inputs[i], (long)expected,
+                 (long)latest);
+          same = false;
+        }
+      }
+      destroy_filter(f);
+    }
+  }
+  expect(same, "latest slot matches scanning back");
+
+  Filter *f = parse_filter("weekdays and business_hours");
+  expect_time_eq(find_latest_time(cal, f, tf_mktime(2026, 3, 6, 17, 0), 3600),
+                 tf_mktime(2026, 3, 6, 16, 0),
+                 "latest slot ends at the deadline");
+  expect_time_eq(find_latest_time(cal, f, tf_mktime(2026, 3, 9, 8, 0), 0),
+                 tf_mktime(2026, 3, 6, 17, 0) - 1,
+                 "search skips back over the weekend");
+
+  // Back over weekends with a daylight saving change in the US, Europe and
+  // Australia
+  Filter *saturday = parse_filter("on Saturday");
+  const int mondays[] = {9, 30, 37}; // days since March 0
+  same = true;
+  for (int i = 0; i < 3; i++) {
+    const int day = mondays[i];
+    time_t deadline = tf_mktime(2026, 3, day, 8, 0);
+    same = same &&
+           find_latest_time(NULL, f, deadline, 0) ==
+               tf_mktime(2026, 3, day - 3, 17, 0) - 1 &&
+           find_latest_time(NULL, saturday, deadline, 0) ==
+               tf_mktime(2026, 3, day - 1, 0, 0) - 1;
+  }
+  expect(same, "skips back over a clock change keep the latest second");
+  destroy_filter(saturday);
+  destroy_filter(f);
+  f = parse_filter("before 2020-01-01");
+  expect_time_eq(find_latest_time(cal, f, tf_mktime(2026, 3, 2, 0, 0), 0),
+                 tf_mktime(2020, 1, 1, 0, 0) - 1,
+                 "past deadline is reached in one skip");
+  destroy_filter(f);
+  f = parse_filter("after 2030-01-01");
+  expect(find_latest_time(cal, f, tf_mktime(2026, 3, 2, 0, 0), 0) == -1,
+         "filter never valid before the deadline");
+  destroy_filter(f);
+  free_calendar(cal);
+
+  // Overlapping by 10 minutes, an hour never fits in the 5 minute gaps of
+  // a packed week: the search walks back over every event
+  cal = create_calendar();
+  const time_t first = tf_mktime(2026, 3, 2, 0, 0);
+  time_t end = first;
+  for (int i = 0; i < 7 * 24; i++) {
+    add_event_calendar(cal, "Packed", "", first + i * 3600,
+                       first + i * 3600 + 55 * 60);
+    end = first + i * 3600 + 55 * 60;
+  }
+  f = parse_filter("spaced -10 minutes");
+  expect_time_eq(find_latest_time(cal, f, end, 3600), first - 50 * 60,
+                 "overlapping slot before a packed week");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static void test_slot_cursor(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Busy", "", tf_mktime(2025, 12, 1, 10, 0),
+                     tf_mktime(2025, 12, 1, 11, 0));
+  Filter *f = optimize_filter(
+      parse_filter("business_hours and spaced 0 minutes and weekdays"));
+  const time_t start = tf_mktime(2025, 12, 1, 8, 0);
+  time_t slots[12];
+  size_t found = find_optimal_times(cal, f, start, 3600, 12, slots);
+  SlotCursor *cursor = create_slot_cursor(cal, f, start, 3600, NULL);
+  bool same = found == 12;
+  for (size_t i = 0; i < found; i++) {
+    same = same && next_slot(cursor) == slots[i];
+  }
+  expect(same, "cursor pages through the same slots as find_optimal_times");
+
+  // The calendar may change between pages
+  add_event_calendar(cal, "Late", "", slots[found - 1] + 3600,
+                     slots[found - 1] + 2 * 3600);
+  expect_time_eq(next_slot(cursor), slots[found - 1] + 2 * 3600,
+                 "next page sees the new event");
+  free_slot_cursor(cursor);
+
+  // A per-call limit pauses the search instead of ending it
+  SearchOptions options = {.max_iterations = 1};
+  cursor = create_slot_cursor(cal, f, tf_mktime(2025, 12, 5, 18, 0), 3600,
+                              &options);
+  time_t slot = -1;
+  int calls = 0;
+  while (slot == -1 && calls < 10) {
+    slot = next_slot(cursor);
+    calls++;
+  }
+  expect(calls > 1, "iteration limit stops the first call");
+  expect_time_eq(slot, tf_mktime(2025, 12, 8, 9, 0),
+                 "later calls resume and reach Monday");
+  free_slot_cursor(cursor);
+  destroy_filter(f);
+
+  f = parse_filter("before 2025-12-01 12:00");
+  cursor = create_slot_cursor(cal, f, tf_mktime(2025, 12, 1, 10, 0), 3600,
+                              NULL);
+  next_slot(cursor);
+  next_slot(cursor);
+  expect(next_slot(cursor) == -1 &&
+             cursor->stats.status == SEARCH_UNSATISFIABLE,
+         "cursor stops when no more slots exist");
+  expect(cursor->done && next_slot(cursor) == -1, "and stays exhausted");
+  free_slot_cursor(cursor);
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static void test_filter_profile(void) {
+  Filter *f = parse_filter("on Monday and after 09:00");
+  FilterProfile *profile = create_filter_profile(f);
+  expect(profile && profile->count == 3 && profile->nodes[0].size == 3,
+         "profile has one entry per node");
+  SearchOptions options = {.profile = profile};
+  SearchStats stats;
+  const time_t saturday = tf_mktime(2026, 3, 7, 8, 0);
+  search_optimal_time(NULL, f, saturday, 0, &options, &stats);
+  const FilterNodeProfile *nodes = profile->nodes;
+  expect(nodes[0].calls == stats.iterations && nodes[0].valid == 1,
+         "root counts every candidate");
+  expect(nodes[1].depth == 1 && nodes[1].calls == nodes[0].calls,
+         "left operand is always evaluated");
+  expect(nodes[2].calls == nodes[0].calls - 1,
+         "right operand is skipped when the left one decides");
+  expect(nodes[1].skipped > 24 * 60 * 60 && nodes[1].nanoseconds >= 0,
+         "skips from Saturday to Monday are summed");
+
+  FILE *out = tmpfile();
+  print_filter_profile(profile, out);
+  rewind(out);
+  char line[256];
+  bool described = false;
+  while (fgets(line, sizeof(line), out)) {
+    described = described || strstr(line, "    on Monday") != NULL;
+  }
+  fclose(out);
+  expect(described, "profile prints the node as an indented tree");
+  free_filter_profile(profile);
+  destroy_filter(f);
+
+  f = parse_filter("before 2020-01-01 or on Monday");
+  profile = create_filter_profile(f);
+  options.profile = profile;
+  search_optimal_time(NULL, f, saturday, 0, &options, &stats);
+  expect(profile->nodes[1].never == profile->nodes[1].calls &&
+             profile->nodes[0].never == 0,
+         "-1 results are counted per node");
+  free_filter_profile(profile);
+  destroy_filter(f);
+}
+
+static void test_search_options(void) {
+  SearchStats stats;
+  time_t monday = tf_mktime(2025, 12, 1, 8, 0);
+  Filter *f = parse_filter("on Sunday");
+  time_t slot = search_optimal_time(NULL, f, monday, 0, NULL, &stats);
+  expect_time_eq(slot, tf_mktime(2025, 12, 7, 0, 0), "search finds Sunday");
+  expect_eq(stats.status, SEARCH_FOUND, "status is found");
+  expect_eq((int)stats.iterations, 2, "one skip, then a valid candidate");
+  expect(stats.skipped == slot - monday, "skipped seconds add up");
+
+  SearchOptions options = {.horizon = monday + 24 * 60 * 60};
+  expect(search_optimal_time(NULL, f, monday, 0, &options, &stats) == -1,
+         "nothing before the horizon");
+  expect_eq(stats.status, SEARCH_HORIZON, "status is horizon");
+  destroy_filter(f);
+
+  f = parse_filter("before 2020-01-01");
+  expect(search_optimal_time(NULL, f, monday, 0, NULL, &stats) == -1,
+         "past deadline filter finds nothing");
+  expect_eq(stats.status, SEARCH_UNSATISFIABLE, "status is unsatisfiable");
+  destroy_filter(f);
+
+  f = parse_filter("after 2025-12-05 and on Friday and holidays");
+  options.horizon = 0;
+  options.max_iterations = 1;
+  expect(search_optimal_time(NULL, f, monday, 0, &options, &stats) == -1,
+         "one iteration is not enough");
+  expect_eq(stats.status, SEARCH_ITERATIONS, "status is iterations");
+  // Monday is before the date, so both ANDs stop after their left operand
+  expect_eq((int)stats.evaluations, 3, "decided right operands are skipped");
+  destroy_filter(f);
+
+  // Never valid, but each step only skips to the next match of either side
+  f = parse_filter("on Monday and first Tuesday");
+  options.max_iterations = 1000000000;
+  options.time_limit_ms = 5;
+  expect(search_optimal_time(NULL, f, monday, 0, &options, &stats) == -1,
+         "endless search is cut off");
+  expect_eq(stats.status, SEARCH_DEADLINE, "status is deadline");
+  destroy_filter(f);
+}
+
+static void test_short_circuit(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Busy", "", tf_mktime(2025, 12, 8, 9, 0),
+                     tf_mktime(2025, 12, 8, 10, 0));
+  Filter *f = optimize_filter(parse_filter("spaced 30 minutes and weekdays"));
+  expect_eq(f->data.logical.left->type, FILTER_DAY_MASK,
+            "cheap day check is moved first");
+  expect_eq(f->data.logical.right->type, FILTER_MIN_DISTANCE,
+            "event scan is moved last");
+
+  SearchStats stats;
+  time_t saturday = tf_mktime(2025, 12, 6, 10, 0);
+  expect_time_eq(
+      search_optimal_time(cal, f, saturday, 3600, NULL, &stats),
+      tf_mktime(2025, 12, 8, 0, 0), "weekend is skipped in one step");
+  // Saturday: mask and AND; Monday: mask, spacing and AND
+  expect_eq((int)stats.evaluations, 5, "spacing not checked on the weekend");
+  destroy_filter(f);
+
+  // A `before` that has passed makes the NOT valid forever
+  f = optimize_filter(
+      parse_filter("not before 2020-01-01 or spaced 30 minutes"));
+  expect(search_optimal_time(cal, f, saturday, 3600, NULL, &stats) ==
+             saturday,
+         "OR is valid through its left operand");
+  expect_eq((int)stats.evaluations, 3, "spacing not checked when OR holds");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+// Returns true if every node of the filter was allocated from the arena
+static bool tf_in_arena(const Filter *f, const FilterArena *arena) {
+  if (!f || f->arena != arena) {
+    return false;
+  }
+  switch (f->type) {
+  case FILTER_AND:
+  case FILTER_OR:
+    return tf_in_arena(f->data.logical.left, arena) &&
+           tf_in_arena(f->data.logical.right, arena);
+  case FILTER_NOT:
+    return tf_in_arena(f->data.operand, arena);
+  default:
+    return true;
+  }
+}
+
+static void test_filter_arena(void) {
+  const char *input = "business_days and business_hours and spaced 15 min";
+  FilterArena *arena = create_filter_arena(0);
+  Filter *heap = parse_filter(input);
+  Filter *f = parse_filter_in(arena, input);
+  expect(tf_in_arena(f, arena), "parse allocates every node in the arena");
+  expect_eq((int)arena->blocks->used, (int)count_filter_nodes(f),
+            "nodes are packed into one block");
+  expect(arena->blocks->next == NULL, "one block is enough");
+  bool same = true;
+  time_t t = tf_mktime(2025, 12, 20, 0, 0);
+  for (int step = 0; step < 7 * 48; step++, t += 30 * 60) {
+    if (until_valid(f, t, 0, NULL) != until_valid(heap, t, 0, NULL)) {
+      same = false;
+      break;
+    }
+  }
+  expect(same, "arena filter evaluates like a heap filter");
+
+  // Replaced nodes stay in the arena, new ones are taken from it
+  f = optimize_filter(f);
+  expect(tf_in_arena(f, arena), "optimised nodes come from the arena");
+  expect_time_eq(find_optimal_time(NULL, f, tf_mktime(2025, 12, 20, 0, 0), 0),
+                 tf_mktime(2025, 12, 22, 9, 0),
+                 "optimised arena filter finds Monday morning");
+  destroy_filter(f); // No effect on arena nodes
+
+  // Heap nodes under arena nodes are still freed by destroy_filter
+  Filter *mixed = not_filter(parse_filter_in(arena, "weekend"));
+  mixed = and_filter(parse_filter("holidays"), mixed);
+  expect(mixed->arena == arena, "AND with an arena operand joins the arena");
+  destroy_filter(mixed);
+
+  reset_filter_arena(arena);
+  expect_eq((int)arena->blocks->used, 0, "reset releases every node");
+  free_filter_arena(arena);
+
+  // Small blocks chain as needed
+  arena = create_filter_arena(2);
+  f = parse_filter_in(arena, input);
+  expect(tf_in_arena(f, arena), "nodes span several blocks");
+  expect(arena->blocks->next != NULL, "more blocks were added");
+  expect(evaluate_filter(f, tf_mktime(2025, 12, 22, 10, 0), 0, NULL),
+         "filter across blocks still evaluates");
+  free_filter_arena(arena);
+  destroy_filter(heap);
+}
+
 // Aggregate runner for all filter tests
+// The start if it is valid, otherwise the first valid local midnight after
+// it, checking every day
+static time_t tf_first_valid_day(const Filter *f, const time_t start) {
+  if (evaluate_filter(f, start, 0, NULL)) {
+    return start;
+  }
+  struct tm day = *localtime(&start);
+  for (int d = 1; d <= 800; d++) {
+    time_t midnight =
+        tf_mktime(day.tm_year + 1900, day.tm_mon + 1, day.tm_mday + d, 0, 0);
+    if (evaluate_filter(f, midnight, 0, NULL)) {
+      return midnight;
+    }
+  }
+  return -1;
+}
+
+static void test_calendar_periods(void) {
+  const char *inputs[] = {
+      "first Monday",  "last Friday",           "fifth Friday",
+      "in March-May",  "in Nov-Jan",            "in Feb, Aug",
+      "days 31",       "days 29-30",            "day 1, 15",
+      "not days 1-28", "last Sunday and in Oct", "days 13 and on Friday",
+  };
+  const time_t starts[] = {
+      tf_mktime(2026, 1, 6, 12, 0),
+      tf_mktime(2026, 2, 28, 23, 30),
+      tf_mktime(2026, 10, 25, 1, 30),
+      tf_mktime(2027, 12, 31, 18, 0),
+  };
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    Filter *f = parse_filter(inputs[i]);
+    for (size_t j = 0; j < sizeof(starts) / sizeof(starts[0]); j++) {
+      SearchStats stats;
+      time_t slot = search_optimal_time(NULL, f, starts[j], 0, NULL, &stats);
+      expect_time_eq(slot, tf_first_valid_day(f, starts[j]), inputs[i]);
+      if (f->type != FILTER_AND) {
+        expect(stats.iterations <= 2, "one skip reaches the next period");
+      }
+    }
+    destroy_filter(f);
+  }
+
+  // Each range ends with the period
+  time_t slots[3];
+  Filter *f = parse_filter("first Monday");
+  expect_eq((int)find_optimal_times(NULL, f, starts[0], 0, 3, slots), 3,
+            "three first Mondays");
+  expect_time_eq(slots[2], tf_mktime(2026, 4, 6, 0, 0), "third first Monday");
+  destroy_filter(f);
+  f = parse_filter("in Nov-Jan");
+  find_optimal_times(NULL, f, starts[0], 0, 2, slots);
+  expect_time_eq(slots[1], tf_mktime(2026, 11, 1, 0, 0),
+                 "next winter starts in November");
+  destroy_filter(f);
+
+  f = parse_filter("from 2026-03-01 to 2026-03-10");
+  expect_time_eq(find_optimal_time(NULL, f, starts[0], 0),
+                 tf_mktime(2026, 3, 1, 0, 0), "range start");
+  expect_time_eq(find_optimal_time(NULL, f, tf_mktime(2026, 3, 10, 18, 0), 0),
+                 tf_mktime(2026, 3, 10, 18, 0), "last day of the range");
+  SearchStats stats;
+  search_optimal_time(NULL, f, tf_mktime(2026, 3, 11, 0, 0), 0, NULL, &stats);
+  expect_eq(stats.status, SEARCH_UNSATISFIABLE, "range is over");
+  destroy_filter(f);
+
+  f = optimize_filter(parse_filter("in Jan-Jun and not in Jan-Apr"));
+  expect(f->type == FILTER_MONTH_MASK && f->data.month_mask == 0x30,
+         "month sets intersect into one");
+  destroy_filter(f);
+  f = optimize_filter(parse_filter("in Jan-Jun or in Jul-Dec"));
+  expect(f->type == FILTER_NONE, "every month is no constraint");
+  destroy_filter(f);
+}
+
 static inline void run_filter_tests(void) {
   puts("Running filter tests...");
   test_filter_none();
@@ -364,6 +1133,19 @@ static inline void run_filter_tests(void) {
   test_filter_or();
   test_filter_not();
   test_find_optimal_time();
+  test_daylight_saving();
+  test_compiled_filter();
+  test_week_mask();
+  test_single_pass_evaluation();
+  test_optimize_filter();
+  test_find_optimal_times();
+  test_slot_cursor();
+  test_find_latest_time();
+  test_filter_profile();
+  test_search_options();
+  test_short_circuit();
+  test_filter_arena();
+  test_calendar_periods();
   puts("Filter tests completed.");
 }
 
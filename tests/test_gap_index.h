@@ -0,0 +1,203 @@
+#ifndef TEST_GAP_INDEX_H
+#define TEST_GAP_INDEX_H
+
+#include "../src/gap_index.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tg_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static unsigned tg_random(unsigned *state) {
+  *state = *state * 1103515245u + 12345u;
+  return (*state >> 16) & 0x7FFF;
+}
+
+// Earliest time >= from that keeps `pad` away from every event, by moving
+// past each event in the way until none is
+static time_t tg_next_free(const Calendar *cal, time_t from, time_t duration,
+                           time_t pad) {
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    for (Event *e = cal->event_list->head; e; e = e->next) {
+      if (from + duration + pad > e->start_time && from < e->end_time + pad) {
+        from = e->end_time + pad;
+        moved = true;
+      }
+    }
+  }
+  return from;
+}
+
+// Latest time <= from that keeps `pad` away from every event, by moving
+// before each event in the way until none is
+static time_t tg_prev_free(const Calendar *cal, time_t from, time_t duration,
+                           time_t pad) {
+  bool moved = true;
+  while (moved) {
+    moved = false;
+    for (Event *e = cal->event_list->head; e; e = e->next) {
+      if (from + duration + pad > e->start_time && from < e->end_time + pad) {
+        from = e->start_time - pad - duration;
+        moved = true;
+      }
+    }
+  }
+  return from;
+}
+
+// Number of busy intervals the events merge into
+static size_t tg_interval_count(const Calendar *cal) {
+  size_t count = 0;
+  time_t start = 0;
+  time_t end = 0;
+  for (Event *e = cal->event_list->head; e; e = e->next) {
+    if (count == 0 || (e->start_time >= end && e->start_time != start)) {
+      count++;
+      start = e->start_time;
+      end = e->end_time;
+    } else if (e->end_time > end) {
+      end = e->end_time;
+    }
+  }
+  return count;
+}
+
+static bool tg_matches_brute_force(const Calendar *cal, unsigned *state) {
+  const GapIndex *index = calendar_gap_index(cal);
+  if (!index || index->count != tg_interval_count(cal)) {
+    return false;
+  }
+  const time_t base = tg_mktime(2026, 3, 2, 0, 0);
+  const time_t durations[] = {0, 30 * 60, 2 * 60 * 60};
+  const time_t pads[] = {0, 10 * 60, 60 * 60};
+  for (int q = 0; q < 200; q++) {
+    time_t from = base + (time_t)(tg_random(state) % (12 * 24 * 60)) * 60;
+    time_t duration = durations[q % 3];
+    time_t pad = pads[(q / 3) % 3];
+    if (gap_index_next_free(index, from, duration, pad) !=
+            tg_next_free(cal, from, duration, pad) ||
+        gap_index_prev_free(index, from, duration, pad) !=
+            tg_prev_free(cal, from, duration, pad)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_gap_index_intervals(void) {
+  GapIndex *index = create_gap_index();
+  gap_index_add(index, 100, 200);
+  gap_index_add(index, 150, 300);
+  expect(index->count == 1, "overlapping events share an interval");
+  gap_index_add(index, 300, 400);
+  expect(index->count == 2, "touching events stay separate");
+  expect(gap_index_next_free(index, 120, 0, 0) == 300,
+         "empty slot fits where two events touch");
+  expect(gap_index_next_free(index, 120, 10, 0) == 400,
+         "longer slot waits for the last interval to end");
+  expect(gap_index_next_free(index, 50, 40, 10) == 50,
+         "slot that ends a pad before the first interval is free");
+  expect(gap_index_next_free(index, 50, 41, 10) == 410,
+         "slot too close to the first interval is moved past all of them");
+
+  expect(gap_index_prev_free(index, 350, 10, 0) == 90,
+         "slot looking back ends where the first interval starts");
+  expect(gap_index_prev_free(index, 500, 10, 0) == 500,
+         "slot after the last interval is free");
+
+  gap_index_add(index, 700, 800);
+  expect(gap_index_prev_free(index, 750, 200, 50) == 450,
+         "slot looking back ends a pad before the last gap that fits");
+  expect(gap_index_next_free(index, 120, 200, 50) == 450,
+         "slot moves to the first gap wide enough for it and its padding");
+  expect(gap_index_next_free(index, 120, 201, 50) == 850,
+         "slot moves past a gap one second too narrow");
+  gap_index_add(index, 50, 50);
+  expect(index->count == 4, "empty event before the first one is separate");
+  gap_index_add(index, 0, 1000);
+  expect(index->count == 1, "long event absorbs every interval");
+  expect(gap_index_next_free(index, 500, 0, 0) == 1000,
+         "slot inside the merged interval waits for its end");
+  free_gap_index(index);
+}
+
+static void test_gap_index_random(void) {
+  unsigned state = 7;
+  Calendar *cal = create_calendar();
+  const time_t base = tg_mktime(2026, 3, 2, 0, 0);
+  for (int i = 0; i < 300; i++) {
+    time_t start = base + (time_t)(tg_random(&state) % (10 * 24 * 60)) * 60;
+    time_t length = (time_t)(tg_random(&state) % 13) * 15 * 60;
+    add_event_calendar(cal, "Busy", "", start, start + length);
+  }
+  expect(tg_matches_brute_force(cal, &state),
+         "index finds the same slots as walking every event, both ways");
+
+  // Updated in place from here on
+  for (EventID id = 1; id <= 300; id += 2) {
+    free(remove_event_calendar(cal, id));
+  }
+  expect(tg_matches_brute_force(cal, &state),
+         "index stays exact when events are removed");
+  for (int i = 0; i < 50; i++) {
+    time_t start = base + (time_t)(tg_random(&state) % (10 * 24 * 60)) * 60;
+    add_event_calendar(cal, "Late", "", start, start + 90 * 60);
+  }
+  expect(tg_matches_brute_force(cal, &state),
+         "index stays exact when events are added");
+  free_calendar(cal);
+}
+
+static void test_gap_index_spaced_filter(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Workshop", "", tg_mktime(2026, 3, 2, 8, 0),
+                     tg_mktime(2026, 3, 2, 18, 0));
+  add_event_calendar(cal, "Call", "", tg_mktime(2026, 3, 2, 9, 0),
+                     tg_mktime(2026, 3, 2, 10, 0));
+  Event *standup = add_event_calendar(cal, "Standup", "",
+                                      tg_mktime(2026, 3, 2, 18, 30),
+                                      tg_mktime(2026, 3, 2, 19, 0));
+  Filter *f = parse_filter("spaced 15 minutes");
+  expect(find_optimal_time(cal, f, tg_mktime(2026, 3, 2, 10, 30), 60 * 60) ==
+             tg_mktime(2026, 3, 2, 19, 15),
+         "slot keeps clear of a long event that started earlier");
+  free(remove_event_calendar(cal, standup->id));
+  expect(find_optimal_time(cal, f, tg_mktime(2026, 3, 2, 10, 30), 60 * 60) ==
+             tg_mktime(2026, 3, 2, 18, 15),
+         "removing an event opens its gap");
+  destroy_filter(f);
+
+  // Negative spacing allows overlap and still walks the events
+  add_event_calendar(cal, "Review", "", tg_mktime(2026, 3, 2, 20, 0),
+                     tg_mktime(2026, 3, 2, 21, 0));
+  f = parse_filter("spaced -30 minutes");
+  expect(find_optimal_time(cal, f, tg_mktime(2026, 3, 2, 19, 45), 60 * 60) ==
+             tg_mktime(2026, 3, 2, 20, 30),
+         "negative spacing lets the slot overlap the end of an event");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static inline void run_gap_index_tests(void) {
+  puts("Running gap index tests...");
+  test_gap_index_intervals();
+  test_gap_index_random();
+  test_gap_index_spaced_filter();
+  puts("Gap index tests completed.");
+}
+
+#endif // TEST_GAP_INDEX_H
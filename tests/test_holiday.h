@@ -0,0 +1,109 @@
+#ifndef TEST_HOLIDAY_H
+#define TEST_HOLIDAY_H
+
+#include "../src/holiday.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static struct tm th_date(int year, int mon, int mday) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = 12;
+  t.tm_isdst = -1;
+  mktime(&t);
+  return t;
+}
+
+static bool th_holiday(const Calendar *cal, int year, int mon, int mday) {
+  struct tm date = th_date(year, mon, mday);
+  return is_holiday(cal, &date);
+}
+
+static void test_default_holidays(void) {
+  expect(th_holiday(NULL, 2025, 12, 25), "Christmas is a built-in holiday");
+  expect(th_holiday(NULL, 2025, 7, 4), "Independence Day is built in");
+  expect(!th_holiday(NULL, 2025, 11, 27), "Thanksgiving is not built in");
+  struct tm date = th_date(2025, 12, 26);
+  expect_eq((int)days_until_holiday(NULL, &date), 5,
+            "New Year's Eve follows Christmas");
+  date = th_date(2025, 12, 31);
+  expect_eq((int)days_until_holiday(NULL, &date), 0, "today is a holiday");
+}
+
+static void test_load_holidays(void) {
+  const char *path = "test_holidays.txt";
+  FILE *file = fopen(path, "w");
+  fputs("# US federal (subset)\n"
+        "date 1 1 observed New Year's Day\n"
+        "nth 5 1 -1 Memorial Day\n"
+        "date 7 4 observed Independence Day\n"
+        "nth 11 4 4 Thanksgiving\n"
+        "\n"
+        "date 12 25 observed Christmas Day\n",
+        file);
+  fclose(file);
+
+  Calendar *cal = create_calendar();
+  expect(load_calendar_holidays(cal, path), "holiday file loads");
+  expect_eq((int)cal->holidays->rule_count, 5, "five rules");
+  expect(th_holiday(cal, 2025, 11, 27), "Thanksgiving 2025");
+  expect(th_holiday(cal, 2025, 5, 26), "last Monday of May 2025");
+  expect(th_holiday(cal, 2026, 7, 3), "Saturday July 4th observed Friday");
+  expect(!th_holiday(cal, 2026, 7, 4), "the Saturday itself is not");
+  expect(th_holiday(cal, 2021, 12, 31),
+         "New Year's Day 2022 observed in the previous year");
+  expect(!th_holiday(cal, 2025, 12, 31), "New Year's Eve is not in the set");
+
+  Filter *f = parse_filter("holidays");
+  time_t from = tf_mktime(2025, 11, 1, 8, 0);
+  expect_time_eq(find_optimal_time(cal, f, from, 0),
+                 tf_mktime(2025, 11, 27, 0, 0),
+                 "holiday filter uses the calendar's set");
+  destroy_filter(f);
+
+  file = fopen(path, "w");
+  fputs("date 13 1 bogus\n", file);
+  fclose(file);
+  expect(!load_calendar_holidays(cal, path), "malformed file is rejected");
+  expect(th_holiday(cal, 2025, 11, 27), "previous set is kept");
+
+  // Rules that skip years: February 29th, and the fifth Monday of February
+  // (a Monday February 29th, 28 years apart)
+  file = fopen(path, "w");
+  fputs("date 2 29 Leap Day\n", file);
+  fclose(file);
+  expect(load_calendar_holidays(cal, path), "leap day file loads");
+  struct tm date = th_date(2025, 3, 1);
+  expect_eq((int)days_until_holiday(cal, &date),
+            (int)(day_number(2028, 2, 29) - day_number(2025, 3, 1)),
+            "next leap day is three years away");
+  file = fopen(path, "w");
+  fputs("nth 2 1 5 Fifth Monday\n", file);
+  fclose(file);
+  expect(load_calendar_holidays(cal, path), "fifth Monday file loads");
+  date = th_date(2017, 1, 1);
+  expect_eq((int)days_until_holiday(cal, &date),
+            (int)(day_number(2044, 2, 29) - day_number(2017, 1, 1)),
+            "next fifth Monday of February is in 2044");
+  date = th_date(2043, 12, 31);
+  expect_eq((int)days_since_holiday(cal, &date),
+            (int)(day_number(2043, 12, 31) - day_number(2016, 2, 29)),
+            "last fifth Monday of February was in 2016");
+  remove(path);
+  free_calendar(cal);
+}
+
+static inline void run_holiday_tests(void) {
+  puts("Running holiday tests...");
+  test_default_holidays();
+  test_load_holidays();
+  puts("Holiday tests completed.");
+}
+
+#endif // TEST_HOLIDAY_H
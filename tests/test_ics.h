@@ -0,0 +1,179 @@
+#ifndef TEST_ICS_H
+#define TEST_ICS_H
+
+#include "../src/ics.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t ti_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static void ti_write(const char *filename, const char *content) {
+  FILE *file = fopen(filename, "wb");
+  fputs(content, file);
+  fclose(file);
+}
+
+// 1) folded lines, escapes, nested components and time forms are decoded
+static void test_ics_import_properties(void) {
+  const char *fname = "test_import.ics";
+  ti_write(fname, "BEGIN:VCALENDAR\r\n"
+                  "VERSION:2.0\r\n"
+                  "BEGIN:VEVENT\r\n"
+                  "UID:late@example.com\r\n"
+                  "DTSTART;TZID=Europe/Paris:20250304T140000\r\n"
+                  "DURATION:PT1H30M\r\n"
+                  "SUMMARY:Design rev\r\n"
+                  " iew\r\n"
+                  "DESCRIPTION:Room 4\\, bring notes\\nand coffee|tea\r\n"
+                  "BEGIN:VALARM\r\n"
+                  "DESCRIPTION:Reminder\r\n"
+                  "END:VALARM\r\n"
+                  "END:VEVENT\r\n"
+                  "BEGIN:VEVENT\r\n"
+                  "UID:early@example.com\r\n"
+                  "DTSTART:20250101T090000Z\r\n"
+                  "DTEND:20250101T100000Z\r\n"
+                  "SUMMARY:New year call\r\n"
+                  "END:VEVENT\r\n"
+                  "BEGIN:VEVENT\r\n"
+                  "DTSTART;VALUE=DATE:20250704\r\n"
+                  "SUMMARY:Holiday\r\n"
+                  "END:VEVENT\r\n"
+                  "BEGIN:VEVENT\r\n"
+                  "SUMMARY:No start, skipped\r\n"
+                  "END:VEVENT\r\n"
+                  "END:VCALENDAR\r\n");
+
+  Calendar *cal = create_calendar();
+  expect_eq(3, import_ics(cal, fname), "import_ics counts valid VEVENTs");
+
+  Event *first = cal->event_list->head;
+  expect(first != NULL && strcmp(first->title, "New year call") == 0,
+         "out of order feed should be sorted by start time");
+  expect(first != NULL && first->start_time == 1735722000,
+         "UTC DTSTART should be converted exactly");
+  expect(first != NULL && first->end_time - first->start_time == 3600,
+         "DTEND should set the end time");
+
+  Event *review = first ? first->next : NULL;
+  expect(review != NULL && strcmp(review->title, "Design review") == 0,
+         "folded SUMMARY should be unfolded");
+  expect(review != NULL &&
+             strcmp(review->description,
+                    "Room 4, bring notes and coffee/tea") == 0,
+         "DESCRIPTION escapes resolved, nested VALARM ignored");
+  expect(review != NULL &&
+             review->start_time == ti_mktime(2025, 3, 4, 14, 0),
+         "TZID times are read as local time");
+  expect(review != NULL && review->end_time - review->start_time == 5400,
+         "DURATION should set the end time");
+
+  Event *holiday = get_first_event(cal, 2025, 7, 4);
+  expect(holiday != NULL && holiday->start_time == ti_mktime(2025, 7, 4, 0, 0),
+         "DATE values start at local midnight and are indexed");
+  expect(holiday != NULL &&
+             holiday->end_time == ti_mktime(2025, 7, 5, 0, 0),
+         "DATE values without DTEND last one day");
+
+  free_calendar(cal);
+  remove(fname);
+}
+
+// 2) export then import round-trips titles, descriptions and times
+static void test_ics_export_roundtrip(void) {
+  const char *fname = "test_export.ics";
+  Calendar *cal = create_calendar();
+  char long_title[200];
+  memset(long_title, 'x', sizeof(long_title) - 1);
+  long_title[sizeof(long_title) - 1] = '\0';
+  add_event_calendar(cal, long_title, "a;b,c\\d", ti_mktime(2025, 9, 1, 9, 0),
+                     ti_mktime(2025, 9, 1, 9, 45));
+  add_event_calendar(cal, "Sync", "", ti_mktime(2025, 9, 2, 13, 0),
+                     ti_mktime(2025, 9, 2, 14, 0));
+  expect(export_ics(cal, fname), "export_ics succeeds");
+  free_calendar(cal);
+
+  FILE *file = fopen(fname, "rb");
+  char line[256];
+  size_t longest = 0;
+  while (file && fgets(line, sizeof(line), file)) {
+    size_t len = strcspn(line, "\r\n");
+    longest = len > longest ? len : longest;
+  }
+  if (file) {
+    fclose(file);
+  }
+  expect(longest <= 75, "exported lines should be folded to 75 octets");
+
+  Calendar *back = create_calendar();
+  expect_eq(2, import_ics(back, fname), "exported file imports back");
+  Event *e = back->event_list->head;
+  expect(e != NULL && strcmp(e->title, long_title) == 0,
+         "long title survives folding");
+  expect(e != NULL && strcmp(e->description, "a;b,c\\d") == 0,
+         "escaped characters survive the round trip");
+  expect(e != NULL && e->start_time == ti_mktime(2025, 9, 1, 9, 0) &&
+             e->end_time == ti_mktime(2025, 9, 1, 9, 45),
+         "times survive the round trip");
+  expect(e && e->next && strcmp(e->next->title, "Sync") == 0,
+         "second event survives the round trip");
+  free_calendar(back);
+  remove(fname);
+}
+
+// Accepts the first event only
+static bool ti_accept_one(const IcsEvent *event, void *context) {
+  (void)event;
+  int *calls = context;
+  return ++*calls == 1;
+}
+
+// 3) events the handler refuses are not counted, a failed import adds none
+static void test_ics_import_failures(void) {
+  const char *fname = "test_import.ics";
+  ti_write(fname, "BEGIN:VEVENT\r\n"
+                  "DTSTART:20250101T090000Z\r\n"
+                  "END:VEVENT\r\n"
+                  "BEGIN:VEVENT\r\n"
+                  "DTSTART:20250102T090000Z\r\n"
+                  "END:VEVENT\r\n");
+  FILE *file = fopen(fname, "rb");
+  int calls = 0;
+  expect_eq(1, (int)read_ics_events(file, ti_accept_one, &calls),
+            "refused event is not counted");
+  expect_eq(2, calls, "reading stops at the refused event");
+  fclose(file);
+  remove(fname);
+
+  // Reading a directory fails after it is opened
+  Calendar *cal = create_calendar();
+  const unsigned long generation = cal->generation;
+  expect_eq(-1, (int)import_ics(cal, "."), "unreadable file fails");
+  expect(cal->event_list->head == NULL && cal->generation == generation,
+         "failed import leaves the calendar alone");
+  free_calendar(cal);
+}
+
+static inline void run_ics_tests(void) {
+  puts("Running ics tests...");
+  test_ics_import_properties();
+  test_ics_export_roundtrip();
+  test_ics_import_failures();
+  puts("Ics tests completed.");
+}
+
+#endif // TEST_ICS_H
@@ -0,0 +1,150 @@
+#ifndef TEST_INTERVAL_H
+#define TEST_INTERVAL_H
+
+#include "../src/interval.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tv_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+// Switches the local time zone, saving the current TZ in `saved`
+static void tv_set_zone(const char *zone, char *saved, const size_t size) {
+  const char *current = getenv("TZ");
+  snprintf(saved, size, "%s", current ? current : "");
+  setenv("TZ", zone, 1);
+  tzset();
+}
+
+static void tv_restore_zone(const char *saved) {
+  if (*saved) {
+    setenv("TZ", saved, 1);
+  } else {
+    unsetenv("TZ");
+  }
+  tzset();
+}
+
+static void test_interval_business_week(void) {
+  Filter *f = parse_filter("weekdays and business_hours");
+  IntervalSet set;
+  // Monday 2025-12-01 to the next Monday
+  time_t from = tv_mktime(2025, 12, 1, 0, 0);
+  time_t to = tv_mktime(2025, 12, 8, 0, 0);
+  expect(filter_intervals(f, NULL, from, to, 0, &set),
+         "filter_intervals succeeds");
+  expect_eq((int)set.count, 5, "one window per weekday");
+  expect(set.items[0].start == tv_mktime(2025, 12, 1, 9, 0) &&
+             set.items[0].end == tv_mktime(2025, 12, 1, 17, 0),
+         "Monday window is 09:00-17:00");
+  expect(set.items[4].start == tv_mktime(2025, 12, 5, 9, 0),
+         "last window is Friday");
+  free_interval_set(&set);
+
+  // NOT complements within the horizon and merges across midnight
+  Filter *n = not_filter(f);
+  expect(filter_intervals(n, NULL, from, to, 0, &set),
+         "filter_intervals succeeds");
+  expect_eq((int)set.count, 6, "gaps between the windows");
+  expect(set.items[5].start == tv_mktime(2025, 12, 5, 17, 0) &&
+             set.items[5].end == to,
+         "Friday evening runs through the weekend");
+  free_interval_set(&set);
+  destroy_filter(n);
+}
+
+static void test_interval_matches_search(void) {
+  const char *inputs[] = {
+      "business_days and business_hours and spaced 15 minutes",
+      "not (weekend or holidays) and after 13:00",
+      "on Tuesday,Thursday and before 10:00 or on Saturday",
+      "after 2025-12-24 12:00 and not before 2025-12-22 and business_hours",
+      "(last Wednesday or first Friday) and business_hours",
+      "in Jan and days 5-9 and not from 2026-01-01 to 2026-01-05",
+  };
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Sync", "", tv_mktime(2025, 12, 22, 9, 0),
+                     tv_mktime(2025, 12, 22, 12, 0));
+  add_event_calendar(cal, "Plan", "", tv_mktime(2025, 12, 22, 13, 0),
+                     tv_mktime(2025, 12, 22, 16, 50));
+  add_event_calendar(cal, "Demo", "", tv_mktime(2025, 12, 26, 9, 0),
+                     tv_mktime(2025, 12, 26, 11, 0));
+  time_t start = tv_mktime(2025, 12, 21, 20, 0);
+  time_t horizon = tv_mktime(2026, 1, 31, 0, 0);
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    Filter *f = optimize_filter(parse_filter(inputs[i]));
+    time_t slot = find_first_slot(cal, f, start, horizon, 3600);
+    expect(slot != -1, "find_first_slot finds a slot");
+    expect(evaluate_filter(f, slot, 3600, cal), "slot satisfies the filter");
+    expect(!evaluate_filter(f, slot - 1, 3600, cal),
+           "slot is the start of a valid range");
+    expect(slot <= find_optimal_time(cal, f, start, 3600),
+           "no later than the skip-based search");
+    destroy_filter(f);
+  }
+
+  // Monday is full: the first one-hour slot with 15 minutes of space
+  Filter *f = parse_filter("business_hours and spaced 15 minutes");
+  expect(find_first_slot(cal, f, tv_mktime(2025, 12, 22, 8, 0), horizon,
+                         3600) == tv_mktime(2025, 12, 23, 9, 0),
+         "spaced slot skips the packed day");
+  expect(find_first_slot(cal, f, tv_mktime(2025, 12, 22, 8, 0),
+                         tv_mktime(2025, 12, 22, 23, 0), 3600) == -1,
+         "no slot within the horizon");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+// Times of day are wall clock times, also on the days the clocks change
+static void test_interval_daylight_saving(void) {
+  char zone[64];
+  tv_set_zone("America/New_York", zone, sizeof(zone));
+  Filter *f = parse_filter("after 09:30 and before 17:15");
+  IntervalSet set;
+  // The Saturday before the spring change to the Tuesday after the fall one
+  const time_t days[] = {tv_mktime(2025, 3, 8, 0, 0),
+                         tv_mktime(2025, 11, 1, 0, 0)};
+  bool same = true;
+  for (int i = 0; i < 2; i++) {
+    const time_t from = days[i];
+    const time_t to = from + 4 * 24 * 60 * 60;
+    same = same && filter_intervals(f, NULL, from, to, 0, &set) &&
+           set.count == 4;
+    struct tm date;
+    for (size_t j = 0; same && j < set.count; j++) {
+      localtime_r(&set.items[j].start, &date);
+      same = date.tm_hour == 9 && date.tm_min == 30 && date.tm_sec == 0;
+      localtime_r(&set.items[j].end, &date);
+      same = same && date.tm_hour == 17 && date.tm_min == 15;
+      same = same && evaluate_filter(f, set.items[j].start, 0, NULL) &&
+             !evaluate_filter(f, set.items[j].start - 1, 0, NULL);
+    }
+    free_interval_set(&set);
+  }
+  expect(same, "windows on clock change days follow the wall clock");
+  destroy_filter(f);
+  tv_restore_zone(zone);
+}
+
+static inline void run_interval_tests(void) {
+  puts("Running interval tests...");
+  test_interval_business_week();
+  test_interval_matches_search();
+  test_interval_daylight_saving();
+  puts("Interval tests completed.");
+}
+
+#endif // TEST_INTERVAL_H
@@ -0,0 +1,167 @@
+#ifndef TEST_JOURNAL_H
+#define TEST_JOURNAL_H
+
+#include "../src/journal.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tj_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static int tj_count_events(const Calendar *cal) {
+  int n = 0;
+  for (Event *e = cal->event_list->head; e; e = e->next) {
+    n++;
+  }
+  return n;
+}
+
+static bool tj_exists(const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+static void tj_cleanup(const char *path) {
+  char buf[256];
+  remove(path);
+  snprintf(buf, sizeof(buf), "%s.journal", path);
+  remove(buf);
+  snprintf(buf, sizeof(buf), "%s.journal.1", path);
+  remove(buf);
+}
+
+// 1) edits are journaled and replayed without any snapshot
+static void test_journal_replay(void) {
+  const char *path = "test_journal_replay.dat";
+  tj_cleanup(path);
+  Calendar *cal = create_calendar();
+  Journal *journal = open_journal(cal, path);
+  expect(journal != NULL, "open_journal on a new path succeeds");
+  journal->compact_after = 0;
+  journal_add_event(journal, "A", "", tj_mktime(2025, 1, 6, 9, 0),
+                    tj_mktime(2025, 1, 6, 10, 0));
+  Event *b = journal_add_event(journal, "B", "b", tj_mktime(2025, 1, 7, 9, 0),
+                               tj_mktime(2025, 1, 7, 10, 0));
+  EventID b_id = b->id;
+  journal_add_event(journal, "C", "", tj_mktime(2025, 1, 8, 9, 0),
+                    tj_mktime(2025, 1, 8, 10, 0));
+  expect(journal_remove_event(journal, b_id), "journal_remove_event works");
+  expect(!journal_remove_event(journal, 999), "unknown id is not removed");
+  close_journal(journal);
+  free_calendar(cal);
+  expect(!tj_exists(path), "no snapshot should be written without compaction");
+
+  Calendar *back = create_calendar();
+  Journal *reopened = open_journal(back, path);
+  expect_eq(2, tj_count_events(back), "journal replay restores the events");
+  expect(get_event_calendar(back, b_id) == NULL,
+         "removal records are replayed");
+  Event *c = journal_add_event(reopened, "D", "", tj_mktime(2025, 1, 9, 9, 0),
+                               tj_mktime(2025, 1, 9, 10, 0));
+  expect(c != NULL && c->id > b_id, "replayed ids advance next_id");
+  close_journal(reopened);
+  free_calendar(back);
+  tj_cleanup(path);
+}
+
+// 2) a background snapshot truncates the journal while edits continue
+static void test_journal_background_snapshot(void) {
+  const char *path = "test_journal_snapshot.dat";
+  tj_cleanup(path);
+  Calendar *cal = create_calendar();
+  Journal *journal = open_journal(cal, path);
+  journal->compact_after = 0;
+  Event *first = NULL;
+  for (int day = 1; day <= 20; day++) {
+    Event *e = journal_add_event(journal, "Before", "",
+                                 tj_mktime(2025, 2, day, 9, 0),
+                                 tj_mktime(2025, 2, day, 10, 0));
+    first = first ? first : e;
+  }
+  EventID first_id = first->id;
+  expect(start_snapshot(journal), "start_snapshot succeeds");
+  expect(!start_snapshot(journal) || wait_for_snapshot(journal),
+         "only one snapshot runs at a time");
+  // Edits during the snapshot go to the new journal; removed frozen events
+  // must stay readable until the worker is done
+  journal_add_event(journal, "During", "", tj_mktime(2025, 3, 1, 9, 0),
+                    tj_mktime(2025, 3, 1, 10, 0));
+  journal_remove_event(journal, first_id);
+  expect(wait_for_snapshot(journal), "snapshot completes");
+  expect(tj_exists(path), "snapshot file is written");
+  expect(!tj_exists("test_journal_snapshot.dat.journal.1"),
+         "journal prefix is removed once the snapshot is durable");
+  close_journal(journal);
+  free_calendar(cal);
+
+  Calendar *back = create_calendar();
+  Journal *reopened = open_journal(back, path);
+  expect_eq(20, tj_count_events(back),
+            "snapshot plus journal restore every edit");
+  expect(get_event_calendar(back, first_id) == NULL,
+         "removal after the snapshot is replayed from the journal");
+  close_journal(reopened);
+  free_calendar(back);
+  tj_cleanup(path);
+}
+
+// 3) a prefix left behind after its snapshot completed is not applied twice
+static void test_journal_sealed_prefix_dedupe(void) {
+  const char *path = "test_journal_dedupe.dat";
+  tj_cleanup(path);
+  FILE *snapshot = fopen(path, "w");
+  fprintf(snapshot, "1|Kept||%ld|%ld\n", (long)tj_mktime(2025, 4, 1, 9, 0),
+          (long)tj_mktime(2025, 4, 1, 10, 0));
+  fclose(snapshot);
+  FILE *sealed = fopen("test_journal_dedupe.dat.journal.1", "w");
+  fprintf(sealed, "A|1|Kept||%ld|%ld\n", (long)tj_mktime(2025, 4, 1, 9, 0),
+          (long)tj_mktime(2025, 4, 1, 10, 0));
+  fclose(sealed);
+
+  Calendar *cal = create_calendar();
+  Journal *journal = open_journal(cal, path);
+  expect_eq(1, tj_count_events(cal),
+            "adds already in the snapshot are skipped");
+  journal->compact_after = 1;
+  journal_add_event(journal, "New", "", tj_mktime(2025, 4, 2, 9, 0),
+                    tj_mktime(2025, 4, 2, 10, 0));
+  expect(wait_for_snapshot(journal), "compaction threshold starts a snapshot");
+  expect(!tj_exists("test_journal_dedupe.dat.journal.1"),
+         "leftover prefix is folded into the new snapshot");
+  close_journal(journal);
+  free_calendar(cal);
+
+  Calendar *back = create_calendar();
+  Journal *reopened = open_journal(back, path);
+  expect_eq(2, tj_count_events(back), "compacted state reloads");
+  close_journal(reopened);
+  free_calendar(back);
+  tj_cleanup(path);
+}
+
+static inline void run_journal_tests(void) {
+  puts("Running journal tests...");
+  test_journal_replay();
+  test_journal_background_snapshot();
+  test_journal_sealed_prefix_dedupe();
+  puts("Journal tests completed.");
+}
+
+#endif // TEST_JOURNAL_H
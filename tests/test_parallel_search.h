@@ -0,0 +1,148 @@
+#ifndef TEST_PARALLEL_SEARCH_H
+#define TEST_PARALLEL_SEARCH_H
+
+#include "../src/parallel_search.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tp_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+// Busy 08:00-12:00 and 12:30-18:00 every day for `days` days, except on
+// day `free_day`
+static Calendar *tp_packed_calendar(int days, int free_day) {
+  Calendar *cal = create_calendar();
+  for (int d = 0; d < days; d++) {
+    if (d == free_day) {
+      continue;
+    }
+    add_event_calendar(cal, "Morning", "", tp_mktime(2026, 1, 5 + d, 8, 0),
+                       tp_mktime(2026, 1, 5 + d, 12, 0));
+    add_event_calendar(cal, "Afternoon", "",
+                       tp_mktime(2026, 1, 5 + d, 12, 30),
+                       tp_mktime(2026, 1, 5 + d, 18, 0));
+  }
+  return cal;
+}
+
+static void test_parallel_matches_sequential(void) {
+  Calendar *cal = tp_packed_calendar(150, 101);
+  const char *inputs[] = {
+      "business_hours and spaced 15 minutes",
+      "weekdays and after 10:00 and spaced 0 minutes",
+      "not holidays and business_hours",
+  };
+  time_t from = tp_mktime(2026, 1, 5, 0, 0);
+  time_t to = tp_mktime(2026, 12, 31, 0, 0);
+  for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+    Filter *f = optimize_filter(parse_filter(inputs[i]));
+    SearchOptions options = {.horizon = to, .max_iterations = ULONG_MAX};
+    time_t expected =
+        search_optimal_time(cal, f, from, 2 * 60 * 60, &options, NULL);
+    expect(expected != -1, "sequential search finds a slot");
+    for (unsigned threads = 1; threads <= 8; threads *= 2) {
+      time_t slot =
+          find_optimal_time_parallel(cal, f, from, to, 2 * 60 * 60, threads);
+      expect(slot == expected, "parallel search finds the sequential slot");
+    }
+    destroy_filter(f);
+  }
+
+  // The only free day is the 102nd
+  Filter *f = optimize_filter(parse_filter("business_hours and spaced 0 min"));
+  expect(find_optimal_time_parallel(cal, f, from, to, 4 * 60 * 60, 4) ==
+             tp_mktime(2026, 1, 5 + 101, 9, 0),
+         "first free 4-hour block is on the free day");
+  free_calendar(cal);
+  destroy_filter(f);
+}
+
+static void test_parallel_bounds(void) {
+  Calendar *cal = tp_packed_calendar(60, -1);
+  Filter *f = optimize_filter(parse_filter("business_hours and spaced 0 min"));
+  time_t from = tp_mktime(2026, 1, 5, 0, 0);
+  expect(find_optimal_time_parallel(cal, f, from, from + 30 * 24 * 60 * 60,
+                                    60 * 60, 4) == -1,
+         "no slot inside a fully booked horizon");
+  // The calendar ends after 60 days
+  expect(find_optimal_time_parallel(cal, f, from, from + 90 * 24 * 60 * 60,
+                                    60 * 60, 0) ==
+             tp_mktime(2026, 3, 6, 9, 0),
+         "slot after the booked range with one thread per CPU");
+  expect(find_optimal_time_parallel(cal, f, from, from - 1, 0, 2) == -1,
+         "empty horizon finds nothing");
+  destroy_filter(f);
+
+  f = parse_filter("before 2020-01-01");
+  expect(find_optimal_time_parallel(cal, f, from, from + 24 * 60 * 60, 0, 4) ==
+             -1,
+         "unsatisfiable filter finds nothing");
+  destroy_filter(f);
+  expect(find_optimal_time_parallel(cal, NULL, from, from + 60, 0, 4) == from,
+         "no filter is valid at once");
+  free_calendar(cal);
+}
+
+// Holiday years a calendar's set has expanded so far
+static size_t tp_holiday_years(const Calendar *cal) {
+  size_t n = 0;
+  for (HolidayYear *y = cal->holidays->years; y; y = y->next) {
+    n++;
+  }
+  return n;
+}
+
+static void test_parallel_sparse_holidays(void) {
+  Calendar *cal = create_calendar();
+  FILE *file = fopen("test_parallel_holidays.txt", "w");
+  // A Monday February 29th: 2016, then 2044
+  fputs("nth 2 1 5 Fifth Monday\n", file);
+  fclose(file);
+  expect(load_calendar_holidays(cal, "test_parallel_holidays.txt"),
+         "sparse holiday rules load");
+  remove("test_parallel_holidays.txt");
+  Filter *f = optimize_filter(parse_filter("holidays and business_hours"));
+  time_t from = tp_mktime(2026, 1, 5, 0, 0);
+  time_t to = tp_mktime(2026, 12, 31, 0, 0);
+
+  // Every year a worker's lookups scan is expanded before the threads start
+  prepare_calendar(cal, f, from, to);
+  size_t years = tp_holiday_years(cal);
+  struct tm date;
+  local_time(to, &date);
+  expect(days_until_holiday(cal, &date) != -1, "the next one is found");
+  local_time(from, &date);
+  expect(days_since_holiday(cal, &date) != -1, "the last one is found");
+  expect(years == tp_holiday_years(cal), "scanned years are prepared");
+
+  expect(find_optimal_time_parallel(cal, f, from, to, 60 * 60, 4) == -1,
+         "no holiday inside the horizon");
+  to = tp_mktime(2044, 12, 31, 0, 0);
+  expect(find_optimal_time_parallel(cal, f, from, to, 60 * 60, 4) ==
+             tp_mktime(2044, 2, 29, 9, 0),
+         "holiday found 18 years ahead");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static inline void run_parallel_search_tests(void) {
+  puts("Running parallel search tests...");
+  test_parallel_matches_sequential();
+  test_parallel_bounds();
+  test_parallel_sparse_holidays();
+  puts("Parallel search tests completed.");
+}
+
+#endif // TEST_PARALLEL_SEARCH_H
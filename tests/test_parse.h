@@ -166,6 +166,18 @@ static void test_datetime(const char *input, const int year, const int month,
   expect_eq(tm_info->tm_sec, second, "Second should match expected");
 }
 
+static void test_time_of_day(const char *input, const FilterType type,
+                             const time_t seconds) {
+  Filter *filter = parse_filter(input);
+  expect(filter != NULL && filter->type == type,
+         "Time-only filter should be a time of day filter");
+  if (filter) {
+    expect_eq((int)filter->data.seconds, (int)seconds,
+              "Seconds since midnight should match expected");
+  }
+  destroy_filter(filter);
+}
+
 static void test_parse_before_after() {
   // Date-only
   test_date("before 2024-12-25", 2024, 12, 25);
@@ -179,8 +191,9 @@ static void test_parse_before_after() {
   test_datetime("before 2023-6-15 23:59:59", 2023, 6, 15, 23, 59, 59);
 
   // Time-only
-  test_datetime("before 12:00:00", 1970, 1, 1, 12, 0, 0);
-  test_datetime("after 08:30:00", 1970, 1, 1, 8, 30, 0);
+  test_time_of_day("before 12:00:00", FILTER_BEFORE_TIME, 12 * 3600);
+  test_time_of_day("after 08:30:00", FILTER_AFTER_TIME, 8 * 3600 + 30 * 60);
+  test_time_of_day("after 23:59:59", FILTER_AFTER_TIME, 86399);
 }
 
 static void test_parse_business_hours() {
@@ -193,19 +206,71 @@ static void test_parse_business_hours() {
   expect(after_nine != NULL, "Left operand should not be NULL");
   expect(after_nine->type == FILTER_AFTER_TIME,
          "Left operand type should be AFTER_TIME");
-  struct tm *tm_after = localtime(&after_nine->data.time_value);
-  expect_eq(tm_after->tm_hour, 9, "After time hour should be 9");
-  expect_eq(tm_after->tm_min, 0, "After time minute should be 0");
+  expect_eq((int)after_nine->data.seconds, 9 * 3600,
+            "After time should be 9:00");
 
   Filter *before_five = filter->data.logical.right;
   expect(before_five != NULL, "Right operand should not be NULL");
   expect(before_five->type == FILTER_BEFORE_TIME,
          "Right operand type should be BEFORE_TIME");
-  struct tm *tm_before = localtime(&before_five->data.time_value);
-  expect_eq(tm_before->tm_hour, 17, "Before time hour should be 17");
-  expect_eq(tm_before->tm_min, 0, "Before time minute should be 0");
+  expect_eq((int)before_five->data.seconds, 17 * 3600,
+            "Before time should be 17:00");
+
+  destroy_filter(filter);
+}
+
+static void test_parse_calendar_periods() {
+  Filter *filter = parse_filter("in Mar-May, December");
+  expect(filter->type == FILTER_MONTH_MASK, "Months give a month set");
+  expect_eq(filter->data.month_mask, 0x81C, "March to May and December");
+  destroy_filter(filter);
+  filter = parse_filter("in nov - feb");
+  expect_eq(filter->data.month_mask, 0xC03, "Month range wraps the year");
+  destroy_filter(filter);
+
+  filter = parse_filter("days 1-7, 15");
+  expect(filter->type == FILTER_MONTH_DAYS, "Days give a day of month set");
+  expect_eq((int)filter->data.month_days, 0x80FE, "First week and the 15th");
+  destroy_filter(filter);
+
+  filter = parse_filter("last Friday of the month and second tuesday");
+  expect(filter->type == FILTER_AND, "Nth weekdays combine");
+  expect(filter->data.logical.left->type == FILTER_NTH_WEEKDAY,
+         "Left operand is an nth weekday");
+  expect_eq(filter->data.logical.left->data.nth.week, -1, "Last week");
+  expect_eq(filter->data.logical.left->data.nth.day_of_week, 5, "Friday");
+  expect_eq(filter->data.logical.right->data.nth.week, 2, "Second week");
+  expect_eq(filter->data.logical.right->data.nth.day_of_week, 2, "Tuesday");
+  destroy_filter(filter);
 
+  time_t now = time(NULL);
+  filter = parse_filter("within the next 10 days");
+  expect(filter->type == FILTER_DATE_RANGE, "Relative window is a range");
+  expect(filter->data.range.start >= now && filter->data.range.start <= now + 5,
+         "Relative window starts now");
+  expect(filter->data.range.end - filter->data.range.start == 10 * 86400,
+         "Relative window spans ten days");
   destroy_filter(filter);
+
+  filter = parse_filter("from 2026-03-01 to 2026-03-10");
+  expect(filter->type == FILTER_DATE_RANGE, "Date range");
+  expect(filter->data.range.start == make_date_time(2026, 3, 1, 0, 0, 0),
+         "Range starts on its first day");
+  expect(filter->data.range.end == make_date_time(2026, 3, 11, 0, 0, 0),
+         "Range includes its last day");
+  destroy_filter(filter);
+  filter = parse_filter("from 2026-03-01 08:00 to 2026-03-10 17:30");
+  expect(filter->data.range.end == make_date_time(2026, 3, 10, 17, 30, 0),
+         "Range ends at its end time");
+  destroy_filter(filter);
+
+  const char *invalid[] = {"days 0", "days 5-2", "in Smarch", "first Funday",
+                           "from 2026-03-01"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    filter = parse_filter(invalid[i]);
+    expect(filter->type == FILTER_NONE, "Malformed period is ignored");
+    destroy_filter(filter);
+  }
 }
 
 static inline void run_parse_tests() {
@@ -220,5 +285,6 @@ static inline void run_parse_tests() {
   test_parse_spaced();
   test_parse_before_after();
   test_parse_business_hours();
+  test_parse_calendar_periods();
   puts("Parser tests completed.");
 }
@@ -0,0 +1,96 @@
+#ifndef TEST_QUERY_CACHE_H
+#define TEST_QUERY_CACHE_H
+
+#include "../src/query_cache.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tq_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static void test_filter_key_canonical(void) {
+  Filter *a = parse_filter("weekdays and (holidays or spaced 10 minutes)");
+  Filter *b = parse_filter("(spaced 10 minutes or holidays) and weekdays");
+  Filter *c = parse_filter("weekdays or (holidays and spaced 10 minutes)");
+  char *ka = filter_key(a);
+  char *kb = filter_key(b);
+  char *kc = filter_key(c);
+  expect(strcmp(ka, kb) == 0, "operand order does not change the key");
+  expect(strcmp(ka, kc) != 0, "different operators give different keys");
+  free(ka);
+  free(kb);
+  free(kc);
+  destroy_filter(a);
+  destroy_filter(b);
+  destroy_filter(c);
+}
+
+static void test_query_cache_hits_and_invalidation(void) {
+  QueryCache *cache = create_query_cache(64);
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Busy", "", tq_mktime(2025, 12, 1, 9, 0),
+                     tq_mktime(2025, 12, 1, 11, 0));
+  Filter *periodic =
+      optimize_filter(parse_filter("business_days and business_hours"));
+  Filter *spaced =
+      optimize_filter(parse_filter("business_hours and spaced 0 minutes"));
+  time_t start = tq_mktime(2025, 12, 1, 8, 0);
+
+  time_t first = cached_find_optimal_time(cache, cal, spaced, start, 3600);
+  expect(first == tq_mktime(2025, 12, 1, 11, 0), "slot after the event");
+  unsigned long misses = cache->misses;
+  expect(cached_find_optimal_time(cache, cal, spaced, start + 60, 3600) ==
+             first,
+         "later start in the same bucket");
+  expect(cache->misses == misses, "answered from the cache");
+
+  cached_find_optimal_time(cache, cal, periodic, start, 3600);
+  unsigned long hits = cache->hits;
+
+  // An edit invalidates event-dependent results only
+  add_event_calendar(cal, "Lunch", "", tq_mktime(2025, 12, 1, 11, 0),
+                     tq_mktime(2025, 12, 1, 13, 0));
+  expect(cached_find_optimal_time(cache, cal, periodic, start, 3600) ==
+             tq_mktime(2025, 12, 1, 9, 0),
+         "periodic result is unchanged");
+  expect(cache->hits == hits + 1, "periodic result survives the edit");
+  hits = cache->hits;
+  expect(cached_find_optimal_time(cache, cal, spaced, start, 3600) ==
+             tq_mktime(2025, 12, 1, 13, 0),
+         "spaced result is recomputed after the edit");
+  expect(cache->hits == hits + 1,
+         "its calendar independent part is still cached");
+
+  Event *busy = get_first_event(cal, 2025, 12, 1);
+  free(remove_event_calendar(cal, busy->id));
+  expect(cached_find_optimal_time(cache, cal, spaced, start, 3600) ==
+             tq_mktime(2025, 12, 1, 9, 0),
+         "removal invalidates as well");
+
+  destroy_filter(periodic);
+  destroy_filter(spaced);
+  free_calendar(cal);
+  free_query_cache(cache);
+}
+
+static inline void run_query_cache_tests(void) {
+  puts("Running query cache tests...");
+  test_filter_key_canonical();
+  test_query_cache_hits_and_invalidation();
+  puts("Query cache tests completed.");
+}
+
+#endif // TEST_QUERY_CACHE_H
@@ -0,0 +1,153 @@
+#ifndef TEST_SCHEDULER_H
+#define TEST_SCHEDULER_H
+
+#include "../src/scheduler.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t tr_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static void test_schedule_priorities(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Standup", "", tr_mktime(2026, 3, 2, 9, 0),
+                     tr_mktime(2026, 3, 2, 10, 0));
+  Filter *f = optimize_filter(
+      parse_filter("weekdays and business_hours and spaced 0 minutes"));
+  ScheduleRequest requests[] = {
+      {"Review", f, 60 * 60, 1},
+      {"Planning", f, 2 * 60 * 60, 3},
+      {"Retro", f, 60 * 60, 2},
+      {"Sync", f, 30 * 60, 2},
+  };
+  time_t starts[4];
+  size_t placed = schedule_requests(cal, requests, 4,
+                                    tr_mktime(2026, 3, 2, 8, 0), NULL, starts);
+  expect_eq((int)placed, 4, "every meeting is placed");
+  expect(starts[1] == tr_mktime(2026, 3, 2, 10, 0),
+         "highest priority goes first, after the existing event");
+  expect(starts[2] == tr_mktime(2026, 3, 2, 12, 0),
+         "equal priorities keep their order");
+  expect(starts[3] == tr_mktime(2026, 3, 2, 13, 0), "then the next one");
+  expect(starts[0] == tr_mktime(2026, 3, 2, 13, 30),
+         "lowest priority takes what is left");
+  destroy_filter(f);
+  free_calendar(cal);
+}
+
+static void test_schedule_spacing(void) {
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Standup", "", tr_mktime(2026, 3, 2, 9, 0),
+                     tr_mktime(2026, 3, 2, 9, 15));
+  Filter *spaced = optimize_filter(
+      parse_filter("spaced 15 minutes and weekdays and business_hours"));
+  Filter *packed = optimize_filter(
+      parse_filter("spaced 0 minutes and weekdays and business_hours"));
+  ScheduleRequest requests[] = {
+      {"Review", spaced, 30 * 60, 2},
+      {"Sync", spaced, 30 * 60, 1},
+      {"Call", packed, 30 * 60, 0},
+  };
+  time_t starts[3];
+  size_t placed = schedule_requests(cal, requests, 3,
+                                    tr_mktime(2026, 3, 2, 8, 0), NULL, starts);
+  expect_eq((int)placed, 3, "spaced meetings are placed");
+  expect(starts[0] == tr_mktime(2026, 3, 2, 9, 30),
+         "spacing is kept from calendar events");
+  expect(starts[1] == tr_mktime(2026, 3, 2, 10, 15),
+         "and from meetings placed in the same batch");
+  expect(starts[2] == tr_mktime(2026, 3, 2, 10, 45),
+         "unspaced meetings only avoid overlaps");
+  destroy_filter(spaced);
+  destroy_filter(packed);
+  free_calendar(cal);
+}
+
+static void test_schedule_backtracking(void) {
+  Filter *anytime =
+      optimize_filter(parse_filter("weekdays and business_hours"));
+  Filter *early = parse_filter("from 2026-03-02 09:00 to 2026-03-02 09:30");
+  Filter *never = parse_filter("before 2020-01-01");
+  ScheduleRequest requests[] = {
+      {"Flexible", anytime, 60 * 60, 2},
+      {"Fixed", early, 60 * 60, 1},
+      {"Impossible", never, 60 * 60, 0},
+  };
+  time_t starts[3];
+  const time_t monday = tr_mktime(2026, 3, 2, 8, 0);
+  size_t placed = schedule_requests(NULL, requests, 2, monday, NULL, starts);
+  expect_eq((int)placed, 1, "greedy pass cannot fit the fixed meeting");
+  expect(starts[0] == tr_mktime(2026, 3, 2, 9, 0) && starts[1] == -1,
+         "the higher priority keeps its earliest slot");
+
+  ScheduleOptions options = {0, 4};
+  placed = schedule_requests(NULL, requests, 2, monday, &options, starts);
+  expect_eq((int)placed, 2, "backtracking fits both");
+  expect(starts[1] == tr_mktime(2026, 3, 2, 9, 0) &&
+             starts[0] == tr_mktime(2026, 3, 2, 10, 0),
+         "the flexible meeting moves out of the way");
+
+  // One request can never fit: the others are still placed
+  options.horizon = tr_mktime(2026, 3, 9, 0, 0);
+  placed = schedule_requests(NULL, requests, 3, monday, &options, starts);
+  expect_eq((int)placed, 2, "unsatisfiable request is left out");
+  expect(starts[2] == -1, "it gets no slot");
+  destroy_filter(anytime);
+  destroy_filter(early);
+  destroy_filter(never);
+}
+
+static void test_read_schedule_requests(void) {
+  FILE *file = fopen("test_schedule.txt", "w");
+  fputs("# weekly planning\n"
+        "Planning | 120 | 3 | weekdays and business_hours\n"
+        "\n"
+        "  1:1 with Sam|30|1|on Friday and after 14:00\n",
+        file);
+  fclose(file);
+  size_t count;
+  ScheduleRequest *requests =
+      read_schedule_requests("test_schedule.txt", &count);
+  expect(requests != NULL, "request file is read");
+  expect_eq((int)count, 2, "comments and blank lines are skipped");
+  if (requests) {
+    expect(strcmp(requests[1].title, "1:1 with Sam") == 0, "title trimmed");
+    expect(requests[0].duration == 120 * 60, "duration in minutes");
+    expect_eq(requests[0].priority, 3, "priority read");
+    expect(requests[1].filter && requests[1].filter->type == FILTER_AND,
+           "filter parsed");
+  }
+  free_schedule_requests(requests, count);
+
+  file = fopen("test_schedule.txt", "w");
+  fputs("Planning | 120 | 3 | weekdays\nBroken | soon | 1 | weekdays\n",
+        file);
+  fclose(file);
+  expect(read_schedule_requests("test_schedule.txt", &count) == NULL,
+         "malformed request is rejected");
+  expect_eq((int)count, 2, "error names the line");
+  remove("test_schedule.txt");
+}
+
+static inline void run_scheduler_tests(void) {
+  puts("Running scheduler tests...");
+  test_schedule_priorities();
+  test_schedule_spacing();
+  test_schedule_backtracking();
+  test_read_schedule_requests();
+  puts("Scheduler tests completed.");
+}
+
+#endif // TEST_SCHEDULER_H
@@ -0,0 +1,150 @@
+#ifndef TEST_SEGMENT_H
+#define TEST_SEGMENT_H
+
+#include "../src/segment.c"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void expect(bool condition, const char *message);
+void expect_eq(int expected, int actual, const char *message);
+
+static time_t ts_mktime(int year, int mon, int mday, int hour, int min) {
+  struct tm t = {0};
+  t.tm_year = year - 1900;
+  t.tm_mon = mon - 1;
+  t.tm_mday = mday;
+  t.tm_hour = hour;
+  t.tm_min = min;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+static bool ts_file_exists(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+  fclose(file);
+  return true;
+}
+
+static int ts_count_lines(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    return -1;
+  }
+  int lines = 0;
+  for (int c; (c = fgetc(file)) != EOF;) {
+    lines += c == '\n';
+  }
+  fclose(file);
+  return lines;
+}
+
+// 1) only years changed since the last save are rewritten
+static void test_segments_save_only_dirty_years(void) {
+  const char *dir = "test_segments_dirty";
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Old", "", ts_mktime(2015, 5, 1, 9, 0),
+                     ts_mktime(2015, 5, 1, 10, 0));
+  add_event_calendar(cal, "New", "", ts_mktime(2025, 5, 1, 9, 0),
+                     ts_mktime(2025, 5, 1, 10, 0));
+  expect(save_calendar_segments(cal, dir), "first segment save succeeds");
+  expect(ts_file_exists("test_segments_dirty/2015.seg") &&
+             ts_file_exists("test_segments_dirty/2025.seg"),
+         "first save should write one segment per year");
+  expect(!get_year_bucket(cal, 2015)->dirty &&
+             !get_year_bucket(cal, 2025)->dirty,
+         "save should clear dirty flags");
+
+  // If 2015 were rewritten, this file would come back
+  remove("test_segments_dirty/2015.seg");
+  add_event_calendar(cal, "Newer", "", ts_mktime(2025, 5, 2, 9, 0),
+                     ts_mktime(2025, 5, 2, 10, 0));
+  expect(get_year_bucket(cal, 2025)->dirty, "add should mark its year dirty");
+  expect(!get_year_bucket(cal, 2015)->dirty, "other years stay clean");
+  expect(save_calendar_segments(cal, dir), "incremental save succeeds");
+  expect(!ts_file_exists("test_segments_dirty/2015.seg"),
+         "clean years should not be rewritten");
+  expect_eq(2, ts_count_lines("test_segments_dirty/2025.seg"),
+            "dirty year should be rewritten with both events");
+  free_calendar(cal);
+
+  remove("test_segments_dirty/2025.seg");
+  remove(dir);
+}
+
+// 2) loading segments restores events with clean buckets; emptied years are
+//    removed from disk
+static void test_segments_load_and_remove(void) {
+  const char *dir = "test_segments_load";
+  Calendar *cal = create_calendar();
+  Event *gone =
+      add_event_calendar(cal, "Gone", "", ts_mktime(2024, 2, 29, 9, 0),
+                         ts_mktime(2024, 2, 29, 10, 0));
+  EventID gone_id = gone->id;
+  add_event_calendar(cal, "Kept", "k", ts_mktime(2025, 7, 1, 9, 0),
+                     ts_mktime(2025, 7, 1, 10, 0));
+  save_calendar_segments(cal, dir);
+  free_calendar(cal);
+
+  Calendar *loaded = create_calendar();
+  expect(load_calendar_segments(loaded, dir), "segment load succeeds");
+  Event *leap = get_first_event(loaded, 2024, 2, 29);
+  expect(leap != NULL && leap->id == gone_id,
+         "loaded segment should keep event ids");
+  expect(get_year_bucket(loaded, 2024) &&
+             !get_year_bucket(loaded, 2024)->dirty,
+         "loaded years should start clean");
+  expect(loaded->event_list->next_id > gone_id + 1,
+         "next_id should advance past loaded ids");
+
+  free(remove_event_calendar(loaded, gone_id));
+  save_calendar_segments(loaded, dir);
+  expect(!ts_file_exists("test_segments_load/2024.seg"),
+         "a year with no events left should lose its segment");
+  expect(ts_file_exists("test_segments_load/2025.seg"),
+         "untouched year keeps its segment");
+  free_calendar(loaded);
+
+  remove("test_segments_load/2025.seg");
+  remove(dir);
+}
+
+// 3) archiving a segment year swaps its file for a compressed archive
+static void test_segments_archive_year(void) {
+  const char *dir = "test_segments_archive";
+  Calendar *cal = create_calendar();
+  add_event_calendar(cal, "Past", "", ts_mktime(2016, 1, 4, 9, 0),
+                     ts_mktime(2016, 1, 4, 10, 0));
+  save_calendar_segments(cal, dir);
+  expect(archive_segment_year(cal, dir, 2016), "archive_segment_year works");
+  expect(!ts_file_exists("test_segments_archive/2016.seg") &&
+             ts_file_exists("test_segments_archive/2016.cala"),
+         "archived year should be stored compressed only");
+  free_calendar(cal);
+
+  Calendar *loaded = create_calendar();
+  load_calendar_segments(loaded, dir);
+  expect(loaded->event_list->head == NULL,
+         "archived years stay on disk after load");
+  Event *past = get_first_event(loaded, 2016, 1, 4);
+  expect(past != NULL && strcmp(past->title, "Past") == 0,
+         "archived year decodes on first query");
+  free_calendar(loaded);
+
+  remove("test_segments_archive/2016.cala");
+  remove(dir);
+}
+
+static inline void run_segment_tests(void) {
+  puts("Running segment tests...");
+  test_segments_save_only_dirty_years();
+  test_segments_load_and_remove();
+  test_segments_archive_year();
+  puts("Segment tests completed.");
+}
+
+#endif // TEST_SEGMENT_H